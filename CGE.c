@@ -19,17 +19,129 @@ along with CGE.  If not, see <http://www.gnu.org/licenses/>.
 
 */
 
+#define _POSIX_C_SOURCE 200112L
+#define _DEFAULT_SOURCE
+
 #include <SDL.h>
 #include <SDL_ttf.h>
+#include "CGECommon.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 /* Mathematical structures */
 
 const float CGE_PI = 3.14159265f;
 
+#define CGE_VIEWS_MAX 4
+#define CGE_STEREO_EYE 1.0f
+#define CGE_GRID_RING 16.0f
+#define CGE_ARENA_ALIGN 64
+#define CGE_ARENA_SIZE (4 * 1024 * 1024)
+#define CGE_ARENA_POISON 0xDD
+#define CGE_COMMANDS_BATCH 256
+#define CGE_COMMANDS_SIZE 4096
+#define CGE_COMMANDS_VERTICES 16384
+#define CGE_COMMANDS_BUCKET_SHIFT 6
+#define CGE_SCREEN_WIDTH 800
+#define CGE_SCREEN_HEIGHT 600
+#define CGE_RESOLUTION_MIN 0.25f
+#define CGE_RESOLUTION_BUDGET 16.0f
+#define CGE_TILE_SHIFT 3
+#define CGE_TILE_PIXELS 64
+#define CGE_TILE_COLUMNS ((CGE_SCREEN_WIDTH + 7) >> CGE_TILE_SHIFT)
+#define CGE_TILE_ROWS ((CGE_SCREEN_HEIGHT + 7) >> CGE_TILE_SHIFT)
+#define CGE_JOBS_WORKERS_MAX 16
+#define CGE_JOBS_DEQUE 1024
+#define CGE_JOBS_SPIN 256
+#define CGE_JOBS_GRAIN 4096
+#define CGE_SPLAT_BAND 32
+#define CGE_SPLAT_GRAIN (CGE_JOBS_GRAIN * 16)
+#define CGE_PACKET_LINES 8
+#define CGE_OVERLAY_VALUES 32
+#define CGE_HEAT_COLORS 16
+#define CGE_IDLE_TICK 500
+#define CGE_HUD_TOP 520
+#define CGE_TEXTURE_LEVELS 12
+#define CGE_MARKERS_TEXTURES 8
+#define CGE_HASH_BUCKETS 1024
+#define CGE_HASH_LOAD 2
+#define CGE_HASH_CELL 4.0f
+#define CGE_HASH_NONE 0xFFFFFFFF
+#define CGE_COLLISION_SKIN 0.01f
+#define CGE_CAMERA_RADIUS 1.0f
+#define CGE_ENTITY_SLOT_BITS 20
+#define CGE_ENTITY_SLOT_MASK 0xFFFFF
+#define CGE_ENTITY_GENERATION_MASK 0xFFF
+#define CGE_ENTITY_NONE 0xFFFFFFFF
+#define CGE_ENTITIES_AREA 100.0f
+#define CGE_NODE_NONE 0xFFFFFFFF
+#define CGE_GLYPH_FIRST 32
+#define CGE_GLYPHS 95
+#define CGE_ALLOC_SITES 256
+#define CGE_BENCHMARK_WARMUP 30
+#define CGE_BATCH_FRAMES 100
+#define CGE_EXPORT_FPS 30.0f
+#define CGE_EXPORT_RETRIES 4
+#define CGE_EXPORT_NAME 512
+#define CGE_WORLD_THREADS 2
+#define CGE_WORLD_INFLIGHT 8
+#define CGE_WORLD_RADIUS 300.0f
+#define CGE_WORLD_LOOKAHEAD 2000.0f
+#define CGE_WORLD_BUDGET 256
+#define CGE_WORLD_RETRY 1000
+
+/* GCC builtins, full barriers */
+#define CGE_AtomicAdd(pointer, value) __sync_add_and_fetch((pointer), (value))
+#define CGE_AtomicCas(pointer, old, new) __sync_bool_compare_and_swap((pointer), (old), (new))
+#define CGE_AtomicFence() __sync_synchronize()
+
+/* Index i of a mesh, whichever width it is stored in */
+#define CGE_MESH_INDEX(mesh, i) ((mesh)->index16 != NULL ? (Uint32)(mesh)->index16[(i)] : (mesh)->index[(i)])
+
+/* Address of a pixel in the tiled framebuffer: 8x8 tiles one after another */
+/* across the screen, each stored row by row so a tile row is 16 bytes */
+#define CGE_TILE(tiles, x, y) ((tiles) + ((((y) >> CGE_TILE_SHIFT) * CGE_TILE_COLUMNS + ((x) >> CGE_TILE_SHIFT)) << 6) + (((y) & 7) << 3) + ((x) & 7))
+
+/* Debug values are recorded during the frame and drawn by the HUD pass, */
+/* release builds compile the calls and their arguments away. Per view */
+/* stages only trace the first view */
+#ifdef CGE_DEBUG
+#define CGE_TRACE(engine, label, value, components) CGE_OverlayTrace((engine), (label), (value), (components))
+#define CGE_TRACE_VIEW(engine, view, label, value, components) ((view) == 0 ? (void)CGE_OverlayTrace((engine), (label), (value), (components)) : (void)0)
+#else
+#define CGE_TRACE(engine, label, value, components) ((void)0)
+#define CGE_TRACE_VIEW(engine, view, label, value, components) ((void)0)
+#endif
+
+/* Allocation tracking builds count every heap block and surface the engine */
+/* asks for at the line asking, a macro does not expand inside itself so the */
+/* real functions are still called */
+#ifdef CGE_ALLOCS
+#define malloc(size) CGE_AllocTrack(malloc(size), (size), __LINE__)
+#define calloc(count, size) CGE_AllocTrack(calloc((count), (size)), (count) * (size), __LINE__)
+#define realloc(pointer, size) CGE_AllocTrack(realloc((pointer), (size)), (size), __LINE__)
+#define SDL_CreateRGBSurface(flags, w, h, depth, r, g, b, a) CGE_SurfaceTrack(SDL_CreateRGBSurface((flags), (w), (h), (depth), (r), (g), (b), (a)), __LINE__)
+#define SDL_CreateRGBSurfaceFrom(pixels, w, h, depth, pitch, r, g, b, a) CGE_SurfaceTrack(SDL_CreateRGBSurfaceFrom((pixels), (w), (h), (depth), (pitch), (r), (g), (b), (a)), __LINE__)
+#define TTF_RenderText_Solid(font, text, color) CGE_SurfaceTrack(TTF_RenderText_Solid((font), (text), (color)), __LINE__)
+#endif
+
 struct CGE_V3
 {
 	float x;
@@ -71,6 +183,16 @@ struct CGE_M4
 
 typedef struct CGE_M4 CGE_M4;
 
+struct CGE_V4Views
+{
+	float x[CGE_VIEWS_MAX];
+	float y[CGE_VIEWS_MAX];
+	float z[CGE_VIEWS_MAX];
+	float w[CGE_VIEWS_MAX];
+};
+
+typedef struct CGE_V4Views CGE_V4Views;
+
 
 /* Renderer structures */
 
@@ -91,6 +213,302 @@ struct CGE_Line
 typedef struct CGE_Line CGE_Line;
 
 
+/* Mesh structures */
+
+/* Positions are either floats or, quantized, steps of step from origin, */
+/* the decoding being folded into the model matrix. Indices are either */
+/* Uint32 or Uint16, the others being NULL */
+struct CGE_Mesh
+{
+	Uint32 vertices;
+	Uint32 indices;
+	const float *x;
+	const float *y;
+	const float *z;
+	const Uint16 *qx;
+	const Uint16 *qy;
+	const Uint16 *qz;
+	CGE_V3 origin;
+	CGE_V3 step;
+	const Uint32 *index;
+	const Uint16 *index16;
+	Uint32 lods;
+	const CGE_MeshFileLod *lod;
+	CGE_V3 min;
+	CGE_V3 max;
+	SDL_Color color;
+};
+
+typedef struct CGE_Mesh CGE_Mesh;
+
+struct CGE_MeshFile
+{
+	unsigned char *map;
+	size_t size;
+	Uint32 meshes;
+	CGE_Mesh *mesh;
+};
+
+typedef struct CGE_MeshFile CGE_MeshFile;
+
+struct CGE_Instance
+{
+	CGE_V3 position;
+	CGE_V4 rotation;
+	CGE_V3 scale;
+};
+
+typedef struct CGE_Instance CGE_Instance;
+
+struct CGE_Grid
+{
+	float unit;
+	float extent;
+	float height;
+	float density;
+	int fade;
+	SDL_Color color;
+};
+
+typedef struct CGE_Grid CGE_Grid;
+
+/* Point clouds are drawn straight from SoA arrays. Positions are floats, or */
+/* 16 bit integers scaled by step from origin when quantized. Colors are */
+/* already mapped to the screen format, without them every point is color */
+struct CGE_PointCloud
+{
+	Uint32 points;
+	float *x;
+	float *y;
+	float *z;
+	Uint16 *qx;
+	Uint16 *qy;
+	Uint16 *qz;
+	CGE_V3 origin;
+	CGE_V3 step;
+	Uint16 *pixel;
+	SDL_Color color;
+	CGE_V3 min;
+	CGE_V3 max;
+	int size;
+	int depth;
+};
+
+typedef struct CGE_PointCloud CGE_PointCloud;
+
+/* Texels in the screen format, each level in Morton order so that texels */
+/* close in both directions stay close in memory when sampled scaled. */
+/* Sides are powers of two, alpha tested textures skip the key texels */
+struct CGE_Texture
+{
+	Uint16 *texels;
+	Uint32 offset[CGE_TEXTURE_LEVELS];
+	int width;
+	int height;
+	int widthShift;
+	int heightShift;
+	int levels;
+	int alpha;
+	Uint16 key;
+};
+
+typedef struct CGE_Texture CGE_Texture;
+
+/* A texture facing the screen, centred on its anchor, size high in the world */
+struct CGE_Billboard
+{
+	CGE_V3 position;
+	float size;
+	const CGE_Texture *texture;
+};
+
+typedef struct CGE_Billboard CGE_Billboard;
+
+enum CGE_ColliderShape
+{
+	CGE_COLLIDER_SEGMENT = 0,
+	CGE_COLLIDER_TRIANGLE
+};
+
+typedef enum CGE_ColliderShape CGE_ColliderShape;
+
+/* Colliders cut from a mesh keep the mesh and the position of their */
+/* first index in it, others their own points at first. Unused ones are */
+/* chained through next */
+struct CGE_Collider
+{
+	const CGE_Mesh *mesh;
+	Uint32 first;
+	Uint8 shape;
+	Uint8 used;
+	Uint32 stamp;
+	Uint32 next;
+};
+
+typedef struct CGE_Collider CGE_Collider;
+
+/* Points of a collider not cut from a mesh, unused ones chained */
+struct CGE_ColliderPoints
+{
+	CGE_V3 point[3];
+	Uint32 next;
+};
+
+typedef struct CGE_ColliderPoints CGE_ColliderPoints;
+
+/* One per cell a collider touches, chained in the bucket of the cell */
+struct CGE_HashEntry
+{
+	Uint32 collider;
+	Uint32 next;
+	int x;
+	int y;
+	int z;
+};
+
+typedef struct CGE_HashEntry CGE_HashEntry;
+
+/* A uniform grid hashed into buckets that double with the linked */
+/* entries, so its memory follows the colliders and not the extent of */
+/* the scene. Queries visit the cells they overlap, stamping colliders */
+/* to test each one once */
+struct CGE_SpatialHash
+{
+	float cell;
+	Uint32 *bucket;
+	Uint32 buckets;
+	Uint32 linked;
+	CGE_HashEntry *entry;
+	Uint32 entries;
+	Uint32 entriesCapacity;
+	Uint32 entryFree;
+	CGE_Collider *collider;
+	Uint32 colliders;
+	Uint32 collidersCapacity;
+	Uint32 colliderFree;
+	CGE_ColliderPoints *points;
+	Uint32 pointsCount;
+	Uint32 pointsCapacity;
+	Uint32 pointsFree;
+	Uint32 count;
+	Uint32 stamp;
+};
+
+typedef struct CGE_SpatialHash CGE_SpatialHash;
+
+/* Time along the sweep, or depth inside the capsule, with the normal */
+/* pointing from the collider to the query */
+struct CGE_Contact
+{
+	float time;
+	float depth;
+	CGE_V3 point;
+	CGE_V3 normal;
+	Uint32 collider;
+};
+
+typedef struct CGE_Contact CGE_Contact;
+
+enum CGE_Primitive
+{
+	CGE_PRIMITIVE_POINTS = 0,
+	CGE_PRIMITIVE_LINES,
+	CGE_PRIMITIVE_MESH,
+	CGE_PRIMITIVE_CLOUD,
+	CGE_PRIMITIVE_BILLBOARD
+};
+
+typedef enum CGE_Primitive CGE_Primitive;
+
+enum CGE_DrawState
+{
+	CGE_DRAWSTATE_GROUND = 0,
+	CGE_DRAWSTATE_SCENE,
+	CGE_DRAWSTATE_OVERLAY
+};
+
+typedef enum CGE_DrawState CGE_DrawState;
+
+struct CGE_DrawCommand
+{
+	Uint32 key;
+	Uint32 first;
+	Uint32 count;
+	CGE_V3 *vertices;
+	const CGE_Mesh *mesh;
+	const CGE_M4 *model;
+	const CGE_PointCloud *cloud;
+	const CGE_Billboard *billboard;
+	SDL_Color color;
+	Uint8 primitive;
+	Uint8 state;
+};
+
+typedef struct CGE_DrawCommand CGE_DrawCommand;
+
+struct CGE_CommandBuffer
+{
+	CGE_DrawCommand *commands;
+	Uint32 count;
+	Uint32 capacity;
+	CGE_V3 *vertices;
+	Uint32 verticesCount;
+	Uint32 verticesCapacity;
+	Uint32 commandsNeeded;
+	Uint32 verticesNeeded;
+	Uint32 linesCulled;
+	Uint32 pointsCulled;
+};
+
+typedef struct CGE_CommandBuffer CGE_CommandBuffer;
+
+/* Lines waiting for setup, one lane each, in clip space */
+struct CGE_LinePacket
+{
+	float x1[CGE_PACKET_LINES];
+	float y1[CGE_PACKET_LINES];
+	float z1[CGE_PACKET_LINES];
+	float w1[CGE_PACKET_LINES];
+	float x2[CGE_PACKET_LINES];
+	float y2[CGE_PACKET_LINES];
+	float z2[CGE_PACKET_LINES];
+	float w2[CGE_PACKET_LINES];
+	float vx[CGE_PACKET_LINES];
+	float vy[CGE_PACKET_LINES];
+	float vw[CGE_PACKET_LINES];
+	float vh[CGE_PACKET_LINES];
+	SDL_Color color[CGE_PACKET_LINES];
+	Uint8 view[CGE_PACKET_LINES];
+	int count;
+};
+
+typedef struct CGE_LinePacket CGE_LinePacket;
+
+enum CGE_SpanMajor
+{
+	CGE_SPANMAJOR_X = 0,
+	CGE_SPANMAJOR_Y
+};
+
+typedef enum CGE_SpanMajor CGE_SpanMajor;
+
+/* A set up line: pixels from start to end along the major axis, the */
+/* minor coordinate being minor + (t - origin) * slope */
+struct CGE_Span
+{
+	float origin;
+	float minor;
+	float slope;
+	float start;
+	float end;
+	SDL_Color color;
+	Uint8 major;
+	Uint8 view;
+};
+
+typedef struct CGE_Span CGE_Span;
+
+
 /* Game engine structures */
 
 struct CGE_LookAt
@@ -172,11 +590,35 @@ enum CGE_EngineStatesStatus
 
 typedef enum CGE_EngineStatesStatus CGE_EngineStatesStatus;
 
+/* Culled primitives went with their mesh or cloud, rejected ones were */
+/* entirely outside a view, clipped ones crossed its frustum. Lines and */
+/* points are counted once per view past submission. Covered and overdraw */
+/* are only measured while the statistics are shown */
+struct CGE_EngineStatesStats
+{
+	Uint32 linesSubmitted;
+	Uint32 linesCulled;
+	Uint32 linesRejected;
+	Uint32 linesClipped;
+	Uint32 linesRasterized;
+	Uint32 pointsSubmitted;
+	Uint32 pointsCulled;
+	Uint32 pointsRejected;
+	Uint32 pointsRasterized;
+	Uint32 pixels;
+	Uint32 covered;
+	Uint32 overdraw;
+};
+
+typedef struct CGE_EngineStatesStats CGE_EngineStatesStats;
+
 struct CGE_EngineStates
 {
 	CGE_EngineStatesInputs inputs;
 	CGE_EngineStatesTimers timers;
 	CGE_EngineStatesStatus status;
+	CGE_EngineStatesStats counters;
+	CGE_EngineStatesStats stats;
 };
 
 typedef struct CGE_EngineStates CGE_EngineStates;
@@ -192,42 +634,549 @@ struct CGE_Camera
 
 typedef struct CGE_Camera CGE_Camera;
 
+/* Keyframes of a fly-through, times in seconds and increasing, axis being */
+/* the pitch, yaw and roll of the camera in degrees */
+struct CGE_CameraPath
+{
+	Uint32 count;
+	float *time;
+	CGE_V3 *position;
+	CGE_V3 *axis;
+};
+
+typedef struct CGE_CameraPath CGE_CameraPath;
+
+struct CGE_View
+{
+	CGE_Camera camera;
+	CGE_Viewport viewport;
+	CGE_V3 eye;
+	int follow;
+};
+
+typedef struct CGE_View CGE_View;
+
 struct CGE_EngineDevice
 {
 	CGE_M4 model;
-	CGE_M4 view;
-	CGE_M4 projection;
-	CGE_Viewport viewport;
+	CGE_M4 view[CGE_VIEWS_MAX];
+	CGE_M4 projection[CGE_VIEWS_MAX];
+	CGE_M4 viewProjection[CGE_VIEWS_MAX];
+	CGE_Viewport viewport[CGE_VIEWS_MAX];
+	float transform[16][CGE_VIEWS_MAX];
+	int views;
 };
 
 typedef struct CGE_EngineDevice CGE_EngineDevice;
 
+struct CGE_Arena
+{
+	unsigned char *memory;
+	unsigned char *base;
+	size_t size;
+	size_t used;
+	size_t highWater;
+	size_t overflow;
+};
+
+typedef struct CGE_Arena CGE_Arena;
+
+/* One dense array per component, index i of every array is the same entity, */
+/* so each system walks only the arrays it needs. Removing an entity moves the */
+/* last one into its place. A handle is a slot and its generation: the slot */
+/* keeps the dense index and bumps its generation when the entity goes away */
+struct CGE_Entities
+{
+	CGE_Arena arena;
+	Uint32 count;
+	Uint32 capacity;
+	float *x;
+	float *y;
+	float *z;
+	float *yaw;
+	float *vx;
+	float *vy;
+	float *vz;
+	float *spin;
+	float *radius;
+	Uint32 *render;
+	Uint32 *handle;
+	CGE_M4 *model;
+	Uint32 *dense;
+	Uint16 *generation;
+	Uint32 slots;
+	Uint32 slotFree;
+};
+
+typedef struct CGE_Entities CGE_Entities;
+
+/* Nodes are kept in topological order, a parent always before its children, */
+/* so world matrices are brought up to date in one pass from the first dirty */
+/* node. A node is recomputed when it is dirty or its parent was recomputed */
+/* in the same update, its stamp, and the changed nodes are listed for the */
+/* systems that follow them */
+struct CGE_Hierarchy
+{
+	CGE_Arena arena;
+	Uint32 nodes;
+	Uint32 capacity;
+	Uint32 *parent;
+	CGE_M4 *local;
+	CGE_M4 *world;
+	CGE_V3 *min;
+	CGE_V3 *max;
+	CGE_V3 *worldMin;
+	CGE_V3 *worldMax;
+	Uint8 *dirty;
+	Uint32 *stamp;
+	Uint32 *changed;
+	Uint32 changes;
+	Uint32 first;
+	Uint32 update;
+};
+
+typedef struct CGE_Hierarchy CGE_Hierarchy;
+
+struct CGE_EngineFrames
+{
+	CGE_Arena arena[2];
+	int buffers;
+	int current;
+	Uint32 count;
+};
+
+typedef struct CGE_EngineFrames CGE_EngineFrames;
+
+/* The scene is drawn into the tiles and resolved into the top left */
+/* width x height of target, which is the screen itself at full scale */
+struct CGE_EngineResolution
+{
+	Uint16 *tiles;
+	SDL_Surface *target;
+	SDL_Surface *surface;
+	int width;
+	int height;
+	float scale;
+	float budget;
+	float average;
+	int settle;
+};
+
+typedef struct CGE_EngineResolution CGE_EngineResolution;
+
+/* Jobs run on a fixed pool of workers, the thread calling CGE_Init being */
+/* worker 0. Each worker owns a Chase-Lev deque: it pushes and pops at the */
+/* bottom, idle workers steal from the top */
+
+typedef void (*CGE_JobFunction)(void *, Uint32, Uint32);
+typedef void (*CGE_JobProfile)(void *, const char *, int, Uint32, Uint32);
+
+struct CGE_JobCounter
+{
+	volatile int value;
+};
+
+typedef struct CGE_JobCounter CGE_JobCounter;
+
+struct CGE_Job
+{
+	CGE_JobFunction function;
+	void *data;
+	Uint32 first;
+	Uint32 count;
+	CGE_JobCounter *counter;
+	const char *name;
+};
+
+typedef struct CGE_Job CGE_Job;
+
+struct CGE_JobWorker
+{
+	volatile long top;
+	char padding1[CGE_ARENA_ALIGN - sizeof(long)];
+	volatile long bottom;
+	char padding2[CGE_ARENA_ALIGN - sizeof(long)];
+	CGE_Job deque[CGE_JOBS_DEQUE];
+	struct CGE_Jobs *jobs;
+	SDL_Thread *thread;
+	volatile Uint32 id;
+	int index;
+	Uint32 seed;
+	Uint32 executed;
+	Uint32 stolen;
+	double busy;
+};
+
+typedef struct CGE_JobWorker CGE_JobWorker;
+
+struct CGE_Jobs
+{
+	CGE_JobWorker *worker;
+	int workers;
+	volatile int running;
+	volatile int sleeping;
+	SDL_sem *wake;
+	CGE_JobProfile profile;
+	void *profileData;
+};
+
+typedef struct CGE_Jobs CGE_Jobs;
+
+/* Clip space vertices of the mesh being drawn, taken from the frame */
+/* arena for one draw */
+struct CGE_EngineVertices
+{
+	CGE_V4 *clip;
+	Uint8 *outcode;
+};
+
+typedef struct CGE_EngineVertices CGE_EngineVertices;
+
+/* Depth and color of the nearest point splat per pixel, packed so that the */
+/* smallest value wins. Taken from the frame arena */
+struct CGE_EngineDepth
+{
+	Uint32 *buffer;
+	int width;
+	int height;
+};
+
+typedef struct CGE_EngineDepth CGE_EngineDepth;
+
+#ifdef CGE_DEBUG
+struct CGE_OverlayValue
+{
+	const char *label;
+	CGE_V4 value;
+	int components;
+};
+
+typedef struct CGE_OverlayValue CGE_OverlayValue;
+
+struct CGE_EngineOverlay
+{
+	CGE_OverlayValue value[CGE_OVERLAY_VALUES];
+	int count;
+	int trace;
+};
+
+typedef struct CGE_EngineOverlay CGE_EngineOverlay;
+#endif
+
+#ifdef CGE_ALLOCS
+struct CGE_AllocSite
+{
+	int line;
+	Uint32 count;
+	Uint32 frame;
+	size_t bytes;
+};
+
+typedef struct CGE_AllocSite CGE_AllocSite;
+
+struct CGE_Allocs
+{
+	CGE_AllocSite site[CGE_ALLOC_SITES];
+	Uint32 total;
+	Uint32 frame;
+	Uint32 frames;
+	Uint32 engines;
+	size_t bytes;
+};
+
+typedef struct CGE_Allocs CGE_Allocs;
+
+CGE_Allocs CGE_AllocTracker;
+#endif
+
+/* The font's printable ASCII glyphs, rendered once. Each is a width x */
+/* height mask at its offset, text is drawn by advancing glyph widths */
+struct CGE_EngineGlyphs
+{
+	Uint8 *mask;
+	Uint32 offset[CGE_GLYPHS];
+	int width[CGE_GLYPHS];
+	int height;
+};
+
+typedef struct CGE_EngineGlyphs CGE_EngineGlyphs;
+
+enum CGE_StatsMode
+{
+	CGE_STATSMODE_OFF = 0,
+	CGE_STATSMODE_HUD,
+	CGE_STATSMODE_HEATMAP
+};
+
+typedef enum CGE_StatsMode CGE_StatsMode;
+
+/* Writes per pixel of the frame, allocated while the statistics are shown */
+struct CGE_EngineHeat
+{
+	CGE_StatsMode mode;
+	Uint32 *buffer;
+	int width;
+	int height;
+	Uint16 palette[CGE_HEAT_COLORS];
+};
+
+typedef struct CGE_EngineHeat CGE_EngineHeat;
+
+/* While the camera and the scene stay still the last frame is kept on */
+/* screen and the loop sleeps on events, woken every tick to refresh the */
+/* HUD. The band under the HUD text is kept to redraw the text alone */
+struct CGE_EngineIdle
+{
+	int enabled;
+	int dirty;
+	int waiting;
+	float scale;
+	CGE_V3 position;
+	CGE_V3 axis;
+	int fps;
+	Uint16 *hud;
+	SDL_TimerID timer;
+};
+
+typedef struct CGE_EngineIdle CGE_EngineIdle;
+
+struct CGE_EngineInstances
+{
+	CGE_M4 *model;
+	Uint32 count;
+};
+
+typedef struct CGE_EngineInstances CGE_EngineInstances;
+
+struct CGE_EngineMarkers
+{
+	CGE_Texture texture[CGE_MARKERS_TEXTURES];
+	int textures;
+	CGE_Billboard *billboard;
+	Uint32 count;
+};
+
+typedef struct CGE_EngineMarkers CGE_EngineMarkers;
+
+/* A tree of bones, a few of them turning, each bone a collider */
+struct CGE_EngineRig
+{
+	CGE_Hierarchy hierarchy;
+	float *length;
+	Uint32 *collider;
+	Uint32 *animated;
+	CGE_M4 *base;
+	Uint32 count;
+	float phase;
+};
+
+typedef struct CGE_EngineRig CGE_EngineRig;
+
+/* A chunk goes EMPTY, QUEUED, READY, RETIRED and back to EMPTY. The */
+/* engine queues and retires, the I/O threads load and close, and each */
+/* side only reads the file once it sees the state the other published. */
+/* A FAILED chunk goes back to EMPTY after its retry time */
+enum CGE_ChunkState
+{
+	CGE_CHUNKSTATE_EMPTY = 0,
+	CGE_CHUNKSTATE_QUEUED,
+	CGE_CHUNKSTATE_READY,
+	CGE_CHUNKSTATE_RETIRED,
+	CGE_CHUNKSTATE_FAILED
+};
+
+typedef enum CGE_ChunkState CGE_ChunkState;
+
+struct CGE_WorldChunk
+{
+	CGE_V3 min;
+	CGE_V3 max;
+	char *path;
+	volatile Uint32 state;
+	CGE_MeshFile file;
+	Uint32 bytes;
+	Uint32 retry;
+	Uint32 failures;
+	float distance;
+};
+
+typedef struct CGE_WorldChunk CGE_WorldChunk;
+
+/* Chunks around the camera and ahead of it are streamed in by the I/O */
+/* threads, the farthest going back under the budget in bytes. The queue */
+/* holds each chunk at most once, so it needs no more slots than chunks */
+struct CGE_World
+{
+	CGE_WorldChunk *chunk;
+	Uint32 chunks;
+	Uint32 *queue;
+	Uint32 head;
+	Uint32 tail;
+	SDL_mutex *lock;
+	SDL_sem *wake;
+	SDL_Thread *thread[CGE_WORLD_THREADS];
+	int threads;
+	volatile int running;
+	volatile Uint32 published;
+	Uint32 seen;
+	Uint32 resident;
+	Uint32 budget;
+	float radius;
+	CGE_V3 last;
+	CGE_V3 ahead;
+};
+
+typedef struct CGE_World CGE_World;
+
+/* With a shared output the screen is the ring slot being drawn, the window */
+/* only takes the inputs */
+struct CGE_EngineOutput
+{
+	SDL_Surface *window;
+	SDL_Surface *slot[CGE_SHAREDFRAME_SLOTS];
+	CGE_SharedFrameHeader *header;
+	size_t size;
+	char name[64];
+	int current;
+	Uint32 sequence;
+};
+
+typedef struct CGE_EngineOutput CGE_EngineOutput;
+
+/* An offscreen engine owns its screen, takes no events and shares nothing */
+/* with the other engines of the process */
 struct CGE_Engine
 {
 	SDL_Surface *screen;
+	int offscreen;
+	int hud;
 	TTF_Font *font;
+	CGE_EngineGlyphs glyphs;
 	CGE_EngineStates states;
 	CGE_EngineDevice device;
+	CGE_EngineFrames frames;
+	CGE_EngineResolution resolution;
+	CGE_Jobs jobs;
+	CGE_EngineVertices vertices;
+	CGE_EngineDepth depth;
+	CGE_EngineHeat heat;
+	CGE_EngineIdle idle;
+	CGE_LinePacket packet;
+	CGE_EngineInstances instances;
+	CGE_EngineMarkers markers;
+	CGE_SpatialHash collision;
+	CGE_Entities entities;
+	CGE_EngineRig rig;
+	CGE_World world;
+	CGE_EngineOutput output;
+	CGE_CommandBuffer commands;
 	CGE_Camera camera;
+	CGE_View view[CGE_VIEWS_MAX];
+	int views;
 	CGE_Point point[4];
 	CGE_Line axe[3];
+	CGE_Grid grid;
+	CGE_MeshFile scene;
+	CGE_PointCloud cloud;
+#ifdef CGE_DEBUG
+	CGE_EngineOverlay overlay;
+#endif
 };
 
 typedef struct CGE_Engine CGE_Engine;
 
-enum CGE_EXITCODE
+struct CGE_MeshJob
+{
+	CGE_Engine *engine;
+	const CGE_Mesh *mesh;
+	const CGE_M4 *model;
+	Uint8 *visible;
+};
+
+typedef struct CGE_MeshJob CGE_MeshJob;
+
+/* Screen rectangle of one point in one view, empty when culled */
+struct CGE_Splat
+{
+	Sint16 x0;
+	Sint16 y0;
+	Sint16 x1;
+	Sint16 y1;
+	Uint16 pixel;
+};
+
+typedef struct CGE_Splat CGE_Splat;
+
+struct CGE_CloudJob
+{
+	CGE_Engine *engine;
+	const CGE_PointCloud *cloud;
+	CGE_EngineDevice device;
+	CGE_Splat *splat;
+	Uint32 *counts;
+	Uint32 *bins;
+	Uint32 *bandFirst;
+	Uint32 bands;
+	Uint16 pixel;
+};
+
+typedef struct CGE_CloudJob CGE_CloudJob;
+
+struct CGE_EntityJob
+{
+	CGE_Engine *engine;
+	CGE_Entities *entities;
+	const CGE_MeshFile *scene;
+	Uint8 *visible;
+};
+
+typedef struct CGE_EntityJob CGE_EntityJob;
+
+struct CGE_BatchRender
+{
+	CGE_Engine *engine;
+	Uint32 frames;
+	float start;
+};
+
+typedef struct CGE_BatchRender CGE_BatchRender;
+
+/* Frames go round the engines and are written in order, the engine holding */
+/* the next one waking the others once it is out */
+struct CGE_ExportFrames
+{
+	CGE_CameraPath path;
+	const char *pattern;
+	size_t conversion;
+	size_t length;
+	FILE *stream;
+	Uint32 frames;
+	float fps;
+	Uint32 next;
+	SDL_mutex *lock;
+	SDL_cond *written;
+	CGE_EXITCODE code;
+};
+
+typedef struct CGE_ExportFrames CGE_ExportFrames;
+
+struct CGE_ExportRender
 {
-	CGE_OK = 0,
-	CGE_ERR
+	CGE_Engine *engine;
+	CGE_ExportFrames *export;
+	Uint32 first;
+	Uint32 stride;
+	Uint8 *rgb;
 };
 
-typedef enum CGE_EXITCODE CGE_EXITCODE;
+typedef struct CGE_ExportRender CGE_ExportRender;
 
 
 /* Mathematical functions definitions */
 
 float CGE_DegToRad(float);
 float CGE_V3Length(CGE_V3);
+float CGE_V3Axis(CGE_V3, int);
 float CGE_V4Length(CGE_V4);
 
 CGE_V4 CGE_PlaneEqn (CGE_V3, CGE_V3);
@@ -259,9 +1208,16 @@ CGE_V3 CGE_V3Normalize(CGE_V3);
 CGE_V4 CGE_V4Normalize(CGE_V4);
 
 CGE_M4 CGE_M4Model(CGE_V3, CGE_V3);
+CGE_M4 CGE_M4Instance(CGE_Instance);
+CGE_V4 CGE_QuatAxisAngle(float, float, float, float);
 CGE_M4 CGE_M4View(CGE_V3, CGE_V3);
 CGE_LookAt CGE_LookAtCalculate(CGE_V3, CGE_V3);
 CGE_Viewport CGE_ViewportNew(float, float, float, float);
+CGE_EXITCODE CGE_V4ViewsTransform(CGE_EngineDevice *, CGE_V3, CGE_V4Views *);
+CGE_EXITCODE CGE_DeviceModel(CGE_EngineDevice *, CGE_M4);
+CGE_EXITCODE CGE_BoundsTransform(CGE_M4, CGE_V3, CGE_V3, CGE_V3 *, CGE_V3 *);
+CGE_EXITCODE CGE_V4ViewsOutcode(CGE_V4Views *, int *);
+CGE_V4 CGE_V4ViewsGet(CGE_V4Views *, int);
 
 
 /* Renderer functions definitions */
@@ -269,30 +1225,235 @@ CGE_Viewport CGE_ViewportNew(float, float, float, float);
 SDL_Color CGE_ColorNew(Uint8, Uint8, Uint8); 
 CGE_Point CGE_PointNew(float, float, float, Uint8, Uint8, Uint8);
 CGE_Line CGE_LineNew(CGE_Point, CGE_Point);
+CGE_Grid CGE_GridNew(float, float, float, float, SDL_Color);
 CGE_V3 CGE_V3Clip(CGE_V4);
 CGE_V4 CGE_V4Clip(CGE_V4, CGE_V4);
 CGE_EXITCODE CGE_LineClip(CGE_V4 *, CGE_V4 *);
 
 CGE_EXITCODE CGE_DrawPoint(CGE_Engine *, CGE_Point);
-CGE_EXITCODE CGE_DrawLine(CGE_Engine *, CGE_Line, int);
-CGE_EXITCODE CGE_DrawGrid(CGE_Engine *, CGE_V3, float);
-CGE_EXITCODE CGE_DrawPixel(SDL_Surface *, CGE_Viewport, CGE_V3, Uint8, Uint8, Uint8);
+CGE_EXITCODE CGE_DrawLine(CGE_Engine *, CGE_Line);
+CGE_EXITCODE CGE_DrawLineView(CGE_Engine *, int, CGE_V4, CGE_V4, SDL_Color);
+CGE_EXITCODE CGE_DrawSegment(CGE_Engine *, CGE_V3, CGE_V3, SDL_Color);
+CGE_EXITCODE CGE_LinePacketPush(CGE_Engine *, int, CGE_V4, CGE_V4, SDL_Color);
+CGE_EXITCODE CGE_LinePacketFlush(CGE_Engine *);
+int CGE_LinePacketSetup(CGE_LinePacket *, CGE_Span *);
+CGE_EXITCODE CGE_DrawSpans(CGE_Engine *, CGE_Span *, int);
+int CGE_BoundsVisible(CGE_Engine *, CGE_V3, CGE_V3);
+CGE_EXITCODE CGE_DrawGrid(CGE_Engine *, CGE_Grid);
+CGE_EXITCODE CGE_DrawGridRegion(CGE_Engine *, CGE_Grid, float, float, float, float);
+CGE_EXITCODE CGE_GridSpacing(CGE_Grid, float, float *, float *);
+CGE_EXITCODE CGE_PlotPixel(CGE_Engine *, CGE_Viewport, CGE_V3, SDL_Color);
 CGE_EXITCODE CGE_DrawTextSolid(CGE_Engine *, char *, CGE_V3, SDL_Color);
+CGE_EXITCODE CGE_GlyphsNew(CGE_Engine *);
+CGE_EXITCODE CGE_GlyphsFree(CGE_Engine *);
 CGE_EXITCODE CGE_DrawMatrix(CGE_Engine *, CGE_M4, CGE_V3, SDL_Color);
 CGE_V3 CGE_V3ViewportTransform(CGE_Viewport, CGE_V3);
 
+CGE_EXITCODE CGE_CommandBufferNew(CGE_Engine *, CGE_CommandBuffer *, Uint32, Uint32);
+CGE_EXITCODE CGE_CommandPoint(CGE_Engine *, CGE_CommandBuffer *, CGE_Point, Uint8);
+CGE_EXITCODE CGE_CommandLine(CGE_Engine *, CGE_CommandBuffer *, CGE_Line, Uint8);
+CGE_EXITCODE CGE_CommandMesh(CGE_Engine *, CGE_CommandBuffer *, const CGE_Mesh *, Uint8);
+CGE_EXITCODE CGE_CommandMeshVisible(CGE_Engine *, CGE_CommandBuffer *, const CGE_Mesh *, const CGE_M4 *, Uint8);
+CGE_EXITCODE CGE_CommandMeshes(CGE_Engine *, CGE_CommandBuffer *, const CGE_Mesh *, Uint32, Uint8);
+CGE_EXITCODE CGE_CommandInstances(CGE_Engine *, CGE_CommandBuffer *, const CGE_Mesh *, const CGE_M4 *, Uint32, Uint8);
+void CGE_CullJob(void *, Uint32, Uint32);
+void CGE_InstanceCullJob(void *, Uint32, Uint32);
+Uint32 CGE_CommandDepth(CGE_Engine *, CGE_V3);
+Uint32 CGE_CommandKey(CGE_Engine *, CGE_V3, SDL_Color, Uint8);
+CGE_EXITCODE CGE_CommandsSort(CGE_DrawCommand *, CGE_DrawCommand *, Uint32);
+CGE_EXITCODE CGE_CommandsExecute(CGE_Engine *, CGE_DrawCommand *, Uint32);
+CGE_EXITCODE CGE_CommandBufferSubmit(CGE_Engine *, CGE_CommandBuffer **, int);
+
 
 /* Game engine functions definitions */
 
 CGE_EXITCODE CGE_Init(CGE_Engine **);
+CGE_EXITCODE CGE_InitOffscreen(CGE_Engine **, int);
+CGE_EXITCODE CGE_InitEngine(CGE_Engine **, SDL_Surface *, int);
 CGE_EXITCODE CGE_GetInputs(CGE_Engine *);
 CGE_EXITCODE CGE_MapInputsPhysicals(CGE_Engine *, SDL_Event);
 CGE_EXITCODE CGE_MapInputsLogicals(CGE_Engine *);
 CGE_EXITCODE CGE_GetTimers(CGE_Engine *);
 CGE_EXITCODE CGE_Move(CGE_Engine *);
 CGE_EXITCODE CGE_Render(CGE_Engine *);
+CGE_EXITCODE CGE_DrawHud(CGE_Engine *);
 CGE_EXITCODE CGE_DeInit(CGE_Engine *);
+int CGE_Idle(CGE_Engine *);
+CGE_EXITCODE CGE_Invalidate(CGE_Engine *);
+CGE_EXITCODE CGE_IdleRetain(CGE_Engine *);
+CGE_EXITCODE CGE_RenderHud(CGE_Engine *);
+Uint32 CGE_IdleTimer(Uint32, void *);
+CGE_EXITCODE CGE_OutputShared(CGE_Engine *, const char *);
+CGE_EXITCODE CGE_OutputBegin(CGE_Engine *, int);
+CGE_EXITCODE CGE_Present(CGE_Engine *, int, int, int, int);
+CGE_EXITCODE CGE_OutputFree(CGE_Engine *);
+CGE_EXITCODE CGE_Benchmark(CGE_Engine *, Uint32);
+CGE_EXITCODE CGE_Batch(char *, int, Uint32, int, int);
+int CGE_BatchThread(void *);
+CGE_EXITCODE CGE_CameraPathLoad(CGE_CameraPath *, const char *);
+CGE_EXITCODE CGE_CameraPathSample(const CGE_CameraPath *, float, CGE_V3 *, CGE_V3 *);
+CGE_EXITCODE CGE_CameraPathFree(CGE_CameraPath *);
+CGE_EXITCODE CGE_Export(char *, const char *, const char *, int, float, int);
+int CGE_ExportThread(void *);
+CGE_EXITCODE CGE_ExportPattern(CGE_ExportFrames *, const char *);
+CGE_EXITCODE CGE_ExportWrite(CGE_ExportFrames *, Uint32, const Uint8 *);
 CGE_EXITCODE CGE_SetCamera(CGE_Engine *, CGE_V3, CGE_V3);
+CGE_EXITCODE CGE_ViewAdd(CGE_Engine *, CGE_Viewport, CGE_M4);
+CGE_EXITCODE CGE_ViewSetCamera(CGE_Engine *, int, CGE_V3, CGE_V3);
+CGE_EXITCODE CGE_ViewsSingle(CGE_Engine *);
+CGE_EXITCODE CGE_ViewsStereo(CGE_Engine *, float);
+CGE_EXITCODE CGE_ViewsUpdate(CGE_Engine *);
+CGE_EXITCODE CGE_ResolutionNew(CGE_Engine *, float);
+CGE_EXITCODE CGE_ResolutionSet(CGE_Engine *, float);
+CGE_EXITCODE CGE_ResolutionGovern(CGE_Engine *);
+CGE_EXITCODE CGE_ResolutionClear(CGE_Engine *);
+CGE_EXITCODE CGE_ResolutionResolve(CGE_Engine *);
+void CGE_TilesJob(void *, Uint32, Uint32);
+CGE_EXITCODE CGE_ResolutionUpscale(CGE_Engine *);
+CGE_EXITCODE CGE_ResolutionFree(CGE_Engine *);
+CGE_EXITCODE CGE_SetStatsMode(CGE_Engine *, CGE_StatsMode);
+CGE_EXITCODE CGE_StatsBegin(CGE_Engine *);
+CGE_EXITCODE CGE_StatsEnd(CGE_Engine *);
+CGE_EXITCODE CGE_GetStats(CGE_Engine *, CGE_EngineStatesStats *);
+CGE_EXITCODE CGE_DrawStats(CGE_Engine *);
+
+
+/* Mesh functions definitions */
+
+CGE_EXITCODE CGE_MeshFileOpen(CGE_MeshFile *, const char *, int);
+CGE_EXITCODE CGE_MeshFileClose(CGE_MeshFile *);
+CGE_EXITCODE CGE_MeshLod(const CGE_Mesh *, float, Uint32 *, Uint32 *);
+CGE_V3 CGE_MeshStream(const CGE_Mesh *, Uint32);
+CGE_V3 CGE_MeshVertex(const CGE_Mesh *, Uint32);
+CGE_M4 CGE_MeshDecode(const CGE_Mesh *);
+CGE_EXITCODE CGE_InstancesGrid(CGE_Engine *, const CGE_Mesh *, Uint32);
+CGE_EXITCODE CGE_InstancesFree(CGE_Engine *);
+CGE_EXITCODE CGE_DrawMeshRange(CGE_Engine *, const CGE_Mesh *, Uint32, Uint32, SDL_Color);
+void CGE_TransformJob(void *, Uint32, Uint32);
+
+
+/* Point cloud functions definitions */
+
+CGE_EXITCODE CGE_PointCloudNew(CGE_PointCloud *, Uint32, int);
+CGE_EXITCODE CGE_PointCloudFree(CGE_PointCloud *);
+CGE_EXITCODE CGE_PointCloudTerrain(CGE_Engine *, CGE_PointCloud *, Uint32);
+CGE_EXITCODE CGE_CommandPointCloud(CGE_Engine *, CGE_CommandBuffer *, const CGE_PointCloud *, Uint8);
+CGE_EXITCODE CGE_DrawPointCloud(CGE_Engine *, const CGE_PointCloud *);
+void CGE_SplatJob(void *, Uint32, Uint32);
+void CGE_BinJob(void *, Uint32, Uint32);
+void CGE_BandJob(void *, Uint32, Uint32);
+void CGE_ResolveJob(void *, Uint32, Uint32);
+
+
+/* Billboard functions definitions */
+
+CGE_EXITCODE CGE_TextureNew(CGE_Engine *, CGE_Texture *, SDL_Surface *, int);
+CGE_EXITCODE CGE_TextureText(CGE_Engine *, CGE_Texture *, char *, SDL_Color);
+CGE_EXITCODE CGE_TextureFree(CGE_Texture *);
+Uint32 CGE_TextureSwizzle(Uint32, int, int);
+Uint32 CGE_SurfacePixel(SDL_Surface *, int, int);
+CGE_EXITCODE CGE_CommandBillboards(CGE_Engine *, CGE_CommandBuffer *, const CGE_Billboard *, Uint32, Uint8);
+CGE_EXITCODE CGE_DrawBillboard(CGE_Engine *, const CGE_Billboard *);
+CGE_EXITCODE CGE_MarkersScatter(CGE_Engine *, Uint32);
+CGE_EXITCODE CGE_MarkersFree(CGE_Engine *);
+
+
+/* Collision functions definitions */
+
+CGE_EXITCODE CGE_HashNew(CGE_SpatialHash *, float);
+CGE_EXITCODE CGE_HashFree(CGE_SpatialHash *);
+Uint32 CGE_HashCollider(CGE_SpatialHash *);
+Uint32 CGE_HashInsert(CGE_SpatialHash *, CGE_ColliderShape, CGE_V3, CGE_V3, CGE_V3);
+Uint32 CGE_HashInsertMesh(CGE_SpatialHash *, CGE_ColliderShape, const CGE_Mesh *, Uint32);
+CGE_EXITCODE CGE_HashUpdate(CGE_SpatialHash *, Uint32, CGE_V3, CGE_V3, CGE_V3);
+CGE_EXITCODE CGE_HashRemove(CGE_SpatialHash *, Uint32);
+CGE_EXITCODE CGE_HashCells(CGE_SpatialHash *, Uint32, int);
+CGE_EXITCODE CGE_HashCell(CGE_SpatialHash *, Uint32, int, int, int, int);
+CGE_EXITCODE CGE_HashGrow(CGE_SpatialHash *);
+Uint32 CGE_HashBucket(Uint32, int, int, int);
+CGE_EXITCODE CGE_ColliderPointsGet(const CGE_SpatialHash *, const CGE_Collider *, CGE_V3 *);
+CGE_EXITCODE CGE_HashRange(CGE_SpatialHash *, CGE_V3, CGE_V3, float, int *, int *);
+int CGE_HashSweep(CGE_SpatialHash *, CGE_V3, CGE_V3, float, CGE_Contact *);
+int CGE_HashCapsule(CGE_SpatialHash *, CGE_V3, CGE_V3, float, CGE_Contact *);
+CGE_V3 CGE_ClosestSegment(CGE_V3, CGE_V3, CGE_V3);
+CGE_V3 CGE_ClosestTriangle(CGE_V3, CGE_V3, CGE_V3, CGE_V3);
+CGE_V3 CGE_ClosestCollider(int, const CGE_V3 *, CGE_V3);
+float CGE_SegmentsClosest(CGE_V3, CGE_V3, CGE_V3, CGE_V3, CGE_V3 *, CGE_V3 *);
+float CGE_CapsuleClosest(int, const CGE_V3 *, CGE_V3, CGE_V3, CGE_V3 *, CGE_V3 *);
+CGE_V3 CGE_SlideMove(CGE_SpatialHash *, CGE_V3, CGE_V3, float);
+CGE_EXITCODE CGE_CollisionScene(CGE_Engine *);
+
+
+/* Entity functions definitions */
+
+CGE_EXITCODE CGE_EntitiesNew(CGE_Entities *);
+CGE_EXITCODE CGE_EntitiesFree(CGE_Entities *);
+CGE_EXITCODE CGE_EntitiesGrow(CGE_Entities *, Uint32);
+Uint32 CGE_EntityCreate(CGE_Entities *, CGE_V3, CGE_V3, float, Uint32);
+CGE_EXITCODE CGE_EntityDestroy(CGE_Entities *, Uint32);
+Uint32 CGE_EntityIndex(const CGE_Entities *, Uint32);
+CGE_EXITCODE CGE_EntitiesIntegrate(CGE_Entities *, float);
+CGE_EXITCODE CGE_EntitiesConfine(CGE_Entities *, CGE_V3, CGE_V3);
+CGE_EXITCODE CGE_CommandEntities(CGE_Engine *, CGE_CommandBuffer *, CGE_Entities *, const CGE_MeshFile *, Uint8);
+void CGE_EntityCullJob(void *, Uint32, Uint32);
+CGE_EXITCODE CGE_EntitiesScatter(CGE_Engine *, Uint32);
+
+
+/* Hierarchy functions definitions */
+
+CGE_EXITCODE CGE_HierarchyNew(CGE_Hierarchy *);
+CGE_EXITCODE CGE_HierarchyFree(CGE_Hierarchy *);
+CGE_EXITCODE CGE_HierarchyGrow(CGE_Hierarchy *, Uint32);
+Uint32 CGE_HierarchyAdd(CGE_Hierarchy *, Uint32, CGE_M4, CGE_V3, CGE_V3);
+CGE_EXITCODE CGE_HierarchySetLocal(CGE_Hierarchy *, Uint32, CGE_M4);
+CGE_EXITCODE CGE_HierarchyUpdate(CGE_Hierarchy *);
+CGE_EXITCODE CGE_RigNew(CGE_Engine *, Uint32, int);
+CGE_EXITCODE CGE_RigFree(CGE_Engine *);
+CGE_EXITCODE CGE_RigAnimate(CGE_Engine *, float);
+CGE_EXITCODE CGE_RigBone(CGE_Engine *, Uint32, CGE_V3 *, CGE_V3 *);
+CGE_EXITCODE CGE_CommandRig(CGE_Engine *, CGE_CommandBuffer *, Uint8);
+
+
+/* World functions definitions */
+
+CGE_EXITCODE CGE_WorldNew(CGE_World *);
+CGE_EXITCODE CGE_WorldOpen(CGE_World *, const char *, Uint32);
+CGE_EXITCODE CGE_WorldClose(CGE_World *);
+CGE_EXITCODE CGE_WorldPush(CGE_World *, Uint32);
+CGE_EXITCODE CGE_WorldUpdate(CGE_Engine *, CGE_World *);
+CGE_EXITCODE CGE_CommandWorld(CGE_Engine *, CGE_CommandBuffer *, CGE_World *, Uint8);
+int CGE_WorldThread(void *);
+float CGE_BoundsDistance(CGE_V3, CGE_V3, CGE_V3);
+
+
+/* Memory functions definitions */
+
+CGE_EXITCODE CGE_ArenaNew(CGE_Arena *, size_t);
+void *CGE_ArenaAlloc(CGE_Arena *, size_t);
+CGE_EXITCODE CGE_ArenaReset(CGE_Arena *);
+CGE_EXITCODE CGE_ArenaFree(CGE_Arena *);
+CGE_EXITCODE CGE_FramesNew(CGE_Engine *, size_t, int);
+CGE_EXITCODE CGE_FrameBegin(CGE_Engine *);
+size_t CGE_FrameMark(CGE_Engine *);
+CGE_EXITCODE CGE_FrameRelease(CGE_Engine *, size_t);
+void *CGE_FrameAlloc(CGE_Engine *, size_t);
+CGE_EXITCODE CGE_FramesFree(CGE_Engine *);
+
+
+/* Job functions definitions */
+
+CGE_EXITCODE CGE_JobsNew(CGE_Jobs *, int);
+CGE_EXITCODE CGE_JobsFree(CGE_Jobs *);
+CGE_EXITCODE CGE_JobsAttach(CGE_Jobs *);
+CGE_EXITCODE CGE_JobsProfile(CGE_Jobs *, CGE_JobProfile, void *);
+CGE_EXITCODE CGE_JobsRun(CGE_Jobs *, const char *, CGE_JobFunction, void *, Uint32, Uint32, CGE_JobCounter *);
+CGE_EXITCODE CGE_JobsFor(CGE_Jobs *, const char *, CGE_JobFunction, void *, Uint32, Uint32, CGE_JobCounter *);
+CGE_EXITCODE CGE_JobsWait(CGE_Jobs *, CGE_JobCounter *);
+int CGE_JobsWorker(CGE_Jobs *);
+int CGE_JobsPending(CGE_Jobs *);
+int CGE_JobsExecute(CGE_Jobs *, int);
+int CGE_JobsThread(void *);
+Uint32 CGE_JobsClock(void);
 
 
 /* Debugger functions definitions*/
@@ -300,6 +1461,18 @@ CGE_EXITCODE CGE_SetCamera(CGE_Engine *, CGE_V3, CGE_V3);
 CGE_EXITCODE CGE_M4Print(CGE_M4, char *);
 CGE_EXITCODE CGE_V3Print(CGE_V3, char *);
 CGE_EXITCODE CGE_V4Print(CGE_V4, char *);
+CGE_EXITCODE CGE_ArenaPrint(CGE_Arena *, char *);
+CGE_EXITCODE CGE_JobsPrint(CGE_Jobs *);
+#ifdef CGE_DEBUG
+CGE_EXITCODE CGE_OverlayTrace(CGE_Engine *, const char *, CGE_V4, int);
+CGE_EXITCODE CGE_OverlayDraw(CGE_Engine *);
+#endif
+#ifdef CGE_ALLOCS
+void *CGE_AllocTrack(void *, size_t, int);
+SDL_Surface *CGE_SurfaceTrack(SDL_Surface *, int);
+CGE_EXITCODE CGE_AllocsFrame(void);
+CGE_EXITCODE CGE_AllocsPrint(void);
+#endif
 
 
 /* Mathematical functions implementations */
@@ -309,6 +1482,11 @@ float CGE_DegToRad(float degree)
 	return degree * CGE_PI / 180.0f;
 }
 
+float CGE_V3Axis(CGE_V3 v, int axis)
+{
+	return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
 float CGE_V3Length(CGE_V3 v)
 {
 	return sqrt((v.x * v.x) + (v.y * v.y) + (v.z * v.z));
@@ -752,14 +1930,50 @@ CGE_M4 CGE_M4Model(CGE_V3 position, CGE_V3 target)
 	return newm;
 }
 
-CGE_M4 CGE_M4View(CGE_V3 position, CGE_V3 axis)
+CGE_M4 CGE_M4Instance(CGE_Instance instance)
 {
 	CGE_M4 newm;
+	CGE_V4 q;
+
+	/* Translation * rotation (unit quaternion x, y, z, w) * scale */
+	q = instance.rotation;
 
 	newm = CGE_M4Identity();
-	/*CGE_M4Print(newm, "Identity");*/
-	newm = CGE_M4M4Mul(CGE_M4Translate(-position.x, -position.y, -position.z), newm);
-	/*CGE_M4Print(newm, "Translate");*/
+	newm.m11 = (1.0f - 2.0f * (q.y * q.y + q.z * q.z)) * instance.scale.x;
+	newm.m12 = 2.0f * (q.x * q.y - q.w * q.z) * instance.scale.y;
+	newm.m13 = 2.0f * (q.x * q.z + q.w * q.y) * instance.scale.z;
+	newm.m21 = 2.0f * (q.x * q.y + q.w * q.z) * instance.scale.x;
+	newm.m22 = (1.0f - 2.0f * (q.x * q.x + q.z * q.z)) * instance.scale.y;
+	newm.m23 = 2.0f * (q.y * q.z - q.w * q.x) * instance.scale.z;
+	newm.m31 = 2.0f * (q.x * q.z - q.w * q.y) * instance.scale.x;
+	newm.m32 = 2.0f * (q.y * q.z + q.w * q.x) * instance.scale.y;
+	newm.m33 = (1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * instance.scale.z;
+	newm.m14 = instance.position.x;
+	newm.m24 = instance.position.y;
+	newm.m34 = instance.position.z;
+
+	return newm;
+}
+
+CGE_V4 CGE_QuatAxisAngle(float angle, float x, float y, float z)
+{
+	CGE_V3 axis;
+	float s;
+
+	axis = CGE_V3Normalize(CGE_V3New(x, y, z));
+	s = sin(CGE_DegToRad(angle) / 2.0f);
+
+	return CGE_V4New(axis.x * s, axis.y * s, axis.z * s, cos(CGE_DegToRad(angle) / 2.0f));
+}
+
+CGE_M4 CGE_M4View(CGE_V3 position, CGE_V3 axis)
+{
+	CGE_M4 newm;
+
+	newm = CGE_M4Identity();
+	/*CGE_M4Print(newm, "Identity");*/
+	newm = CGE_M4M4Mul(CGE_M4Translate(-position.x, -position.y, -position.z), newm);
+	/*CGE_M4Print(newm, "Translate");*/
 	newm = CGE_M4M4Mul(CGE_M4Rotate(-axis.y, 0.0f, 1.0f, 0.0f), newm);
 	/*CGE_M4Print(newm, "RotateY");*/
 	newm = CGE_M4M4Mul(CGE_M4Rotate(-axis.x, 1.0f, 0.0f, 0.0f), newm);
@@ -824,6 +2038,101 @@ CGE_Viewport CGE_ViewportNew(float x, float y, float w, float h)
 	return newv;
 }
 
+CGE_EXITCODE CGE_V4ViewsTransform(CGE_EngineDevice *device, CGE_V3 p, CGE_V4Views *newv)
+{
+	int v;
+
+	/* One lane per view, unused lanes hold a null matrix */
+	for(v = 0; v < CGE_VIEWS_MAX; v++)
+	{
+		newv->x[v] = (device->transform[0][v] * p.x) + (device->transform[1][v] * p.y) + (device->transform[2][v] * p.z) + device->transform[3][v];
+		newv->y[v] = (device->transform[4][v] * p.x) + (device->transform[5][v] * p.y) + (device->transform[6][v] * p.z) + device->transform[7][v];
+		newv->z[v] = (device->transform[8][v] * p.x) + (device->transform[9][v] * p.y) + (device->transform[10][v] * p.z) + device->transform[11][v];
+		newv->w[v] = (device->transform[12][v] * p.x) + (device->transform[13][v] * p.y) + (device->transform[14][v] * p.z) + device->transform[15][v];
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_DeviceModel(CGE_EngineDevice *device, CGE_M4 model)
+{
+	CGE_M4 transform;
+	int i;
+
+	/* The lanes hold projection * view * model, unused lanes stay null */
+	device->model = model;
+	for(i = 0; i < CGE_VIEWS_MAX; i++)
+	{
+		transform = CGE_M4M4Mul(device->viewProjection[i], model);
+
+		device->transform[0][i] = transform.m11;
+		device->transform[1][i] = transform.m12;
+		device->transform[2][i] = transform.m13;
+		device->transform[3][i] = transform.m14;
+		device->transform[4][i] = transform.m21;
+		device->transform[5][i] = transform.m22;
+		device->transform[6][i] = transform.m23;
+		device->transform[7][i] = transform.m24;
+		device->transform[8][i] = transform.m31;
+		device->transform[9][i] = transform.m32;
+		device->transform[10][i] = transform.m33;
+		device->transform[11][i] = transform.m34;
+		device->transform[12][i] = transform.m41;
+		device->transform[13][i] = transform.m42;
+		device->transform[14][i] = transform.m43;
+		device->transform[15][i] = transform.m44;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_BoundsTransform(CGE_M4 m, CGE_V3 min, CGE_V3 max, CGE_V3 *newmin, CGE_V3 *newmax)
+{
+	CGE_V3 center;
+	CGE_V3 extent;
+	CGE_V3 c;
+	CGE_V3 e;
+
+	/* Box around the transformed box: centre moves, extents go through |m| */
+	center = CGE_V3ScalarMul(CGE_V3V3Add(min, max), 0.5f);
+	extent = CGE_V3ScalarMul(CGE_V3V3Sub(max, min), 0.5f);
+
+	c.x = m.m11 * center.x + m.m12 * center.y + m.m13 * center.z + m.m14;
+	c.y = m.m21 * center.x + m.m22 * center.y + m.m23 * center.z + m.m24;
+	c.z = m.m31 * center.x + m.m32 * center.y + m.m33 * center.z + m.m34;
+	e.x = fabs(m.m11) * extent.x + fabs(m.m12) * extent.y + fabs(m.m13) * extent.z;
+	e.y = fabs(m.m21) * extent.x + fabs(m.m22) * extent.y + fabs(m.m23) * extent.z;
+	e.z = fabs(m.m31) * extent.x + fabs(m.m32) * extent.y + fabs(m.m33) * extent.z;
+
+	*newmin = CGE_V3V3Sub(c, e);
+	*newmax = CGE_V3V3Add(c, e);
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_V4ViewsOutcode(CGE_V4Views *p, int *outcode)
+{
+	int v;
+
+	/* One bit per frustum plane: left, right, bottom, top, near */
+	/* No far plane, the rasterizer has never clipped against it */
+	for(v = 0; v < CGE_VIEWS_MAX; v++)
+	{
+		outcode[v] = (p->x[v] < -p->w[v])
+			| ((p->x[v] > p->w[v]) << 1)
+			| ((p->y[v] < -p->w[v]) << 2)
+			| ((p->y[v] > p->w[v]) << 3)
+			| ((p->z[v] < -p->w[v]) << 4);
+	}
+
+	return CGE_OK;
+}
+
+CGE_V4 CGE_V4ViewsGet(CGE_V4Views *p, int v)
+{
+	return CGE_V4New(p->x[v], p->y[v], p->z[v], p->w[v]);
+}
+
 
 /* Renderer functions implementations */
 
@@ -858,6 +2167,20 @@ CGE_Line CGE_LineNew(CGE_Point point1, CGE_Point point2)
 	return newl;
 }
 
+CGE_Grid CGE_GridNew(float unit, float extent, float height, float density, SDL_Color color)
+{
+	CGE_Grid newg;
+
+	newg.unit = unit;
+	newg.extent = extent;
+	newg.height = height;
+	newg.density = density;
+	newg.fade = 1;
+	newg.color = color;
+
+	return newg;
+}
+
 CGE_V3 CGE_V3Clip(CGE_V4 p)
 {
 	CGE_V3 newp;
@@ -909,163 +2232,138 @@ CGE_V4 CGE_V4Clip(CGE_V4 p1, CGE_V4 p2)
 
 CGE_EXITCODE CGE_LineClip(CGE_V4 *v1, CGE_V4 *v2)
 {
-	
-	if(v1->w <= 0.0f)
+	float d1;
+	float d2;
+	float t;
+
+	/* Signed distances to the near plane z = -w */
+	d1 = v1->z + v1->w;
+	d2 = v2->z + v2->w;
+
+	if(d1 < 0.0f && d2 < 0.0f)
 	{
-		v1->x = v2->x;
-		v1->y = v2->y;
-		v1->z = v2->z;
-		v1->w = v2->w;
+		return CGE_ERR;
 	}
-	
-	if(v2->w <= 0.0f)
+
+	/* Cut the part behind the near plane instead of dropping the line */
+	if(d1 < 0.0f)
 	{
-		v1->x = v2->x = 1.0f;
-		v1->y = v2->y = 1.0f;
-		v1->z = v2->z = 1.0f;
-		v1->w = v2->w = 1.0f;
-	}	
+		t = d1 / (d1 - d2);
+		*v1 = CGE_V4V4Add(*v1, CGE_V4ScalarMul(CGE_V4V4Sub(*v2, *v1), t));
+	}
+	else if(d2 < 0.0f)
+	{
+		t = d2 / (d2 - d1);
+		*v2 = CGE_V4V4Add(*v2, CGE_V4ScalarMul(CGE_V4V4Sub(*v1, *v2), t));
+	}
 
 	return CGE_OK;
 }
 
 CGE_EXITCODE CGE_DrawPoint(CGE_Engine *engine, CGE_Point p)
 {	
-	CGE_V4 newp;
+	CGE_V4Views newp;
 	CGE_V3 newc;
+	int v;
 	
-	newp = CGE_V4New(p.position.x, p.position.y, p.position.z, 1.0f);	
-	newp = CGE_M4V4Mul(engine->device.view, newp);
-	newp = CGE_M4V4Mul(engine->device.projection, newp);
-	newc = CGE_V3Clip(newp);
+	CGE_V4ViewsTransform(&engine->device, p.position, &newp);
+	engine->states.counters.pointsSubmitted++;
 
-	if(newc.x >= -1.0f && newc.x <= 1.0f && newc.y >= -1.0f && newc.y <= 1.0f && newc.z >= -1.0f && newc.z <= 1.0f)
+	for(v = 0; v < engine->device.views; v++)
 	{
-		newc = CGE_V3ViewportTransform(engine->device.viewport, newc);
-		CGE_DrawPixel(engine->screen, engine->device.viewport, newc, p.color.r, p.color.g, p.color.b);
+		newc = CGE_V3Clip(CGE_V4ViewsGet(&newp, v));
+
+		if(newc.x >= -1.0f && newc.x <= 1.0f && newc.y >= -1.0f && newc.y <= 1.0f && newc.z >= -1.0f && newc.z <= 1.0f)
+		{
+			newc = CGE_V3ViewportTransform(engine->device.viewport[v], newc);
+			CGE_PlotPixel(engine, engine->device.viewport[v], newc, p.color);
+			engine->states.counters.pointsRasterized++;
+		}
+		else
+		{
+			engine->states.counters.pointsRejected++;
+		}
 	}
 
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l, int debug)
+CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l)
 {	
-	CGE_V4 newp1;
+	CGE_V4Views clip1;
+	CGE_V4Views clip2;
+	int outcode1[CGE_VIEWS_MAX];
+	int outcode2[CGE_VIEWS_MAX];
+	int v;
+
+	CGE_TRACE(engine, "P1(x, y, z)", CGE_V4New(l.point1.position.x, l.point1.position.y, l.point1.position.z, 1.0f), 3);
+	CGE_TRACE(engine, "P2(x, y, z)", CGE_V4New(l.point2.position.x, l.point2.position.y, l.point2.position.z, 1.0f), 3);
+
+	/* Transform the line once for all views, then cull against each frustum */
+	CGE_V4ViewsTransform(&engine->device, l.point1.position, &clip1);
+	CGE_V4ViewsTransform(&engine->device, l.point2.position, &clip2);
+	CGE_V4ViewsOutcode(&clip1, outcode1);
+	CGE_V4ViewsOutcode(&clip2, outcode2);
+
+	CGE_TRACE(engine, "Clipped (x, y, z, w)", CGE_V4ViewsGet(&clip1, 0), 4);
+	CGE_TRACE(engine, "Clipped (x, y, z, w)", CGE_V4ViewsGet(&clip2, 0), 4);
+
+	engine->states.counters.linesSubmitted++;
+	for(v = 0; v < engine->device.views; v++)
+	{
+		if((outcode1[v] & outcode2[v]) != 0)
+		{
+			engine->states.counters.linesRejected++;
+			continue;
+		}
+		if((outcode1[v] | outcode2[v]) != 0)
+		{
+			engine->states.counters.linesClipped++;
+		}
+		CGE_DrawLineView(engine, v, CGE_V4ViewsGet(&clip1, v), CGE_V4ViewsGet(&clip2, v), l.point1.color);
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_DrawLineView(CGE_Engine *engine, int view, CGE_V4 newp1, CGE_V4 newp2, SDL_Color color)
+{
 	CGE_V3 newc1;
-	CGE_V4 newp2;
 	CGE_V3 newc2;
 	CGE_V3 delta;
-	char debugtext[255];
-
-	newp1 = CGE_V4New(l.point1.position.x, l.point1.position.y, l.point1.position.z, 1.0f);
-	newp2 = CGE_V4New(l.point2.position.x, l.point2.position.y, l.point2.position.z, 1.0f);
-
-	if (debug == 1)
-	{	
-		CGE_DrawTextSolid(engine, "P1(x, y, z)", CGE_V3New(0.0f, 0.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp1.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 0.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp1.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 0.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp1.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 0.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-
-		CGE_DrawTextSolid(engine, "P2(x, y, z)", CGE_V3New(0.0f, 80.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp2.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 80.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp2.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 80.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp2.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 80.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-	}
-
-	newp1 = CGE_M4V4Mul(engine->device.view, newp1);
-	newp2 = CGE_M4V4Mul(engine->device.view, newp2);
-
-	newp1 = CGE_M4V4Mul(engine->device.projection, newp1);
-	newp2 = CGE_M4V4Mul(engine->device.projection, newp2);
-
-	if(debug == 1)
-	{
-		CGE_DrawTextSolid(engine, "Clipped (x, y, z, w)", CGE_V3New(0.0f, 16.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp1.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 16.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp1.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 16.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp1.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 16.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp1.w);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(500.0f, 16.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-
-		CGE_DrawTextSolid(engine, "Clipped (x, y, z, w)", CGE_V3New(0.0f, 96.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp2.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 96.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp2.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 96.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp2.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 96.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newp2.w);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(500.0f, 96.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-	}
+	CGE_Viewport viewport;
+
+	viewport = engine->device.viewport[view];
 
 /*
 	newp1 = CGE_V4Clip(newp1, newp2);
 	newp2 = CGE_V4Clip(newp2, newp1);
 */
 
-	CGE_LineClip(&newp1, &newp2);
+	if(CGE_LineClip(&newp1, &newp2) != CGE_OK)
+	{
+		return CGE_OK;
+	}
 
 	newc1 = CGE_V3Clip(newp1);
 	newc2 = CGE_V3Clip(newp2);
+	engine->states.counters.linesRasterized++;
 
-	if(debug == 1)
-	{
-		CGE_DrawTextSolid(engine, "Normalized (x, y, z)", CGE_V3New(0.0f, 32.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc1.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 32.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc1.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 32.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc1.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 32.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-
-		CGE_DrawTextSolid(engine, "Normalized (x, y, z)", CGE_V3New(0.0f, 112.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc2.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 112.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc2.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 112.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc2.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 112.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-	}
-
-	newc1 = CGE_V3ViewportTransform(engine->device.viewport, newc1);
-	newc2 = CGE_V3ViewportTransform(engine->device.viewport, newc2);
-
-	if(debug == 1)
-	{
-		CGE_DrawTextSolid(engine, "Viewport (x, y, z)", CGE_V3New(0.0f, 48.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc1.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 48.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc1.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 48.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc1.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 48.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-
-		CGE_DrawTextSolid(engine, "Viewport (x, y, z)", CGE_V3New(0.0f, 128.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc2.x);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(200.0f, 128.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc2.y);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(300.0f, 128.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-		sprintf(debugtext, "%f", newc2.z);
-		CGE_DrawTextSolid(engine, debugtext, CGE_V3New(400.0f, 128.0f, 0.0f), CGE_ColorNew(255, 255, 255));
-	}
-		
+	CGE_TRACE_VIEW(engine, view, "Normalized (x, y, z)", CGE_V4New(newc1.x, newc1.y, newc1.z, 1.0f), 3);
+	CGE_TRACE_VIEW(engine, view, "Normalized (x, y, z)", CGE_V4New(newc2.x, newc2.y, newc2.z, 1.0f), 3);
+
+	newc1 = CGE_V3ViewportTransform(viewport, newc1);
+	newc2 = CGE_V3ViewportTransform(viewport, newc2);
+
+	CGE_TRACE_VIEW(engine, view, "Viewport (x, y, z)", CGE_V4New(newc1.x, newc1.y, newc1.z, 1.0f), 3);
+	CGE_TRACE_VIEW(engine, view, "Viewport (x, y, z)", CGE_V4New(newc2.x, newc2.y, newc2.z, 1.0f), 3);
 
 	delta.x = newc2.x - newc1.x;
 	delta.y = newc2.y - newc1.y;
 
 	if(delta.x == 0.0f && delta.y == 0.0f)
 	{
-		CGE_DrawPixel(engine->screen, engine->device.viewport, newc1, l.point1.color.r, l.point1.color.g, l.point1.color.b);
+		CGE_PlotPixel(engine, viewport, newc1, color);
 		return CGE_OK;
 	}
 
@@ -1087,13 +2385,13 @@ CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l, int debug)
 			xmax = newc1.x;
 		}
 	
-		if(xmin < engine->device.viewport.x)
+		if(xmin < viewport.x)
 		{
-			xmin = engine->device.viewport.x;
+			xmin = viewport.x;
 		}
-		if(xmax > (engine->device.viewport.x + engine->device.viewport.w))
+		if(xmax > (viewport.x + viewport.w))
 		{
-			xmax = engine->device.viewport.x + engine->device.viewport.w;
+			xmax = viewport.x + viewport.w;
 		}
 	
 		slope = delta.y / delta.x;	
@@ -1105,7 +2403,7 @@ CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l, int debug)
 			newy = newc1.y + ((newx - newc1.x) * slope);
 			newpoint.x = newx;
 			newpoint.y = newy;
-			CGE_DrawPixel(engine->screen, engine->device.viewport, newpoint, l.point1.color.r, l.point1.color.g, l.point1.color.b);
+			CGE_PlotPixel(engine, viewport, newpoint, color);
 		}		
 	
 	}
@@ -1116,11 +2414,6 @@ CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l, int debug)
 		float slope;
 		float newy;
 
-		if (debug == 1)
-		{	
-			/*CGE_DrawTextSolid(engine, "delta.x <= delta.y", CGE_V3New(600.0f, 64.0f, 0.0f), CGE_ColorNew(255, 255, 255));*/
-		}
-
 		if(newc1.y < newc2.y)
 		{
 			ymin = newc1.y;
@@ -1132,13 +2425,13 @@ CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l, int debug)
 			ymax = newc1.y;
 		}
 
-		if(ymin < engine->device.viewport.y)
+		if(ymin < viewport.y)
 		{
-			ymin = engine->device.viewport.y;
+			ymin = viewport.y;
 		}
-		if(ymax > (engine->device.viewport.y + engine->device.viewport.h))
+		if(ymax > (viewport.y + viewport.h))
 		{
-			ymax = engine->device.viewport.y + engine->device.viewport.h;
+			ymax = viewport.y + viewport.h;
 		}
 
 		slope = delta.x / delta.y;
@@ -1150,7 +2443,7 @@ CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l, int debug)
 			newx = newc1.x + ((newy - newc1.y) * slope);
 			newpoint.x = newx;
 			newpoint.y = newy;
-			CGE_DrawPixel(engine->screen, engine->device.viewport, newpoint, l.point1.color.r, l.point1.color.g, l.point1.color.b);
+			CGE_PlotPixel(engine, viewport, newpoint, color);
 		}
 		
 	}
@@ -1158,574 +2451,7534 @@ CGE_EXITCODE CGE_DrawLine(CGE_Engine *engine, CGE_Line l, int debug)
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_DrawGrid(CGE_Engine *engine, CGE_V3 grid, float unit)
+/* Queued in the engine's line packet, drawn by the next flush */
+CGE_EXITCODE CGE_DrawSegment(CGE_Engine *engine, CGE_V3 p1, CGE_V3 p2, SDL_Color color)
 {
-	float i;
-	float j;
-
-	CGE_Line line;
-	line.point1 = CGE_PointNew(-20.0f, 0.0f, 0.0f, 80, 80, 80);
-	line.point2 = CGE_PointNew(20.0f, 0.0f, 0.0f, 80, 80, 80);
-	CGE_DrawLine(engine, line, 1);
-
-
-
-	
-	for(i = -grid.x; i <= grid.x; i += unit)
+	CGE_V4Views clip1;
+	CGE_V4Views clip2;
+	int outcode1[CGE_VIEWS_MAX];
+	int outcode2[CGE_VIEWS_MAX];
+	int v;
+
+	CGE_V4ViewsTransform(&engine->device, p1, &clip1);
+	CGE_V4ViewsTransform(&engine->device, p2, &clip2);
+	CGE_V4ViewsOutcode(&clip1, outcode1);
+	CGE_V4ViewsOutcode(&clip2, outcode2);
+
+	engine->states.counters.linesSubmitted++;
+	for(v = 0; v < engine->device.views; v++)
 	{
-		for(j = -grid.y; j <= grid.y; j += unit)
+		if((outcode1[v] & outcode2[v]) != 0)
 		{
-			CGE_Line line;
-			line.point1 = CGE_PointNew(i, j, -grid.z, 80, 20, 0);
-			line.point2 = CGE_PointNew(i, j, grid.z, 80, 20, 0);
-			CGE_DrawLine(engine, line, 0);
-		}  
-	}
-	
-	
-	for(i = -grid.y; i <= grid.y; i += unit)
-	{
-		for(j = -grid.z; j <= grid.z; j += unit)
+			engine->states.counters.linesRejected++;
+			continue;
+		}
+		if((outcode1[v] | outcode2[v]) != 0)
 		{
-			CGE_Line line;
-			line.point1 = CGE_PointNew(-grid.x, i, j, 80, 20, 0);
-			line.point2 = CGE_PointNew(grid.x, i, j, 80, 20, 0);
-			CGE_DrawLine(engine, line, 0);
-		}  		
-	}  
-	
-	/*
-	for(i = -grid.z; i <= grid.z; i += unit)
-	{
-		
-	}  
-	*/	
+			engine->states.counters.linesClipped++;
+		}
+		CGE_LinePacketPush(engine, v, CGE_V4ViewsGet(&clip1, v), CGE_V4ViewsGet(&clip2, v), color);
+	}
 
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_DrawPixel(SDL_Surface *screen, CGE_Viewport viewport, CGE_V3 position, Uint8 r, Uint8 g, Uint8 b)
+CGE_EXITCODE CGE_LinePacketPush(CGE_Engine *engine, int view, CGE_V4 p1, CGE_V4 p2, SDL_Color color)
 {
-	Uint32 color;
-	Uint16 *buffer;
-
-	if(position.x < viewport.x || position.x > (viewport.x + viewport.w) 
-	|| position.y < viewport.y || position.y > (viewport.y + viewport.h))
+	CGE_LinePacket *packet;
+	CGE_Viewport viewport;
+	int l;
+
+	packet = &engine->packet;
+	viewport = engine->device.viewport[view];
+	l = packet->count;
+
+	packet->x1[l] = p1.x;
+	packet->y1[l] = p1.y;
+	packet->z1[l] = p1.z;
+	packet->w1[l] = p1.w;
+	packet->x2[l] = p2.x;
+	packet->y2[l] = p2.y;
+	packet->z2[l] = p2.z;
+	packet->w2[l] = p2.w;
+	packet->vx[l] = viewport.x;
+	packet->vy[l] = viewport.y;
+	packet->vw[l] = viewport.w;
+	packet->vh[l] = viewport.h;
+	packet->color[l] = color;
+	packet->view[l] = (Uint8)view;
+	packet->count++;
+
+	if(packet->count == CGE_PACKET_LINES)
 	{
-		return CGE_OK;
+		return CGE_LinePacketFlush(engine);
 	}
 
-	color = SDL_MapRGB(screen->format, r, g, b);
-	buffer = (Uint16 *)screen->pixels + (int)position.y * screen->pitch / 2 + (int)position.x;
-	*buffer = color;
-
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_DrawTextSolid(CGE_Engine *engine, char *text, CGE_V3 position, SDL_Color color)
-{	
-	SDL_Surface * surface;
-	SDL_Rect zone;
+CGE_EXITCODE CGE_LinePacketFlush(CGE_Engine *engine)
+{
+	CGE_Span spans[CGE_PACKET_LINES];
+	int count;
 
+	if(engine->packet.count == 0)
+	{
+		return CGE_OK;
+	}
 
-	surface = TTF_RenderText_Solid(engine->font, text, color);
-	zone.x = position.x;
-	zone.y = position.y;
-	zone.w = 100;
-	zone.h = 50;
-	SDL_BlitSurface(surface, NULL, engine->screen, &zone);
-	SDL_FreeSurface(surface);
+	count = CGE_LinePacketSetup(&engine->packet, spans);
+	engine->packet.count = 0;
+	engine->states.counters.linesRasterized += count;
 
-	return CGE_OK;
+	return CGE_DrawSpans(engine, spans, count);
 }
 
-CGE_EXITCODE CGE_DrawMatrix(CGE_Engine *engine, CGE_M4 matrix, CGE_V3 position, SDL_Color color)
+/* CGE_DrawLineView for a whole packet: every step runs on all lanes and */
+/* selects only pick between values already computed, so the two lane */
+/* loops vectorize at -O2. A division or load under a select would be */
+/* moved into a branch, hence the arithmetic nonzero divisors. Unused */
+/* lanes are zero, fail the range test and are dropped when packed */
+int CGE_LinePacketSetup(CGE_LinePacket *packet, CGE_Span *spans)
 {
-	char item[255];
-	const float HSPACES = 80.0f;
-	const float VSPACES = 16.0f;
-	
-	sprintf(item, "%f", matrix.m11);
-	CGE_DrawTextSolid(engine, item, position, color);
-
-	sprintf(item, "%f", matrix.m12);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
-
-	sprintf(item, "%f", matrix.m13);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
-
-	sprintf(item, "%f", matrix.m14);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+	float ax[CGE_PACKET_LINES];
+	float ay[CGE_PACKET_LINES];
+	float bx[CGE_PACKET_LINES];
+	float by[CGE_PACKET_LINES];
+	float start[CGE_PACKET_LINES];
+	float end[CGE_PACKET_LINES];
+	float origin[CGE_PACKET_LINES];
+	float minor[CGE_PACKET_LINES];
+	float slope[CGE_PACKET_LINES];
+	int major[CGE_PACKET_LINES];
+	int keep[CGE_PACKET_LINES];
+	float d1;
+	float d2;
+	float t1;
+	float t2;
+	float w;
+	float dx;
+	float dy;
+	float lowX;
+	float lowY;
+	float highX;
+	float highY;
+	float startX;
+	float startY;
+	float endX;
+	float endY;
+	float right;
+	float bottom;
+	float numerator;
+	float denominator;
+	int outcode1;
+	int outcode2;
+	int count;
+	int l;
+
+	for(l = packet->count; l < CGE_PACKET_LINES; l++)
+	{
+		packet->x1[l] = packet->y1[l] = packet->z1[l] = packet->w1[l] = 0.0f;
+		packet->x2[l] = packet->y2[l] = packet->z2[l] = packet->w2[l] = 0.0f;
+	}
 
-	position.y += VSPACES;
+	for(l = 0; l < CGE_PACKET_LINES; l++)
+	{
+		/* Trivial reject, both ends out of the same plane */
+		outcode1 = (packet->x1[l] < -packet->w1[l])
+			| ((packet->x1[l] > packet->w1[l]) << 1)
+			| ((packet->y1[l] < -packet->w1[l]) << 2)
+			| ((packet->y1[l] > packet->w1[l]) << 3)
+			| ((packet->z1[l] < -packet->w1[l]) << 4);
+		outcode2 = (packet->x2[l] < -packet->w2[l])
+			| ((packet->x2[l] > packet->w2[l]) << 1)
+			| ((packet->y2[l] < -packet->w2[l]) << 2)
+			| ((packet->y2[l] > packet->w2[l]) << 3)
+			| ((packet->z2[l] < -packet->w2[l]) << 4);
+		keep[l] = ((outcode1 & outcode2) == 0) & (l < packet->count);
+
+		/* Near plane, at most one end is behind it once rejected. The */
+		/* end in front divides zero, which leaves it where it is */
+		d1 = packet->z1[l] + packet->w1[l];
+		d2 = packet->z2[l] + packet->w2[l];
+		denominator = d1 - d2;
+		denominator = denominator != 0.0f ? denominator : 1.0f;
+		t1 = (d1 < 0.0f ? d1 : 0.0f) / denominator;
+		t2 = (d2 < 0.0f ? d2 : 0.0f) / -denominator;
+
+		/* Perspective divide and viewport mapping of both ends */
+		w = packet->w1[l] + (packet->w2[l] - packet->w1[l]) * t1;
+		ax[l] = (((packet->x1[l] + (packet->x2[l] - packet->x1[l]) * t1) / w + 1.0f) * packet->vw[l] / 2.0f) + packet->vx[l];
+		ay[l] = ((-((packet->y1[l] + (packet->y2[l] - packet->y1[l]) * t1) / w) + 1.0f) * packet->vh[l] / 2.0f) + packet->vy[l];
+		w = packet->w2[l] + (packet->w1[l] - packet->w2[l]) * t2;
+		bx[l] = (((packet->x2[l] + (packet->x1[l] - packet->x2[l]) * t2) / w + 1.0f) * packet->vw[l] / 2.0f) + packet->vx[l];
+		by[l] = ((-((packet->y2[l] + (packet->y1[l] - packet->y2[l]) * t2) / w) + 1.0f) * packet->vh[l] / 2.0f) + packet->vy[l];
+	}
 
-	sprintf(item, "%f", matrix.m21);
-	position.x -= HSPACES * 3.0f;
-	CGE_DrawTextSolid(engine, item, position, color);
+	for(l = 0; l < CGE_PACKET_LINES; l++)
+	{
+		/* Both axes are clamped to the viewport, then the major one picked */
+		dx = bx[l] - ax[l];
+		dy = by[l] - ay[l];
+		major[l] = (dx < 0.0f ? -dx : dx) > (dy < 0.0f ? -dy : dy) ? CGE_SPANMAJOR_X : CGE_SPANMAJOR_Y;
+
+		right = packet->vx[l] + packet->vw[l];
+		bottom = packet->vy[l] + packet->vh[l];
+		lowX = ax[l] < bx[l] ? ax[l] : bx[l];
+		lowY = ay[l] < by[l] ? ay[l] : by[l];
+		highX = ax[l] < bx[l] ? bx[l] : ax[l];
+		highY = ay[l] < by[l] ? by[l] : ay[l];
+		startX = lowX < packet->vx[l] ? packet->vx[l] : lowX;
+		startY = lowY < packet->vy[l] ? packet->vy[l] : lowY;
+		endX = highX > right ? right : highX;
+		endY = highY > bottom ? bottom : highY;
+
+		origin[l] = major[l] == CGE_SPANMAJOR_X ? ax[l] : ay[l];
+		minor[l] = major[l] == CGE_SPANMAJOR_X ? ay[l] : ax[l];
+		start[l] = major[l] == CGE_SPANMAJOR_X ? startX : startY;
+		end[l] = major[l] == CGE_SPANMAJOR_X ? endX : endY;
+
+		/* A single point has no slope, it is drawn at its first end */
+		numerator = major[l] == CGE_SPANMAJOR_X ? dy : dx;
+		denominator = major[l] == CGE_SPANMAJOR_X ? dx : dy;
+		slope[l] = numerator / (denominator + (float)(denominator == 0.0f));
+
+		keep[l] = keep[l] & (start[l] <= end[l]);
+	}
 
-	sprintf(item, "%f", matrix.m22);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+	/* Pack the surviving lanes */
+	count = 0;
+	for(l = 0; l < CGE_PACKET_LINES; l++)
+	{
+		spans[count].origin = origin[l];
+		spans[count].minor = minor[l];
+		spans[count].slope = slope[l];
+		spans[count].start = start[l];
+		spans[count].end = end[l];
+		spans[count].color = packet->color[l];
+		spans[count].major = (Uint8)major[l];
+		spans[count].view = packet->view[l];
+		count += keep[l];
+	}
 
-	sprintf(item, "%f", matrix.m23);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+	return count;
+}
 
-	sprintf(item, "%f", matrix.m24);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+CGE_EXITCODE CGE_DrawSpans(CGE_Engine *engine, CGE_Span *spans, int count)
+{
+	CGE_V3 point;
+	float t;
+	int i;
 
-	position.y += VSPACES;
+	point.z = 0.0f;
+	for(i = 0; i < count; i++)
+	{
+		for(t = spans[i].start; t <= spans[i].end; t += 1.0f)
+		{
+			if(spans[i].major == CGE_SPANMAJOR_X)
+			{
+				point.x = t;
+				point.y = spans[i].minor + ((t - spans[i].origin) * spans[i].slope);
+			}
+			else
+			{
+				point.x = spans[i].minor + ((t - spans[i].origin) * spans[i].slope);
+				point.y = t;
+			}
+			CGE_PlotPixel(engine, engine->device.viewport[spans[i].view], point, spans[i].color);
+		}
+	}
 
-	sprintf(item, "%f", matrix.m31);
-	position.x -= HSPACES * 3.0f;
-	CGE_DrawTextSolid(engine, item, position, color);
+	return CGE_OK;
+}
 
-	sprintf(item, "%f", matrix.m32);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+int CGE_BoundsVisible(CGE_Engine *engine, CGE_V3 min, CGE_V3 max)
+{
+	CGE_V4Views corner;
+	int outcode[CGE_VIEWS_MAX];
+	int cornercode[CGE_VIEWS_MAX];
+	int i;
+	int v;
 
-	sprintf(item, "%f", matrix.m33);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+	for(v = 0; v < CGE_VIEWS_MAX; v++)
+	{
+		outcode[v] = ~0;
+	}
 
-	sprintf(item, "%f", matrix.m34);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+	/* A box is out when all its corners are outside one plane of a view */
+	for(i = 0; i < 8; i++)
+	{
+		CGE_V4ViewsTransform(&engine->device, CGE_V3New(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z), &corner);
+		CGE_V4ViewsOutcode(&corner, cornercode);
+		for(v = 0; v < CGE_VIEWS_MAX; v++)
+		{
+			outcode[v] &= cornercode[v];
+		}
+	}
 
-	position.y += VSPACES;
+	for(v = 0; v < engine->device.views; v++)
+	{
+		if(outcode[v] == 0)
+		{
+			return 1;
+		}
+	}
 
-	sprintf(item, "%f", matrix.m41);
-	position.x -= HSPACES * 3.0f;
-	CGE_DrawTextSolid(engine, item, position, color);
+	return 0;
+}
 
-	sprintf(item, "%f", matrix.m42);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+CGE_EXITCODE CGE_DrawGrid(CGE_Engine *engine, CGE_Grid grid)
+{
+	CGE_Line line;
+	CGE_V3 center;
+	float reach;
+	float inner;
+	float outer;
 
-	sprintf(item, "%f", matrix.m43);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+	line.point1 = CGE_PointNew(-20.0f, 0.0f, 0.0f, 80, 80, 80);
+	line.point2 = CGE_PointNew(20.0f, 0.0f, 0.0f, 80, 80, 80);
+#ifdef CGE_DEBUG
+	engine->overlay.trace = 1;
+#endif
+	CGE_DrawLine(engine, line);
+#ifdef CGE_DEBUG
+	engine->overlay.trace = 0;
+#endif
+
+	center = engine->camera.position;
+	reach = grid.extent + (fabs(center.x) > fabs(center.z) ? fabs(center.x) : fabs(center.z));
+
+	/* Square rings around the camera double in size at each step and pick */
+	/* their own spacing, so every ring costs about the same number of lines */
+	inner = 0.0f;
+	outer = grid.unit * CGE_GRID_RING;
+
+	while(inner < reach)
+	{
+		if(inner == 0.0f)
+		{
+			CGE_DrawGridRegion(engine, grid, center.x - outer, center.z - outer, center.x + outer, center.z + outer);
+		}
+		else
+		{
+			CGE_DrawGridRegion(engine, grid, center.x - outer, center.z - outer, center.x + outer, center.z - inner);
+			CGE_DrawGridRegion(engine, grid, center.x - outer, center.z + inner, center.x + outer, center.z + outer);
+			CGE_DrawGridRegion(engine, grid, center.x - outer, center.z - inner, center.x - inner, center.z + inner);
+			CGE_DrawGridRegion(engine, grid, center.x + inner, center.z - inner, center.x + outer, center.z + inner);
+		}
 
-	sprintf(item, "%f", matrix.m44);
-	position.x += HSPACES;
-	CGE_DrawTextSolid(engine, item, position, color);
+		inner = outer;
+		outer *= 2.0f;
+	}
 
 	return CGE_OK;
 }
 
-CGE_V3 CGE_V3ViewportTransform(CGE_Viewport v, CGE_V3 p)
+CGE_EXITCODE CGE_DrawGridRegion(CGE_Engine *engine, CGE_Grid grid, float x0, float z0, float x1, float z1)
 {
-	CGE_V3 newp;
+	CGE_Line line;
+	SDL_Color faded;
+	CGE_V3 eye;
+	float focal;
+	float dx;
+	float dy;
+	float dz;
+	float d2;
+	float pixels;
+	float pixelsX;
+	float pixelsZ;
+	float spacing;
+	float fraction;
+	long k;
+	long kmin;
+	long kmax;
+	int i;
+
+	/* Clip the region to the grid extent */
+	if(x0 < -grid.extent)
+	{
+		x0 = -grid.extent;
+	}
+	if(z0 < -grid.extent)
+	{
+		z0 = -grid.extent;
+	}
+	if(x1 > grid.extent)
+	{
+		x1 = grid.extent;
+	}
+	if(z1 > grid.extent)
+	{
+		z1 = grid.extent;
+	}
+	if(x0 >= x1 || z0 >= z1)
+	{
+		return CGE_OK;
+	}
 
-	newp.x = ((p.x + 1.0f) * v.w / 2.0f) + v.x;
-	newp.y = ((-p.y + 1.0f) * v.h / 2.0f) + v.y;
-	newp.z = p.z;
+	if(CGE_BoundsVisible(engine, CGE_V3New(x0, grid.height, z0), CGE_V3New(x1, grid.height, z1)) == 0)
+	{
+		return CGE_OK;
+	}
 
-	return newp;
-}
+	/* Every view draws the same lines, so each direction takes the finest */
+	/* spacing any of the views needs */
+	pixelsX = 0.0f;
+	pixelsZ = 0.0f;
+	for(i = 0; i < engine->device.views; i++)
+	{
+		/* Pixels covered by one unit seen at a distance of one */
+		focal = engine->device.projection[i].m22 * engine->device.viewport[i].h / 2.0f;
+		eye = engine->view[i].camera.position;
 
+		/* Offset from the camera to the nearest point of the region */
+		dx = 0.0f;
+		if(eye.x < x0)
+		{
+			dx = x0 - eye.x;
+		}
+		else if(eye.x > x1)
+		{
+			dx = eye.x - x1;
+		}
+		dz = 0.0f;
+		if(eye.z < z0)
+		{
+			dz = z0 - eye.z;
+		}
+		else if(eye.z > z1)
+		{
+			dz = eye.z - z1;
+		}
+		dy = eye.y - grid.height;
+		d2 = (dx * dx) + (dy * dy) + (dz * dz);
+		if(d2 < 1.0f)
+		{
+			d2 = 1.0f;
+		}
 
-/* Game engine functions implementations */
+		/* Lines x = k * spacing are foreshortened along x, the angle between */
+		/* two of them is spacing * sqrt(dy^2 + dz^2) / d^2 */
+		pixels = focal * sqrt((dy * dy) + (dz * dz)) / d2;
+		pixelsX = pixels > pixelsX ? pixels : pixelsX;
+		pixels = focal * sqrt((dy * dy) + (dx * dx)) / d2;
+		pixelsZ = pixels > pixelsZ ? pixels : pixelsZ;
+	}
 
-CGE_EXITCODE CGE_Init(CGE_Engine **engine)
+	CGE_GridSpacing(grid, pixelsX, &spacing, &fraction);
+
+	/* Lines of the next level fade out as the spacing is about to double */
+	faded.r = (Uint8)(grid.color.r * (1.0f - fraction));
+	faded.g = (Uint8)(grid.color.g * (1.0f - fraction));
+	faded.b = (Uint8)(grid.color.b * (1.0f - fraction));
+
+	/* Regions are half open so that shared borders are drawn once */
+	kmin = (long)ceil(x0 / spacing);
+	kmax = (long)floor(x1 / spacing);
+	if(kmax * spacing >= x1 && x1 < grid.extent)
+	{
+		kmax--;
+	}
+	for(k = kmin; k <= kmax; k++)
+	{
+		line.point1 = CGE_PointNew(k * spacing, grid.height, z0, grid.color.r, grid.color.g, grid.color.b);
+		line.point2 = CGE_PointNew(k * spacing, grid.height, z1, grid.color.r, grid.color.g, grid.color.b);
+		if(k % 2 != 0)
+		{
+			line.point1.color = faded;
+		}
+		CGE_CommandLine(engine, &engine->commands, line, CGE_DRAWSTATE_GROUND);
+	}
+
+	CGE_GridSpacing(grid, pixelsZ, &spacing, &fraction);
+
+	faded.r = (Uint8)(grid.color.r * (1.0f - fraction));
+	faded.g = (Uint8)(grid.color.g * (1.0f - fraction));
+	faded.b = (Uint8)(grid.color.b * (1.0f - fraction));
+
+	kmin = (long)ceil(z0 / spacing);
+	kmax = (long)floor(z1 / spacing);
+	if(kmax * spacing >= z1 && z1 < grid.extent)
+	{
+		kmax--;
+	}
+	for(k = kmin; k <= kmax; k++)
+	{
+		line.point1 = CGE_PointNew(x0, grid.height, k * spacing, grid.color.r, grid.color.g, grid.color.b);
+		line.point2 = CGE_PointNew(x1, grid.height, k * spacing, grid.color.r, grid.color.g, grid.color.b);
+		if(k % 2 != 0)
+		{
+			line.point1.color = faded;
+		}
+		CGE_CommandLine(engine, &engine->commands, line, CGE_DRAWSTATE_GROUND);
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_GridSpacing(CGE_Grid grid, float pixels, float *spacing, float *fraction)
 {
-	CGE_Engine *newengine = NULL;
-	newengine = (CGE_Engine *)malloc(sizeof(CGE_Engine));
-	
-	SDL_Init(SDL_INIT_VIDEO);
-	SDL_EnableUNICODE(1);
+	float level;
 
-	TTF_Init();
+	/* pixels is the screen size of one unit. Level l means the unit spacing */
+	/* has to double l times to reach the density target: the spacing used */
+	/* is one step above, while the lines of the next step fade out */
+	level = 64.0f;
+	if(pixels > 0.0f)
+	{
+		level = log(grid.density / (grid.unit * pixels)) / log(2.0f);
+	}
 
-	newengine->screen = SDL_SetVideoMode(800, 600, 16, SDL_HWSURFACE);
-	newengine->states.status = CGE_ENGINESTATESSTATUS_STARTED;	
+	if(level < -1.0f)
+	{
+		level = -1.0f;
+	}
 
-	newengine->font = TTF_OpenFont("/usr/share/fonts/truetype/freefont/FreeMono.ttf", 14);
-	
-	newengine->states.timers.absolute = SDL_GetTicks();
-	newengine->states.timers.elapsed = 0;
-	newengine->states.timers.fps = 0;
-	newengine->states.timers.fpsFrames = 0;
-	newengine->states.timers.fpsTicks = 0;
+	*fraction = 0.0f;
+	if(grid.fade == 1)
+	{
+		*fraction = level - floor(level);
+	}
 
-	CGE_SetCamera(newengine, CGE_V3New(0.0f, 0.0f, 100.0f), CGE_V3New(0.0f, 0.0f, 0.0f)); 
-	/*newengine->camera.projection = CGE_M4Orthographic(-0.8f, 0.8f, -0.6f, 0.6f, 1.0f, 100.0f);*/
-	newengine->camera.projection = CGE_M4Perspective(-0.4f, 0.4f, -0.3f, 0.3f, 1.0f, 100.0f);
-	
-	newengine->device.model = CGE_M4Identity();
-	newengine->device.view = CGE_M4Identity();
-	newengine->device.projection = CGE_M4Identity();
-	newengine->device.viewport = CGE_ViewportNew(0.0f, 0.0f, 800.0f, 600.0f);
+	*spacing = grid.unit * pow(2.0f, floor(level) + 1.0f);
 
-	newengine->point[0] = CGE_PointNew(0.5f, -0.5f, 0.0f, 255, 255, 255);
-	newengine->point[1] = CGE_PointNew(0.5f, 0.5f, 0.0f, 255, 255, 255);
-	newengine->point[2] = CGE_PointNew(-0.5f, 0.5f, 0.0f, 255, 255, 255);
-	newengine->point[3] = CGE_PointNew(-0.5f, -0.5f, 0.0f, 255, 255, 255);
+	return CGE_OK;
+}
 
-	newengine->axe[0] = CGE_LineNew(CGE_PointNew(0.0f, 0.0f, 0.0f, 0, 0, 255), CGE_PointNew(10.0f, 0.0f, 0.0f, 0, 0, 255)); /*x=b*/
-	newengine->axe[1] = CGE_LineNew(CGE_PointNew(0.0f, 0.0f, 0.0f, 0, 255, 0), CGE_PointNew(0.0f, 10.0f, 0.0f, 0, 255, 0)); /*y=g*/
-	newengine->axe[2] = CGE_LineNew(CGE_PointNew(0.0f, 0.0f, 0.0f, 255, 0, 0), CGE_PointNew(0.0f, 0.0f, 10.0f, 255, 0, 0)); /*z=r*/
+/* Writes one pixel of the tiled framebuffer, counted for the statistics */
+CGE_EXITCODE CGE_PlotPixel(CGE_Engine *engine, CGE_Viewport viewport, CGE_V3 position, SDL_Color color)
+{
+	int x;
+	int y;
 
-	*engine = newengine;	
+	if(position.x < viewport.x || position.x >= (viewport.x + viewport.w) 
+	|| position.y < viewport.y || position.y >= (viewport.y + viewport.h))
+	{
+		return CGE_OK;
+	}
+
+	x = (int)position.x;
+	y = (int)position.y;
+	engine->states.counters.pixels++;
+	if(engine->heat.buffer != NULL && x < engine->heat.width && y < engine->heat.height)
+	{
+		engine->heat.buffer[y * engine->heat.width + x]++;
+	}
+
+	*CGE_TILE(engine->resolution.tiles, x, y) = (Uint16)SDL_MapRGB(engine->screen->format, color.r, color.g, color.b);
 
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_GetInputs(CGE_Engine *engine)
+/* Text is drawn from the glyph cache, without a surface per string */
+CGE_EXITCODE CGE_DrawTextSolid(CGE_Engine *engine, char *text, CGE_V3 position, SDL_Color color)
 {	
-	SDL_Event e;
-	
-	while(SDL_PollEvent(&e))
+	CGE_EngineGlyphs *glyphs;
+	SDL_Surface *screen;
+	SDL_Surface * surface;
+	SDL_Rect zone;
+	const Uint8 *mask;
+	Uint16 *row;
+	Uint16 pixel;
+	int glyph;
+	int left;
+	int top;
+	int x;
+	int y;
+
+	glyphs = &engine->glyphs;
+	screen = engine->screen;
+	if(glyphs->mask == NULL)
 	{
-		CGE_MapInputsPhysicals(engine, e);
-		CGE_MapInputsLogicals(engine);
+		surface = TTF_RenderText_Solid(engine->font, text, color);
+		zone.x = position.x;
+		zone.y = position.y;
+		zone.w = 100;
+		zone.h = 50;
+		SDL_BlitSurface(surface, NULL, engine->screen, &zone);
+		SDL_FreeSurface(surface);
+		return CGE_OK;
+	}
+
+	pixel = (Uint16)SDL_MapRGB(screen->format, color.r, color.g, color.b);
+	left = (int)position.x;
+	top = (int)position.y;
+	for(; *text != '\0'; text++)
+	{
+		glyph = (unsigned char)*text - CGE_GLYPH_FIRST;
+		if(glyph < 0 || glyph >= CGE_GLYPHS)
+		{
+			glyph = '?' - CGE_GLYPH_FIRST;
+		}
+
+		mask = glyphs->mask + glyphs->offset[glyph];
+		for(y = 0; y < glyphs->height; y++)
+		{
+			if(top + y < 0 || top + y >= screen->h)
+			{
+				continue;
+			}
+			row = (Uint16 *)screen->pixels + (top + y) * (screen->pitch / 2);
+			for(x = 0; x < glyphs->width[glyph]; x++)
+			{
+				if(mask[y * glyphs->width[glyph] + x] != 0 && left + x >= 0 && left + x < screen->w)
+				{
+					row[left + x] = pixel;
+				}
+			}
+		}
+		left += glyphs->width[glyph];
 	}
 
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_MapInputsPhysicals(CGE_Engine *engine, SDL_Event e)
+CGE_EXITCODE CGE_GlyphsNew(CGE_Engine *engine)
 {
+	CGE_EngineGlyphs *glyphs;
+	SDL_Surface *surface;
+	Uint8 *mask;
+	Uint32 total;
+	Uint32 pixel;
+	char text[2];
+	int height;
+	int glyph;
+	int x;
+	int y;
+
+	glyphs = &engine->glyphs;
+	glyphs->mask = NULL;
+	glyphs->height = 0;
+	if(engine->font == NULL)
+	{
+		return CGE_ERR;
+	}
 
-	switch(e.type)
+	text[1] = '\0';
+	total = 0;
+	for(glyph = 0; glyph < CGE_GLYPHS; glyph++)
 	{
-		case SDL_KEYDOWN:
-			switch (e.key.keysym.sym)
+		text[0] = (char)(glyph + CGE_GLYPH_FIRST);
+		if(TTF_SizeText(engine->font, text, &glyphs->width[glyph], &height) != 0)
+		{
+			return CGE_ERR;
+		}
+		glyphs->height = height > glyphs->height ? height : glyphs->height;
+	}
+	for(glyph = 0; glyph < CGE_GLYPHS; glyph++)
+	{
+		glyphs->offset[glyph] = total;
+		total += (Uint32)glyphs->width[glyph] * glyphs->height;
+	}
+
+	glyphs->mask = (Uint8 *)calloc(total, 1);
+	if(glyphs->mask == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	for(glyph = 0; glyph < CGE_GLYPHS; glyph++)
+	{
+		text[0] = (char)(glyph + CGE_GLYPH_FIRST);
+		surface = TTF_RenderText_Solid(engine->font, text, CGE_ColorNew(255, 255, 255));
+		if(surface == NULL)
+		{
+			continue;
+		}
+		if(SDL_MUSTLOCK(surface))
+		{
+			SDL_LockSurface(surface);
+		}
+
+		mask = glyphs->mask + glyphs->offset[glyph];
+		for(y = 0; y < glyphs->height && y < surface->h; y++)
+		{
+			for(x = 0; x < glyphs->width[glyph] && x < surface->w; x++)
 			{
-				case SDLK_ESCAPE:
-					engine->states.status = CGE_ENGINESTATESSTATUS_STOPPED;
-					break;
-				case SDLK_LEFT:
-					engine->states.inputs.physicals.CGE_KeyLeft = 1;
-					break;
-				case SDLK_RIGHT:
-					engine->states.inputs.physicals.CGE_KeyRight = 1;
-					break;
-				case SDLK_UP:
-					engine->states.inputs.physicals.CGE_KeyUp = 1;
-					break;
-				case SDLK_DOWN:
-					engine->states.inputs.physicals.CGE_KeyDown = 1;
-					break;
-				case SDLK_a:
-					engine->states.inputs.physicals.CGE_KeyA = 1;
-					break;
-				case SDLK_d:
-					engine->states.inputs.physicals.CGE_KeyD = 1;
-					break;
-				case SDLK_w:
-					engine->states.inputs.physicals.CGE_KeyW = 1;
-					break;
-				case SDLK_s:
-					engine->states.inputs.physicals.CGE_KeyS = 1;
-					break;
-				case SDLK_q:
-					engine->states.inputs.physicals.CGE_KeyQ = 1;
-					break;
-				case SDLK_e:
-					engine->states.inputs.physicals.CGE_KeyE = 1;
-					break;
-				default:
-					break;
+				pixel = CGE_SurfacePixel(surface, x, y);
+				mask[y * glyphs->width[glyph] + x] = (Uint8)((surface->flags & SDL_SRCCOLORKEY) ? pixel != surface->format->colorkey : pixel != 0);
+			}
+		}
+
+		if(SDL_MUSTLOCK(surface))
+		{
+			SDL_UnlockSurface(surface);
+		}
+		SDL_FreeSurface(surface);
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_GlyphsFree(CGE_Engine *engine)
+{
+	free(engine->glyphs.mask);
+	engine->glyphs.mask = NULL;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_DrawMatrix(CGE_Engine *engine, CGE_M4 matrix, CGE_V3 position, SDL_Color color)
+{
+	char item[255];
+	const float HSPACES = 80.0f;
+	const float VSPACES = 16.0f;
+	
+	sprintf(item, "%f", matrix.m11);
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m12);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m13);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m14);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	position.y += VSPACES;
+
+	sprintf(item, "%f", matrix.m21);
+	position.x -= HSPACES * 3.0f;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m22);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m23);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m24);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	position.y += VSPACES;
+
+	sprintf(item, "%f", matrix.m31);
+	position.x -= HSPACES * 3.0f;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m32);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m33);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m34);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	position.y += VSPACES;
+
+	sprintf(item, "%f", matrix.m41);
+	position.x -= HSPACES * 3.0f;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m42);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m43);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	sprintf(item, "%f", matrix.m44);
+	position.x += HSPACES;
+	CGE_DrawTextSolid(engine, item, position, color);
+
+	return CGE_OK;
+}
+
+CGE_V3 CGE_V3ViewportTransform(CGE_Viewport v, CGE_V3 p)
+{
+	CGE_V3 newp;
+
+	newp.x = ((p.x + 1.0f) * v.w / 2.0f) + v.x;
+	newp.y = ((-p.y + 1.0f) * v.h / 2.0f) + v.y;
+	newp.z = p.z;
+
+	return newp;
+}
+
+CGE_EXITCODE CGE_CommandBufferNew(CGE_Engine *engine, CGE_CommandBuffer *buffer, Uint32 commands, Uint32 vertices)
+{
+	/* Storage comes from the frame arena, so buffers are created and */
+	/* filled on the engine thread. What they cull is counted per buffer */
+	/* and added to the frame's statistics on submit */
+	buffer->commands = (CGE_DrawCommand *)CGE_FrameAlloc(engine, commands * sizeof(CGE_DrawCommand));
+	buffer->vertices = (CGE_V3 *)CGE_FrameAlloc(engine, vertices * sizeof(CGE_V3));
+
+	/* Until the arena has grown to what was asked, keep the default size */
+	/* rather than dropping every command */
+	if(buffer->commands == NULL && commands > CGE_COMMANDS_SIZE)
+	{
+		commands = CGE_COMMANDS_SIZE;
+		buffer->commands = (CGE_DrawCommand *)CGE_FrameAlloc(engine, commands * sizeof(CGE_DrawCommand));
+	}
+	if(buffer->vertices == NULL && vertices > CGE_COMMANDS_VERTICES)
+	{
+		vertices = CGE_COMMANDS_VERTICES;
+		buffer->vertices = (CGE_V3 *)CGE_FrameAlloc(engine, vertices * sizeof(CGE_V3));
+	}
+	buffer->count = 0;
+	buffer->capacity = buffer->commands == NULL ? 0 : commands;
+	buffer->verticesCount = 0;
+	buffer->verticesCapacity = buffer->vertices == NULL ? 0 : vertices;
+	buffer->commandsNeeded = 0;
+	buffer->verticesNeeded = 0;
+	buffer->linesCulled = 0;
+	buffer->pointsCulled = 0;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_CommandPoint(CGE_Engine *engine, CGE_CommandBuffer *buffer, CGE_Point p, Uint8 state)
+{
+	CGE_DrawCommand *command;
+	Uint32 key;
+
+	buffer->verticesNeeded += 1;
+
+	/* Extend the last command when it draws the same thing at about the */
+	/* same depth, so the first point's key stands for the whole batch */
+	key = CGE_CommandKey(engine, p.position, p.color, state);
+	command = buffer->count > 0 ? &buffer->commands[buffer->count - 1] : NULL;
+	if(command == NULL || command->primitive != CGE_PRIMITIVE_POINTS || command->state != state
+	|| command->color.r != p.color.r || command->color.g != p.color.g || command->color.b != p.color.b
+	|| command->key >> (8 + CGE_COMMANDS_BUCKET_SHIFT) != key >> (8 + CGE_COMMANDS_BUCKET_SHIFT)
+	|| command->count >= CGE_COMMANDS_BATCH)
+	{
+		buffer->commandsNeeded += 1;
+		if(buffer->count >= buffer->capacity || buffer->verticesCount >= buffer->verticesCapacity)
+		{
+			return CGE_ERR;
+		}
+
+		command = &buffer->commands[buffer->count++];
+		command->key = key;
+		command->first = 0;
+		command->count = 0;
+		command->vertices = &buffer->vertices[buffer->verticesCount];
+		command->mesh = NULL;
+		command->model = NULL;
+		command->cloud = NULL;
+		command->billboard = NULL;
+		command->color = p.color;
+		command->primitive = CGE_PRIMITIVE_POINTS;
+		command->state = state;
+	}
+
+	if(buffer->verticesCount >= buffer->verticesCapacity)
+	{
+		return CGE_ERR;
+	}
+
+	buffer->vertices[buffer->verticesCount++] = p.position;
+	command->count++;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_CommandLine(CGE_Engine *engine, CGE_CommandBuffer *buffer, CGE_Line l, Uint8 state)
+{
+	CGE_DrawCommand *command;
+	Uint32 key;
+
+	buffer->verticesNeeded += 2;
+
+	key = CGE_CommandKey(engine, l.point1.position, l.point1.color, state);
+	command = buffer->count > 0 ? &buffer->commands[buffer->count - 1] : NULL;
+	if(command == NULL || command->primitive != CGE_PRIMITIVE_LINES || command->state != state
+	|| command->color.r != l.point1.color.r || command->color.g != l.point1.color.g || command->color.b != l.point1.color.b
+	|| command->key >> (8 + CGE_COMMANDS_BUCKET_SHIFT) != key >> (8 + CGE_COMMANDS_BUCKET_SHIFT)
+	|| command->count >= CGE_COMMANDS_BATCH * 2)
+	{
+		buffer->commandsNeeded += 1;
+		if(buffer->count >= buffer->capacity || buffer->verticesCount + 2 > buffer->verticesCapacity)
+		{
+			return CGE_ERR;
+		}
+
+		command = &buffer->commands[buffer->count++];
+		command->key = key;
+		command->first = 0;
+		command->count = 0;
+		command->vertices = &buffer->vertices[buffer->verticesCount];
+		command->mesh = NULL;
+		command->model = NULL;
+		command->cloud = NULL;
+		command->billboard = NULL;
+		command->color = l.point1.color;
+		command->primitive = CGE_PRIMITIVE_LINES;
+		command->state = state;
+	}
+
+	if(buffer->verticesCount + 2 > buffer->verticesCapacity)
+	{
+		return CGE_ERR;
+	}
+
+	buffer->vertices[buffer->verticesCount++] = l.point1.position;
+	buffer->vertices[buffer->verticesCount++] = l.point2.position;
+	command->count += 2;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_CommandMesh(CGE_Engine *engine, CGE_CommandBuffer *buffer, const CGE_Mesh *mesh, Uint8 state)
+{
+	if(CGE_BoundsVisible(engine, mesh->min, mesh->max) == 0)
+	{
+		buffer->linesCulled += mesh->indices / 2;
+		return CGE_OK;
+	}
+
+	return CGE_CommandMeshVisible(engine, buffer, mesh, NULL, state);
+}
+
+CGE_EXITCODE CGE_CommandMeshVisible(CGE_Engine *engine, CGE_CommandBuffer *buffer, const CGE_Mesh *mesh, const CGE_M4 *model, Uint8 state)
+{
+	CGE_DrawCommand *command;
+	CGE_V3 center;
+	float distance;
+	float scale;
+	float axis;
+	Uint32 first;
+	Uint32 count;
+
+	/* The command points into the mesh, nothing is copied */
+	center = CGE_V3ScalarMul(CGE_V3V3Add(mesh->min, mesh->max), 0.5f);
+	distance = CGE_V3Length(CGE_V3V3Sub(center, engine->camera.position));
+
+	if(model != NULL)
+	{
+		/* An instance is sorted at its world centre and picks its level of */
+		/* detail as if unscaled, so a copy twice as big keeps more detail */
+		center = CGE_V3New(model->m11 * center.x + model->m12 * center.y + model->m13 * center.z + model->m14,
+			model->m21 * center.x + model->m22 * center.y + model->m23 * center.z + model->m24,
+			model->m31 * center.x + model->m32 * center.y + model->m33 * center.z + model->m34);
+		scale = CGE_V3Length(CGE_V3New(model->m11, model->m21, model->m31));
+		axis = CGE_V3Length(CGE_V3New(model->m12, model->m22, model->m32));
+		scale = axis > scale ? axis : scale;
+		axis = CGE_V3Length(CGE_V3New(model->m13, model->m23, model->m33));
+		scale = axis > scale ? axis : scale;
+		distance = CGE_V3Length(CGE_V3V3Sub(center, engine->camera.position));
+		if(scale > 0.0f)
+		{
+			distance /= scale;
+		}
+	}
+
+	CGE_MeshLod(mesh, distance, &first, &count);
+
+	buffer->commandsNeeded += 1;
+	if(buffer->count >= buffer->capacity)
+	{
+		return CGE_ERR;
+	}
+
+	command = &buffer->commands[buffer->count++];
+	command->key = CGE_CommandKey(engine, center, mesh->color, state);
+	command->first = first;
+	command->count = count;
+	command->vertices = NULL;
+	command->mesh = mesh;
+	command->model = model;
+	command->cloud = NULL;
+	command->billboard = NULL;
+	command->color = mesh->color;
+	command->primitive = CGE_PRIMITIVE_MESH;
+	command->state = state;
+
+	return CGE_OK;
+}
+
+/* Culling runs on the job workers, recording stays in mesh order */
+CGE_EXITCODE CGE_CommandMeshes(CGE_Engine *engine, CGE_CommandBuffer *buffer, const CGE_Mesh *meshes, Uint32 count, Uint8 state)
+{
+	CGE_JobCounter counter;
+	CGE_MeshJob job;
+	Uint32 i;
+
+	job.engine = engine;
+	job.mesh = meshes;
+	job.model = NULL;
+	job.visible = (Uint8 *)CGE_FrameAlloc(engine, count);
+	if(job.visible == NULL)
+	{
+		for(i = 0; i < count; i++)
+		{
+			CGE_CommandMesh(engine, buffer, &meshes[i], state);
+		}
+		return CGE_ERR;
+	}
+
+	counter.value = 0;
+	CGE_JobsFor(&engine->jobs, "cull", CGE_CullJob, &job, count, 16, &counter);
+	CGE_JobsWait(&engine->jobs, &counter);
+
+	for(i = 0; i < count; i++)
+	{
+		if(job.visible[i] == 1)
+		{
+			CGE_CommandMeshVisible(engine, buffer, &meshes[i], NULL, state);
+		}
+		else
+		{
+			buffer->linesCulled += meshes[i].indices / 2;
+		}
+	}
+
+	return CGE_OK;
+}
+
+/* One command per visible instance, all pointing at the same vertices. */
+/* The models must stay alive until the buffer is submitted */
+CGE_EXITCODE CGE_CommandInstances(CGE_Engine *engine, CGE_CommandBuffer *buffer, const CGE_Mesh *mesh, const CGE_M4 *models, Uint32 count, Uint8 state)
+{
+	CGE_JobCounter counter;
+	CGE_MeshJob job;
+	Uint32 i;
+
+	job.engine = engine;
+	job.mesh = mesh;
+	job.model = models;
+	job.visible = (Uint8 *)CGE_FrameAlloc(engine, count);
+	if(job.visible == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	counter.value = 0;
+	CGE_JobsFor(&engine->jobs, "instances", CGE_InstanceCullJob, &job, count, 64, &counter);
+	CGE_JobsWait(&engine->jobs, &counter);
+
+	for(i = 0; i < count; i++)
+	{
+		if(job.visible[i] == 1)
+		{
+			CGE_CommandMeshVisible(engine, buffer, mesh, &models[i], state);
+		}
+		else
+		{
+			buffer->linesCulled += mesh->indices / 2;
+		}
+	}
+
+	return CGE_OK;
+}
+
+void CGE_CullJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_MeshJob *job;
+	Uint32 i;
+
+	job = (CGE_MeshJob *)data;
+	for(i = first; i < first + count; i++)
+	{
+		job->visible[i] = (Uint8)CGE_BoundsVisible(job->engine, job->mesh[i].min, job->mesh[i].max);
+	}
+}
+
+void CGE_InstanceCullJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_MeshJob *job;
+	CGE_V3 min;
+	CGE_V3 max;
+	Uint32 i;
+
+	/* Bounds are moved to the world, the vertices are not touched */
+	job = (CGE_MeshJob *)data;
+	for(i = first; i < first + count; i++)
+	{
+		CGE_BoundsTransform(job->model[i], job->mesh->min, job->mesh->max, &min, &max);
+		job->visible[i] = (Uint8)CGE_BoundsVisible(job->engine, min, max);
+	}
+}
+
+/* Distance along the first view, on a log scale so far buckets stay useful */
+Uint32 CGE_CommandDepth(CGE_Engine *engine, CGE_V3 p)
+{
+	float w;
+	Uint32 depth;
+
+	w = (engine->device.transform[12][0] * p.x) + (engine->device.transform[13][0] * p.y)
+		+ (engine->device.transform[14][0] * p.z) + engine->device.transform[15][0];
+	depth = 0;
+	if(w > 0.0f)
+	{
+		depth = (Uint32)(log(1.0f + w) * 2048.0f);
+	}
+	if(depth > 0xFFFF)
+	{
+		depth = 0xFFFF;
+	}
+
+	return depth;
+}
+
+Uint32 CGE_CommandKey(CGE_Engine *engine, CGE_V3 p, SDL_Color color, Uint8 state)
+{
+	Uint32 depth;
+	Uint32 hash;
+
+	depth = CGE_CommandDepth(engine, p);
+	hash = ((Uint32)color.r * 7 + (Uint32)color.g * 5 + (Uint32)color.b * 3) & 0xFF;
+
+	/* state | back to front depth | colour */
+	return ((Uint32)state << 24) | ((0xFFFF - depth) << 8) | hash;
+}
+
+CGE_EXITCODE CGE_CommandsSort(CGE_DrawCommand *commands, CGE_DrawCommand *temp, Uint32 count)
+{
+	Uint32 histogram[256];
+	Uint32 offset;
+	Uint32 total;
+	Uint32 i;
+	int shift;
+	CGE_DrawCommand *swap;
+
+	/* Stable LSD radix sort, one byte of the key per pass, an even number */
+	/* of passes leaves the result back in commands */
+	for(shift = 0; shift < 32; shift += 8)
+	{
+		memset(histogram, 0, sizeof(histogram));
+		for(i = 0; i < count; i++)
+		{
+			histogram[(commands[i].key >> shift) & 0xFF]++;
+		}
+
+		total = 0;
+		for(i = 0; i < 256; i++)
+		{
+			offset = histogram[i];
+			histogram[i] = total;
+			total += offset;
+		}
+
+		for(i = 0; i < count; i++)
+		{
+			temp[histogram[(commands[i].key >> shift) & 0xFF]++] = commands[i];
+		}
+
+		swap = commands;
+		commands = temp;
+		temp = swap;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_CommandsExecute(CGE_Engine *engine, CGE_DrawCommand *commands, Uint32 count)
+{
+	CGE_Point p1;
+	CGE_M4 model;
+	CGE_M4 world;
+	const CGE_M4 *current;
+	const CGE_Mesh *decoded;
+	const CGE_Mesh *decode;
+	Uint32 i;
+	Uint32 j;
+
+	model = engine->device.model;
+	current = NULL;
+	decoded = NULL;
+
+	for(i = 0; i < count; i++)
+	{
+		p1.color = commands[i].color;
+
+		/* Points and lines are recorded in the world */
+		if(commands[i].primitive != CGE_PRIMITIVE_MESH && (current != NULL || decoded != NULL))
+		{
+			CGE_DeviceModel(&engine->device, model);
+			current = NULL;
+			decoded = NULL;
+		}
+
+		if(commands[i].primitive == CGE_PRIMITIVE_LINES)
+		{
+			for(j = 0; j + 1 < commands[i].count; j += 2)
+			{
+				CGE_DrawSegment(engine, commands[i].vertices[j], commands[i].vertices[j + 1], commands[i].color);
+			}
+		}
+		else if(commands[i].primitive == CGE_PRIMITIVE_MESH)
+		{
+			/* Packets hold clip space lines, the model can change under them. */
+			/* A quantized mesh has its decoding folded into the model */
+			decode = commands[i].mesh->qx != NULL ? commands[i].mesh : NULL;
+			if(commands[i].model != current || decode != decoded)
+			{
+				world = commands[i].model != NULL ? *commands[i].model : model;
+				CGE_DeviceModel(&engine->device, decode != NULL ? CGE_M4M4Mul(world, CGE_MeshDecode(decode)) : world);
+				current = commands[i].model;
+				decoded = decode;
+			}
+			CGE_DrawMeshRange(engine, commands[i].mesh, commands[i].first, commands[i].count, commands[i].color);
+		}
+		else if(commands[i].primitive == CGE_PRIMITIVE_CLOUD)
+		{
+			CGE_LinePacketFlush(engine);
+			CGE_DrawPointCloud(engine, commands[i].cloud);
+		}
+		else if(commands[i].primitive == CGE_PRIMITIVE_BILLBOARD)
+		{
+			CGE_LinePacketFlush(engine);
+			for(j = 0; j < commands[i].count; j++)
+			{
+				CGE_DrawBillboard(engine, &commands[i].billboard[j]);
+			}
+		}
+		else
+		{
+			/* Lines queued before the points are drawn first */
+			CGE_LinePacketFlush(engine);
+			for(j = 0; j < commands[i].count; j++)
+			{
+				p1.position = commands[i].vertices[j];
+				CGE_DrawPoint(engine, p1);
+			}
+		}
+	}
+
+	if(current != NULL || decoded != NULL)
+	{
+		CGE_DeviceModel(&engine->device, model);
+	}
+
+	return CGE_LinePacketFlush(engine);
+}
+
+CGE_EXITCODE CGE_CommandBufferSubmit(CGE_Engine *engine, CGE_CommandBuffer **buffers, int count)
+{
+	CGE_DrawCommand *merged;
+	CGE_DrawCommand *temp;
+	Uint32 total;
+	Uint32 offset;
+	int i;
+
+	total = 0;
+	for(i = 0; i < count; i++)
+	{
+		total += buffers[i]->count;
+		engine->states.counters.linesCulled += buffers[i]->linesCulled;
+		engine->states.counters.pointsCulled += buffers[i]->pointsCulled;
+	}
+
+	merged = (CGE_DrawCommand *)CGE_FrameAlloc(engine, total * sizeof(CGE_DrawCommand));
+	temp = (CGE_DrawCommand *)CGE_FrameAlloc(engine, total * sizeof(CGE_DrawCommand));
+
+	if(merged == NULL || temp == NULL)
+	{
+		/* Out of frame memory, draw in recording order */
+		for(i = 0; i < count; i++)
+		{
+			CGE_CommandsExecute(engine, buffers[i]->commands, buffers[i]->count);
+		}
+		return CGE_ERR;
+	}
+
+	/* Buffers are merged in order, the stable sort keeps recording order */
+	/* between commands of equal keys */
+	offset = 0;
+	for(i = 0; i < count; i++)
+	{
+		memcpy(&merged[offset], buffers[i]->commands, buffers[i]->count * sizeof(CGE_DrawCommand));
+		offset += buffers[i]->count;
+	}
+
+	CGE_CommandsSort(merged, temp, total);
+	CGE_CommandsExecute(engine, merged, total);
+
+	return CGE_OK;
+}
+
+
+/* Game engine functions implementations */
+
+CGE_EXITCODE CGE_Init(CGE_Engine **engine)
+{
+	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER);
+	SDL_EnableUNICODE(1);
+
+	if(CGE_InitEngine(engine, SDL_SetVideoMode(CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT, 16, SDL_HWSURFACE), 0) == CGE_ERR)
+	{
+		SDL_Quit();
+		return CGE_ERR;
+	}
+	(*engine)->idle.timer = SDL_AddTimer(CGE_IDLE_TICK, CGE_IdleTimer, NULL);
+
+	return CGE_OK;
+}
+
+/* An engine rendering into its own surface, for as many engines as wanted */
+/* in one process. SDL must be initialised first. Engines are created and */
+/* freed one at a time, each may then render on its own thread, which */
+/* calls CGE_JobsAttach before its first frame. workers 0 uses every core, */
+/* engines rendering side by side are better with one each */
+CGE_EXITCODE CGE_InitOffscreen(CGE_Engine **engine, int workers)
+{
+	SDL_Surface *screen;
+
+	screen = SDL_CreateRGBSurface(SDL_SWSURFACE, CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT, 16, 0xF800, 0x07E0, 0x001F, 0);
+	if(screen == NULL)
+	{
+		return CGE_ERR;
+	}
+	if(CGE_InitEngine(engine, screen, workers) == CGE_ERR)
+	{
+		SDL_FreeSurface(screen);
+		return CGE_ERR;
+	}
+	(*engine)->offscreen = 1;
+	(*engine)->idle.enabled = 0;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_InitEngine(CGE_Engine **engine, SDL_Surface *screen, int workers)
+{
+	CGE_Engine *newengine = NULL;
+	newengine = (CGE_Engine *)malloc(sizeof(CGE_Engine));
+	if(newengine == NULL || screen == NULL)
+	{
+		free(newengine);
+		return CGE_ERR;
+	}
+	/* Whatever is not built yet frees as nothing when init fails */
+	memset(newengine, 0, sizeof(CGE_Engine));
+
+	/* Counted by SDL_ttf, each engine opens its own font */
+	TTF_Init();
+
+	newengine->screen = screen;
+	newengine->offscreen = 0;
+	newengine->hud = 1;
+	newengine->states.status = CGE_ENGINESTATESSTATUS_STARTED;	
+	memset(&newengine->states.inputs, 0, sizeof(CGE_EngineStatesInputs));
+
+	newengine->font = TTF_OpenFont("/usr/share/fonts/truetype/freefont/FreeMono.ttf", 14);
+	CGE_GlyphsNew(newengine);
+	
+	newengine->states.timers.absolute = SDL_GetTicks();
+	newengine->states.timers.elapsed = 0;
+	newengine->states.timers.fps = 0;
+	newengine->states.timers.fpsFrames = 0;
+	newengine->states.timers.fpsTicks = 0;
+
+	newengine->idle.hud = (Uint16 *)malloc(CGE_SCREEN_WIDTH * (CGE_SCREEN_HEIGHT - CGE_HUD_TOP) * sizeof(Uint16));
+	if(CGE_FramesNew(newengine, CGE_ARENA_SIZE, 2) == CGE_ERR || CGE_JobsNew(&newengine->jobs, workers) == CGE_ERR
+	|| CGE_ResolutionNew(newengine, CGE_RESOLUTION_BUDGET) == CGE_ERR || CGE_HashNew(&newengine->collision, CGE_HASH_CELL) == CGE_ERR
+	|| CGE_EntitiesNew(&newengine->entities) == CGE_ERR || newengine->idle.hud == NULL)
+	{
+		free(newengine->idle.hud);
+		CGE_EntitiesFree(&newengine->entities);
+		CGE_HashFree(&newengine->collision);
+		CGE_ResolutionFree(newengine);
+		CGE_JobsFree(&newengine->jobs);
+		CGE_FramesFree(newengine);
+		CGE_GlyphsFree(newengine);
+		if(newengine->font != NULL)
+		{
+			TTF_CloseFont(newengine->font);
+		}
+		TTF_Quit();
+		free(newengine);
+		return CGE_ERR;
+	}
+	newengine->vertices.clip = NULL;
+	newengine->vertices.outcode = NULL;
+	newengine->packet.count = 0;
+	newengine->instances.model = NULL;
+	newengine->instances.count = 0;
+	newengine->markers.textures = 0;
+	newengine->markers.billboard = NULL;
+	newengine->markers.count = 0;
+	CGE_HierarchyNew(&newengine->rig.hierarchy);
+	CGE_WorldNew(&newengine->world);
+	newengine->rig.length = NULL;
+	newengine->rig.collider = NULL;
+	newengine->rig.animated = NULL;
+	newengine->rig.base = NULL;
+	newengine->rig.count = 0;
+	newengine->rig.phase = 0.0f;
+	memset(&newengine->output, 0, sizeof(CGE_EngineOutput));
+	newengine->depth.buffer = NULL;
+	newengine->depth.width = 0;
+	newengine->depth.height = 0;
+	newengine->heat.mode = CGE_STATSMODE_OFF;
+	newengine->heat.buffer = NULL;
+	newengine->heat.width = 0;
+	newengine->heat.height = 0;
+	memset(&newengine->states.counters, 0, sizeof(CGE_EngineStatesStats));
+	memset(&newengine->states.stats, 0, sizeof(CGE_EngineStatesStats));
+	newengine->idle.enabled = 1;
+	newengine->idle.dirty = 1;
+	newengine->idle.waiting = 0;
+	newengine->idle.scale = 1.0f;
+	newengine->idle.fps = -1;
+	newengine->idle.timer = NULL;
+	newengine->commands.commandsNeeded = 0;
+	newengine->commands.verticesNeeded = 0;
+
+	CGE_SetCamera(newengine, CGE_V3New(0.0f, 0.0f, 100.0f), CGE_V3New(0.0f, 0.0f, 0.0f)); 
+	/*newengine->camera.projection = CGE_M4Orthographic(-0.8f, 0.8f, -0.6f, 0.6f, 1.0f, 100.0f);*/
+	newengine->camera.projection = CGE_M4Perspective(-0.4f, 0.4f, -0.3f, 0.3f, 1.0f, 100.0f);
+	
+	newengine->device.model = CGE_M4Identity();
+	newengine->device.views = 0;
+	CGE_ViewsSingle(newengine);
+
+	newengine->point[0] = CGE_PointNew(0.5f, -0.5f, 0.0f, 255, 255, 255);
+	newengine->point[1] = CGE_PointNew(0.5f, 0.5f, 0.0f, 255, 255, 255);
+	newengine->point[2] = CGE_PointNew(-0.5f, 0.5f, 0.0f, 255, 255, 255);
+	newengine->point[3] = CGE_PointNew(-0.5f, -0.5f, 0.0f, 255, 255, 255);
+
+	newengine->axe[0] = CGE_LineNew(CGE_PointNew(0.0f, 0.0f, 0.0f, 0, 0, 255), CGE_PointNew(10.0f, 0.0f, 0.0f, 0, 0, 255)); /*x=b*/
+	newengine->axe[1] = CGE_LineNew(CGE_PointNew(0.0f, 0.0f, 0.0f, 0, 255, 0), CGE_PointNew(0.0f, 10.0f, 0.0f, 0, 255, 0)); /*y=g*/
+	newengine->axe[2] = CGE_LineNew(CGE_PointNew(0.0f, 0.0f, 0.0f, 255, 0, 0), CGE_PointNew(0.0f, 0.0f, 10.0f, 255, 0, 0)); /*z=r*/
+
+	newengine->grid = CGE_GridNew(10.0f, 100000.0f, -10.0f, 8.0f, CGE_ColorNew(80, 20, 0));
+
+	newengine->scene.map = NULL;
+	newengine->scene.size = 0;
+	newengine->scene.meshes = 0;
+	newengine->scene.mesh = NULL;
+	CGE_PointCloudNew(&newengine->cloud, 0, 0);
+#ifdef CGE_DEBUG
+	newengine->overlay.count = 0;
+	newengine->overlay.trace = 0;
+#endif
+#ifdef CGE_ALLOCS
+	CGE_AtomicAdd(&CGE_AllocTracker.engines, 1);
+#endif
+
+	*engine = newengine;	
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_GetInputs(CGE_Engine *engine)
+{	
+	SDL_Event e;
+	
+	if(engine->idle.waiting == 1)
+	{
+		SDL_WaitEvent(&e);
+		CGE_MapInputsPhysicals(engine, e);
+		CGE_MapInputsLogicals(engine);
+
+		/* Motion starts from the wake, not from the last frame */
+		if(e.type != SDL_USEREVENT)
+		{
+			engine->states.timers.absolute = SDL_GetTicks();
+		}
+	}
+
+	while(SDL_PollEvent(&e))
+	{
+		CGE_MapInputsPhysicals(engine, e);
+		CGE_MapInputsLogicals(engine);
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_MapInputsPhysicals(CGE_Engine *engine, SDL_Event e)
+{
+
+	switch(e.type)
+	{
+		case SDL_KEYDOWN:
+			switch (e.key.keysym.sym)
+			{
+				case SDLK_ESCAPE:
+					engine->states.status = CGE_ENGINESTATESSTATUS_STOPPED;
+					break;
+				case SDLK_F1:
+					CGE_SetStatsMode(engine, (CGE_StatsMode)((engine->heat.mode + 1) % 3));
+					CGE_Invalidate(engine);
+					break;
+				case SDLK_LEFT:
+					engine->states.inputs.physicals.CGE_KeyLeft = 1;
+					break;
+				case SDLK_RIGHT:
+					engine->states.inputs.physicals.CGE_KeyRight = 1;
+					break;
+				case SDLK_UP:
+					engine->states.inputs.physicals.CGE_KeyUp = 1;
+					break;
+				case SDLK_DOWN:
+					engine->states.inputs.physicals.CGE_KeyDown = 1;
+					break;
+				case SDLK_a:
+					engine->states.inputs.physicals.CGE_KeyA = 1;
+					break;
+				case SDLK_d:
+					engine->states.inputs.physicals.CGE_KeyD = 1;
+					break;
+				case SDLK_w:
+					engine->states.inputs.physicals.CGE_KeyW = 1;
+					break;
+				case SDLK_s:
+					engine->states.inputs.physicals.CGE_KeyS = 1;
+					break;
+				case SDLK_q:
+					engine->states.inputs.physicals.CGE_KeyQ = 1;
+					break;
+				case SDLK_e:
+					engine->states.inputs.physicals.CGE_KeyE = 1;
+					break;
+				default:
+					break;
+			}
+			break;
+		case SDL_KEYUP:
+			switch (e.key.keysym.sym)
+			{
+				case SDLK_ESCAPE:
+					break;
+				case SDLK_LEFT:
+					engine->states.inputs.physicals.CGE_KeyLeft = 0;
+					break;
+				case SDLK_RIGHT:
+					engine->states.inputs.physicals.CGE_KeyRight = 0;
+					break;
+				case SDLK_UP:
+					engine->states.inputs.physicals.CGE_KeyUp = 0;
+					break;
+				case SDLK_DOWN:
+					engine->states.inputs.physicals.CGE_KeyDown = 0;
+					break;
+				case SDLK_a:
+					engine->states.inputs.physicals.CGE_KeyA = 0;
+					break;
+				case SDLK_d:
+					engine->states.inputs.physicals.CGE_KeyD = 0;
+					break;
+				case SDLK_w:
+					engine->states.inputs.physicals.CGE_KeyW = 0;
+					break;
+				case SDLK_s:
+					engine->states.inputs.physicals.CGE_KeyS = 0;
+					break;
+				case SDLK_q:
+					engine->states.inputs.physicals.CGE_KeyQ = 0;
+					break;
+				case SDLK_e:
+					engine->states.inputs.physicals.CGE_KeyE = 0;
+					break;
+				default:
+					break;
+			}
+			break;
+		case SDL_VIDEOEXPOSE:
+			CGE_Invalidate(engine);
+			break;
+		case SDL_QUIT: 
+			engine->states.status = CGE_ENGINESTATESSTATUS_STOPPED;
+			break;
+		default:
+			break;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_MapInputsLogicals(CGE_Engine *engine)
+{
+	engine->states.inputs.logicals.CGE_Yaw = 0.0f;
+	engine->states.inputs.logicals.CGE_Pitch = 0.0f;
+	engine->states.inputs.logicals.CGE_Roll = 0.0f;
+	engine->states.inputs.logicals.CGE_AxisX = 0.0f;
+	engine->states.inputs.logicals.CGE_AxisY = 0.0f;
+	engine->states.inputs.logicals.CGE_AxisZ = 0.0f;
+	engine->states.inputs.logicals.CGE_Advance = 0.0f;
+	engine->states.inputs.logicals.CGE_Strafe = 0.0f;
+	
+
+	if(engine->states.inputs.physicals.CGE_KeyLeft == 1)
+	{
+		engine->states.inputs.logicals.CGE_Strafe -= 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyRight == 1)
+	{
+		engine->states.inputs.logicals.CGE_Strafe += 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyUp == 1)
+	{
+		engine->states.inputs.logicals.CGE_Advance += 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyDown == 1)
+	{
+		engine->states.inputs.logicals.CGE_Advance -= 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyA == 1)
+	{
+		engine->states.inputs.logicals.CGE_Yaw += 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyD == 1)
+	{
+		engine->states.inputs.logicals.CGE_Yaw -= 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyW == 1)
+	{
+		engine->states.inputs.logicals.CGE_Pitch += 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyS == 1)
+	{
+		engine->states.inputs.logicals.CGE_Pitch -= 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyQ == 1)
+	{
+		engine->states.inputs.logicals.CGE_Roll += 1.0f;
+	}
+	if(engine->states.inputs.physicals.CGE_KeyE == 1)
+	{
+		engine->states.inputs.logicals.CGE_Roll -= 1.0f;
+	}
+	
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_GetTimers(CGE_Engine *engine)
+{
+	Uint32 absolute = SDL_GetTicks();
+	engine->states.timers.elapsed = absolute - engine->states.timers.absolute;
+	engine->states.timers.absolute = absolute;
+
+	engine->states.timers.fpsFrames++;
+	engine->states.timers.fpsTicks += engine->states.timers.elapsed;
+	if(engine->states.timers.fpsTicks > 1000)
+	{
+		/*printf("fps: %d/sec\n", engine->states.timers.fpsFrames);*/
+		engine->states.timers.fps = engine->states.timers.fpsFrames;
+		engine->states.timers.fpsFrames = 0;
+		engine->states.timers.fpsTicks = 0;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_Move(CGE_Engine *engine)
+{	
+	float t;
+	CGE_V4 forward;
+	CGE_V4 left;
+	CGE_V4 velocity;
+	CGE_M4 rotate;
+
+	t = (float)engine->states.timers.elapsed;
+		
+	engine->camera.axis.x += engine->states.inputs.logicals.CGE_Pitch * 0.05f * t;
+	engine->camera.axis.y += engine->states.inputs.logicals.CGE_Yaw * 0.05f * t;
+	engine->camera.axis.z += engine->states.inputs.logicals.CGE_Roll * 0.05f *t;
+
+	if(engine->camera.axis.x > 40.0f)
+	{
+		engine->camera.axis.x = 40.0f;
+	}
+	if(engine->camera.axis.x < -40.0f)
+	{
+		engine->camera.axis.x = -40.0f;
+	}
+	if(engine->camera.axis.y > 180.0f)
+	{
+		engine->camera.axis.y = -180.0f;
+	}
+	if(engine->camera.axis.y < -180.0f)
+	{
+		engine->camera.axis.y = 180.0f;
+	}
+	if(engine->camera.axis.z > 10.0f)
+	{
+		engine->camera.axis.z = 10.0f;
+	}
+	if(engine->camera.axis.z < -10.0f)
+	{
+		engine->camera.axis.z = -10.0f;
+	}
+
+	rotate = CGE_M4Rotate(engine->camera.axis.y, 0.0f, 1.0f, 0.0f);
+	forward = CGE_V4New(0.0f, 0.0f, -1.0f, 0.0f);
+	left = CGE_V4New(1.0f, 0.0f, 0.0f, 0.0f);
+	forward = CGE_M4V4Mul(rotate, forward);
+	left = CGE_M4V4Mul(rotate, left);
+	forward = CGE_V4ScalarMul(forward, engine->states.inputs.logicals.CGE_Advance);
+	left = CGE_V4ScalarMul(left, engine->states.inputs.logicals.CGE_Strafe);
+	velocity = CGE_V4V4Add(forward, left);
+	velocity = CGE_V4Normalize(velocity);
+	
+	engine->camera.position = CGE_SlideMove(&engine->collision, engine->camera.position,
+		CGE_V3New(velocity.x * 0.05f * t, velocity.y * 0.05f * t, velocity.z * 0.05f * t), CGE_CAMERA_RADIUS);
+
+	if(engine->entities.count > 0)
+	{
+		CGE_EntitiesIntegrate(&engine->entities, t * 0.001f);
+		CGE_EntitiesConfine(&engine->entities, CGE_V3New(-CGE_ENTITIES_AREA, 0.0f, -CGE_ENTITIES_AREA),
+			CGE_V3New(CGE_ENTITIES_AREA, CGE_ENTITIES_AREA * 0.25f, CGE_ENTITIES_AREA));
+		CGE_Invalidate(engine);
+	}
+
+	if(engine->rig.count > 0)
+	{
+		CGE_RigAnimate(engine, t * 0.001f);
+		CGE_Invalidate(engine);
+	}
+	if(engine->world.chunks > 0)
+	{
+		CGE_WorldUpdate(engine, &engine->world);
+	}
+		
+	engine->camera.view = CGE_M4View(engine->camera.position, engine->camera.axis);
+			
+	/*	
+	engine->camera.position.x += engine->states.inputs.logicals.CGE_AxisX * 0.05f * t;
+	engine->camera.position.y += engine->states.inputs.logicals.CGE_AxisY * 0.05f * t;
+	engine->camera.position.z += engine->states.inputs.logicals.CGE_AxisZ * 0.05f * t;
+	*/
+	/*CGE_SetCamera(engine, engine->camera.position, engine->camera.target);*/
+
+	return CGE_OK;
+}
+
+
+CGE_EXITCODE CGE_Render(CGE_Engine *engine)
+{	
+	CGE_CommandBuffer *buffers[1];
+	Uint32 commands;
+	Uint32 vertices;
+
+	CGE_ResolutionGovern(engine);
+	CGE_OutputBegin(engine, 1);
+
+	if(SDL_MUSTLOCK(engine->screen))
+	{
+		if(SDL_LockSurface(engine->screen) < 0)
+		{
+			return CGE_ERR;
+		}
+	}
+
+	CGE_ResolutionClear(engine);
+
+	/* Size this frame's commands after what the last one needed, with an */
+	/* eighth more for what moves into view */
+	commands = engine->commands.commandsNeeded + engine->commands.commandsNeeded / 8;
+	commands = commands > CGE_COMMANDS_SIZE ? commands : CGE_COMMANDS_SIZE;
+	vertices = engine->commands.verticesNeeded + engine->commands.verticesNeeded / 8;
+	vertices = vertices > CGE_COMMANDS_VERTICES ? vertices : CGE_COMMANDS_VERTICES;
+
+#ifdef CGE_ALLOCS
+	CGE_AllocsFrame();
+#endif
+	CGE_FrameBegin(engine);
+#ifdef CGE_DEBUG
+	engine->overlay.count = 0;
+#endif
+	CGE_StatsBegin(engine);
+	CGE_ViewsUpdate(engine);
+	CGE_CommandBufferNew(engine, &engine->commands, commands, vertices);
+
+	
+	CGE_DrawGrid(engine, engine->grid);
+
+	CGE_CommandLine(engine, &engine->commands, engine->axe[0], CGE_DRAWSTATE_OVERLAY);
+	CGE_CommandLine(engine, &engine->commands, engine->axe[1], CGE_DRAWSTATE_OVERLAY);
+	CGE_CommandLine(engine, &engine->commands, engine->axe[2], CGE_DRAWSTATE_OVERLAY);
+
+	CGE_CommandLine(engine, &engine->commands, CGE_LineNew(engine->point[0], engine->point[1]), CGE_DRAWSTATE_SCENE);
+	CGE_CommandLine(engine, &engine->commands, CGE_LineNew(engine->point[1], engine->point[2]), CGE_DRAWSTATE_SCENE);
+	CGE_CommandLine(engine, &engine->commands, CGE_LineNew(engine->point[2], engine->point[0]), CGE_DRAWSTATE_SCENE);
+	CGE_CommandLine(engine, &engine->commands, CGE_LineNew(engine->point[2], engine->point[3]), CGE_DRAWSTATE_SCENE);
+	CGE_CommandLine(engine, &engine->commands, CGE_LineNew(engine->point[3], engine->point[0]), CGE_DRAWSTATE_SCENE);
+
+	CGE_CommandMeshes(engine, &engine->commands, engine->scene.mesh, engine->scene.meshes, CGE_DRAWSTATE_SCENE);
+	if(engine->instances.count > 0)
+	{
+		CGE_CommandInstances(engine, &engine->commands, &engine->scene.mesh[0], engine->instances.model, engine->instances.count, CGE_DRAWSTATE_SCENE);
+	}
+	if(engine->entities.count > 0)
+	{
+		CGE_CommandEntities(engine, &engine->commands, &engine->entities, &engine->scene, CGE_DRAWSTATE_SCENE);
+	}
+	if(engine->rig.hierarchy.nodes > 0)
+	{
+		CGE_CommandRig(engine, &engine->commands, CGE_DRAWSTATE_SCENE);
+	}
+	if(engine->world.chunks > 0)
+	{
+		CGE_CommandWorld(engine, &engine->commands, &engine->world, CGE_DRAWSTATE_SCENE);
+	}
+	if(engine->cloud.points > 0)
+	{
+		CGE_CommandPointCloud(engine, &engine->commands, &engine->cloud, CGE_DRAWSTATE_SCENE);
+	}
+	if(engine->markers.count > 0)
+	{
+		CGE_CommandBillboards(engine, &engine->commands, engine->markers.billboard, engine->markers.count, CGE_DRAWSTATE_OVERLAY);
+	}
+
+	buffers[0] = &engine->commands;
+	CGE_CommandBufferSubmit(engine, buffers, 1);
+	CGE_StatsEnd(engine);
+
+	/* Text is drawn after the upscale so it stays sharp */
+	CGE_ResolutionResolve(engine);
+	CGE_ResolutionUpscale(engine);
+/*
+	CGE_DrawPoint(engine, engine->point[0]);
+	CGE_DrawPoint(engine, engine->point[1]);
+	CGE_DrawPoint(engine, engine->point[2]);
+	CGE_DrawPoint(engine, engine->point[3]);
+*/
+
+	if(engine->hud == 1)
+	{
+		CGE_IdleRetain(engine);
+		CGE_DrawHud(engine);
+	}
+
+/*	
+	CGE_DrawMatrix(engine, engine->device.view[0], CGE_V3New(0.0f, 332.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 255.0f));
+	CGE_DrawMatrix(engine, engine->device.projection[0], CGE_V3New(0.0f, 112.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 255.0f));
+*/
+/*
+	CGE_DrawTextSolid(engine, "Mala", CGE_V3New(0.0f, 14.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 155.0f));
+	CGE_DrawTextSolid(engine, "Osaur", CGE_V3New(0.0f, 28.0f, 0.0f), CGE_ColorNew(155.0f, 255.0f, 255.0f));
+	CGE_DrawTextSolid(engine, "Trrrain", CGE_V3New(0.0f, 42.0f, 0.0f), CGE_ColorNew(255.0f, 155.0f, 255.0f));
+*/
+	/*CGE_M4Print(engine->device.view[0], "view");*/
+	/*CGE_M4Print(engine->device.projection[0], "projection");*/
+
+
+	if(SDL_MUSTLOCK(engine->screen))
+	{
+		SDL_UnlockSurface(engine->screen);
+	}
+
+	CGE_Present(engine, 0, 0, CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT);
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_DrawHud(CGE_Engine *engine)
+{
+	char fps[255];
+
+	sprintf(fps, "FPS : %i", engine->states.timers.fps);
+	CGE_DrawTextSolid(engine, fps, CGE_V3New(0.0f, 580.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 255.0f));
+	CGE_DrawStats(engine);
+
+#ifdef CGE_DEBUG
+	CGE_OverlayDraw(engine);
+#endif
+
+	engine->idle.fps = engine->states.timers.fps;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_DeInit(CGE_Engine *engine)
+{
+	int offscreen;
+
+	offscreen = engine->offscreen;
+	if(offscreen == 0)
+	{
+#ifdef CGE_DEBUG
+		CGE_ArenaPrint(&engine->frames.arena[0], "frame 0");
+		if(engine->frames.buffers == 2)
+		{
+			CGE_ArenaPrint(&engine->frames.arena[1], "frame 1");
+		}
+		CGE_JobsPrint(&engine->jobs);
+#endif
+#ifdef CGE_ALLOCS
+		CGE_AllocsPrint();
+#endif
+	}
+#ifdef CGE_ALLOCS
+	CGE_AtomicAdd(&CGE_AllocTracker.engines, -1);
+#endif
+	CGE_JobsFree(&engine->jobs);
+	CGE_FramesFree(engine);
+	CGE_OutputFree(engine);
+	CGE_ResolutionFree(engine);
+	CGE_GlyphsFree(engine);
+	CGE_InstancesFree(engine);
+	CGE_MarkersFree(engine);
+	CGE_RigFree(engine);
+	CGE_WorldClose(&engine->world);
+	CGE_HashFree(&engine->collision);
+	CGE_EntitiesFree(&engine->entities);
+	CGE_PointCloudFree(&engine->cloud);
+	free(engine->heat.buffer);
+	if(engine->idle.timer != NULL)
+	{
+		SDL_RemoveTimer(engine->idle.timer);
+	}
+	free(engine->idle.hud);
+	CGE_MeshFileClose(&engine->scene);
+	if(engine->font != NULL)
+	{
+		TTF_CloseFont(engine->font);
+	}
+	TTF_Quit();
+	if(offscreen == 1)
+	{
+		SDL_FreeSurface(engine->screen);
+	}
+	free(engine);
+	if(offscreen == 0)
+	{
+		SDL_Quit();
+	}
+		
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_SetCamera(CGE_Engine *engine, CGE_V3 position, CGE_V3 target)
+{	
+	engine->camera.position = position;
+	engine->camera.target = target;	
+	engine->camera.view = CGE_M4View(position, target);
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ViewAdd(CGE_Engine *engine, CGE_Viewport viewport, CGE_M4 projection)
+{
+	CGE_View *view;
+
+	if(engine->views >= CGE_VIEWS_MAX)
+	{
+		return CGE_ERR;
+	}
+
+	view = &engine->view[engine->views];
+	view->camera = engine->camera;
+	view->camera.projection = projection;
+	view->viewport = viewport;
+	view->eye = CGE_V3New(0.0f, 0.0f, 0.0f);
+	view->follow = 1;
+	engine->views++;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ViewSetCamera(CGE_Engine *engine, int index, CGE_V3 position, CGE_V3 axis)
+{
+	CGE_View *view;
+
+	if(index < 0 || index >= engine->views)
+	{
+		return CGE_ERR;
+	}
+
+	view = &engine->view[index];
+	view->camera.position = position;
+	view->camera.axis = axis;
+	view->camera.view = CGE_M4View(position, axis);
+	view->follow = 0;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ViewsSingle(CGE_Engine *engine)
+{
+	engine->views = 0;
+
+	return CGE_ViewAdd(engine, CGE_ViewportNew(0.0f, 0.0f, CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT), engine->camera.projection);
+}
+
+CGE_EXITCODE CGE_ViewsStereo(CGE_Engine *engine, float eye)
+{
+	CGE_M4 projection;
+
+	/* Half width viewports keep the aspect ratio with half the horizontal extent */
+	projection = CGE_M4Perspective(-0.2f, 0.2f, -0.3f, 0.3f, 1.0f, 100.0f);
+
+	engine->views = 0;
+	CGE_ViewAdd(engine, CGE_ViewportNew(0.0f, 0.0f, CGE_SCREEN_WIDTH / 2, CGE_SCREEN_HEIGHT), projection);
+	CGE_ViewAdd(engine, CGE_ViewportNew(CGE_SCREEN_WIDTH / 2, 0.0f, CGE_SCREEN_WIDTH / 2, CGE_SCREEN_HEIGHT), projection);
+	engine->view[0].eye = CGE_V3New(-eye / 2.0f, 0.0f, 0.0f);
+	engine->view[1].eye = CGE_V3New(eye / 2.0f, 0.0f, 0.0f);
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ViewsUpdate(CGE_Engine *engine)
+{
+	CGE_EngineDevice *device;
+	CGE_View *view;
+	float sx;
+	float sy;
+	int i;
+
+	device = &engine->device;
+	device->views = engine->views;
+
+	/* Views are laid out on the screen, the device draws at the render scale. */
+	/* Both axes scale alike so the projections keep their aspect ratio */
+	sx = (float)engine->resolution.width / CGE_SCREEN_WIDTH;
+	sy = (float)engine->resolution.height / CGE_SCREEN_HEIGHT;
+
+	for(i = 0; i < CGE_VIEWS_MAX; i++)
+	{
+		if(i < engine->views)
+		{
+			view = &engine->view[i];
+
+			if(view->follow == 1)
+			{
+				view->camera.position = engine->camera.position;
+				view->camera.axis = engine->camera.axis;
+				view->camera.view = CGE_M4M4Mul(CGE_M4Translate(-view->eye.x, -view->eye.y, -view->eye.z), engine->camera.view);
+			}
+
+			device->view[i] = view->camera.view;
+			device->projection[i] = view->camera.projection;
+			device->viewport[i] = CGE_ViewportNew(view->viewport.x * sx, view->viewport.y * sy, view->viewport.w * sx, view->viewport.h * sy);
+			device->viewProjection[i] = CGE_M4M4Mul(device->projection[i], device->view[i]);
+		}
+		else
+		{
+			/* Unused lanes transform everything to the origin with w = 0, never drawn */
+			memset(&device->viewProjection[i], 0, sizeof(CGE_M4));
+		}
+	}
+
+	return CGE_DeviceModel(device, device->model);
+}
+
+
+CGE_EXITCODE CGE_ResolutionNew(CGE_Engine *engine, float budget)
+{
+	CGE_EngineResolution *resolution;
+	SDL_PixelFormat *format;
+
+	resolution = &engine->resolution;
+	format = engine->screen->format;
+
+	resolution->tiles = (Uint16 *)malloc((size_t)CGE_TILE_COLUMNS * CGE_TILE_ROWS * CGE_TILE_PIXELS * sizeof(Uint16));
+	if(resolution->tiles == NULL)
+	{
+		return CGE_ERR;
+	}
+	resolution->surface = SDL_CreateRGBSurface(SDL_SWSURFACE, CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT,
+	format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+	resolution->budget = budget;
+	resolution->average = 0.0f;
+	resolution->settle = 0;
+
+	return CGE_ResolutionSet(engine, 1.0f);
+}
+
+CGE_EXITCODE CGE_ResolutionSet(CGE_Engine *engine, float scale)
+{
+	CGE_EngineResolution *resolution;
+
+	resolution = &engine->resolution;
+
+	if(scale > 1.0f || resolution->surface == NULL)
+	{
+		scale = 1.0f;
+	}
+	if(scale < CGE_RESOLUTION_MIN)
+	{
+		scale = CGE_RESOLUTION_MIN;
+	}
+
+	resolution->scale = scale;
+	resolution->width = (int)(CGE_SCREEN_WIDTH * scale + 0.5f);
+	resolution->height = (int)(CGE_SCREEN_HEIGHT * scale + 0.5f);
+	resolution->target = scale < 1.0f ? resolution->surface : engine->screen;
+
+	return CGE_OK;
+}
+
+/* Holds the frame time under budget milliseconds by trading resolution, */
+/* shrinking fast, growing back slowly and letting the average settle */
+/* after each change so it does not oscillate */
+CGE_EXITCODE CGE_ResolutionGovern(CGE_Engine *engine)
+{
+	CGE_EngineResolution *resolution;
+
+	resolution = &engine->resolution;
+	if(resolution->budget <= 0.0f)
+	{
+		return CGE_OK;
+	}
+
+	resolution->average += ((float)engine->states.timers.elapsed - resolution->average) * 0.1f;
+	if(resolution->settle > 0)
+	{
+		resolution->settle--;
+		return CGE_OK;
+	}
+
+	if(resolution->average > resolution->budget * 1.1f && resolution->scale > CGE_RESOLUTION_MIN)
+	{
+		CGE_ResolutionSet(engine, resolution->scale * 0.9f);
+		resolution->settle = 10;
+	}
+	else if(resolution->average < resolution->budget * 0.7f && resolution->scale < 1.0f)
+	{
+		CGE_ResolutionSet(engine, resolution->scale * 1.05f);
+		resolution->settle = 20;
+	}
+
+	return CGE_OK;
+}
+
+/* Clears the tile rows covering the frame */
+CGE_EXITCODE CGE_ResolutionClear(CGE_Engine *engine)
+{
+	int rows;
+
+	rows = (engine->resolution.height + 7) >> CGE_TILE_SHIFT;
+	memset(engine->resolution.tiles, 0, (size_t)rows * CGE_TILE_COLUMNS * CGE_TILE_PIXELS * sizeof(Uint16));
+
+	return CGE_OK;
+}
+
+/* Copies the tiles into the render target, one band of tile rows per job */
+CGE_EXITCODE CGE_ResolutionResolve(CGE_Engine *engine)
+{
+	CGE_JobCounter counter;
+
+	counter.value = 0;
+	CGE_JobsFor(&engine->jobs, "tiles", CGE_TilesJob, engine, (engine->resolution.height + 7) >> CGE_TILE_SHIFT, 8, &counter);
+	CGE_JobsWait(&engine->jobs, &counter);
+
+	return CGE_OK;
+}
+
+/* Whole tile rows are 16 bytes: one SSE2 load and store each where the */
+/* target has it, otherwise a fixed size memcpy that -O2 inlines */
+void CGE_TilesJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_Engine *engine;
+	SDL_Surface *target;
+	Uint16 *tile;
+	Uint16 *destination;
+	Uint32 row;
+	int columns;
+	int rest;
+	int height;
+	int pitch;
+	int x;
+	int y;
+
+	engine = (CGE_Engine *)data;
+	target = engine->resolution.target;
+	pitch = target->pitch / 2;
+	columns = engine->resolution.width >> CGE_TILE_SHIFT;
+	rest = engine->resolution.width & 7;
+
+	for(row = first; row < first + count; row++)
+	{
+		height = engine->resolution.height - (int)(row << CGE_TILE_SHIFT);
+		height = height < 8 ? height : 8;
+		for(y = 0; y < height; y++)
+		{
+			tile = engine->resolution.tiles + row * CGE_TILE_COLUMNS * CGE_TILE_PIXELS + (y << 3);
+			destination = (Uint16 *)target->pixels + ((row << CGE_TILE_SHIFT) + y) * pitch;
+			for(x = 0; x < columns; x++)
+			{
+#ifdef __SSE2__
+				_mm_storeu_si128((__m128i *)destination, _mm_loadu_si128((const __m128i *)tile));
+#else
+				memcpy(destination, tile, 8 * sizeof(Uint16));
+#endif
+				destination += 8;
+				tile += CGE_TILE_PIXELS;
+			}
+			if(rest > 0)
+			{
+				memcpy(destination, tile, rest * sizeof(Uint16));
+			}
+		}
+	}
+}
+
+/* Nearest neighbour stretch of the render target to the screen, */
+/* stepping through the source in 16.16 fixed point */
+CGE_EXITCODE CGE_ResolutionUpscale(CGE_Engine *engine)
+{
+	CGE_EngineResolution *resolution;
+	SDL_Surface *screen;
+	Uint16 *source;
+	Uint16 *destination;
+	Uint32 xstep;
+	Uint32 ystep;
+	Uint32 u;
+	Uint32 v;
+	int x;
+	int y;
+
+	resolution = &engine->resolution;
+	screen = engine->screen;
+	if(resolution->target == screen)
+	{
+		return CGE_OK;
+	}
+
+	xstep = ((Uint32)resolution->width << 16) / CGE_SCREEN_WIDTH;
+	ystep = ((Uint32)resolution->height << 16) / CGE_SCREEN_HEIGHT;
+
+	for(y = 0, v = 0; y < CGE_SCREEN_HEIGHT; y++, v += ystep)
+	{
+		destination = (Uint16 *)screen->pixels + y * (screen->pitch / 2);
+
+		/* Rows sampling the same source row copy the previous one */
+		if(y > 0 && (v >> 16) == ((v - ystep) >> 16))
+		{
+			memcpy(destination, destination - screen->pitch / 2, CGE_SCREEN_WIDTH * sizeof(Uint16));
+			continue;
+		}
+
+		source = (Uint16 *)resolution->surface->pixels + (v >> 16) * (resolution->surface->pitch / 2);
+		for(x = 0, u = 0; x < CGE_SCREEN_WIDTH; x++, u += xstep)
+		{
+			destination[x] = source[u >> 16];
+		}
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ResolutionFree(CGE_Engine *engine)
+{
+	SDL_FreeSurface(engine->resolution.surface);
+	free(engine->resolution.tiles);
+	engine->resolution.surface = NULL;
+	engine->resolution.tiles = NULL;
+	engine->resolution.target = engine->screen;
+
+	return CGE_OK;
+}
+/* Whether the frame on screen is still right. A still camera at a */
+/* governed resolution first gets one frame at full resolution, the */
+/* governed scale coming back when it moves again */
+int CGE_Idle(CGE_Engine *engine)
+{
+	CGE_EngineIdle *idle;
+	CGE_EngineStatesInputsLogicals *logicals;
+	int still;
+
+	idle = &engine->idle;
+	logicals = &engine->states.inputs.logicals;
+
+	still = idle->dirty == 0
+		&& logicals->CGE_Yaw == 0.0f && logicals->CGE_Pitch == 0.0f && logicals->CGE_Roll == 0.0f
+		&& logicals->CGE_Advance == 0.0f && logicals->CGE_Strafe == 0.0f
+		&& memcmp(&idle->position, &engine->camera.position, sizeof(CGE_V3)) == 0
+		&& memcmp(&idle->axis, &engine->camera.axis, sizeof(CGE_V3)) == 0;
+
+	idle->dirty = 0;
+	idle->position = engine->camera.position;
+	idle->axis = engine->camera.axis;
+
+	if(still == 0 || idle->enabled == 0)
+	{
+		if(idle->scale < 1.0f)
+		{
+			CGE_ResolutionSet(engine, idle->scale);
+			idle->scale = 1.0f;
+		}
+		idle->waiting = 0;
+		return 0;
+	}
+
+	if(engine->resolution.scale < 1.0f)
+	{
+		idle->scale = engine->resolution.scale;
+		CGE_ResolutionSet(engine, 1.0f);
+		engine->resolution.settle = 20;
+		idle->waiting = 0;
+		return 0;
+	}
+
+	idle->waiting = 1;
+	return 1;
+}
+
+/* Forces the next frame to be rendered, for changes the camera does not see */
+CGE_EXITCODE CGE_Invalidate(CGE_Engine *engine)
+{
+	engine->idle.dirty = 1;
+
+	return CGE_OK;
+}
+
+/* Keeps the band under the HUD before the text is drawn over it */
+CGE_EXITCODE CGE_IdleRetain(CGE_Engine *engine)
+{
+	SDL_Surface *screen;
+	int y;
+
+	screen = engine->screen;
+	if(engine->idle.hud == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	for(y = CGE_HUD_TOP; y < CGE_SCREEN_HEIGHT; y++)
+	{
+		memcpy(engine->idle.hud + (y - CGE_HUD_TOP) * CGE_SCREEN_WIDTH, (Uint16 *)screen->pixels + y * (screen->pitch / 2),
+			CGE_SCREEN_WIDTH * sizeof(Uint16));
+	}
+
+	return CGE_OK;
+}
+
+/* Redraws and presents the HUD band alone when its text changed */
+CGE_EXITCODE CGE_RenderHud(CGE_Engine *engine)
+{
+	SDL_Surface *screen;
+	int y;
+
+	screen = engine->screen;
+	if(engine->idle.hud == NULL || engine->idle.fps == engine->states.timers.fps)
+	{
+		return CGE_OK;
+	}
+
+	/* The band is redrawn in the frame already shown */
+	CGE_OutputBegin(engine, 0);
+	if(SDL_MUSTLOCK(screen))
+	{
+		if(SDL_LockSurface(screen) < 0)
+		{
+			return CGE_ERR;
+		}
+	}
+
+	for(y = CGE_HUD_TOP; y < CGE_SCREEN_HEIGHT; y++)
+	{
+		memcpy((Uint16 *)screen->pixels + y * (screen->pitch / 2), engine->idle.hud + (y - CGE_HUD_TOP) * CGE_SCREEN_WIDTH,
+			CGE_SCREEN_WIDTH * sizeof(Uint16));
+	}
+	CGE_DrawHud(engine);
+
+	if(SDL_MUSTLOCK(screen))
+	{
+		SDL_UnlockSurface(screen);
+	}
+
+	CGE_Present(engine, 0, CGE_HUD_TOP, CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT - CGE_HUD_TOP);
+
+	return CGE_OK;
+}
+
+/* Runs on SDL's timer thread, the event only wakes the waiting loop */
+Uint32 CGE_IdleTimer(Uint32 interval, void *data)
+{
+	SDL_Event e;
+
+	(void)data;
+	e.type = SDL_USEREVENT;
+	SDL_PushEvent(&e);
+
+	return interval;
+}
+
+/* Maps a ring of frames in shared memory and renders straight into them. */
+/* name is a POSIX shared memory name, like /cge */
+CGE_EXITCODE CGE_OutputShared(CGE_Engine *engine, const char *name)
+{
+	CGE_EngineOutput *output;
+	CGE_SharedFrameHeader *header;
+	SDL_PixelFormat *format;
+	size_t frame;
+	void *map;
+	int fd;
+	int i;
+
+	output = &engine->output;
+	if(output->header != NULL || strlen(name) >= sizeof(output->name))
+	{
+		return CGE_ERR;
+	}
+
+	format = engine->screen->format;
+	frame = ((size_t)CGE_SCREEN_WIDTH * format->BytesPerPixel * CGE_SCREEN_HEIGHT + CGE_SHAREDFRAME_ALIGN - 1)
+		/ CGE_SHAREDFRAME_ALIGN * CGE_SHAREDFRAME_ALIGN;
+	output->size = CGE_SHAREDFRAME_ALIGN + CGE_SHAREDFRAME_SLOTS * frame;
+
+	fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+	{
+		perror(name);
+		return CGE_ERR;
+	}
+	if(ftruncate(fd, (off_t)output->size) < 0)
+	{
+		perror(name);
+		close(fd);
+		shm_unlink(name);
+		return CGE_ERR;
+	}
+	map = mmap(NULL, output->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+	{
+		perror(name);
+		shm_unlink(name);
+		return CGE_ERR;
+	}
+
+	header = (CGE_SharedFrameHeader *)map;
+	memcpy(header->magic, "CGEF", 4);
+	header->version = CGE_SHAREDFRAME_VERSION;
+	header->width = CGE_SCREEN_WIDTH;
+	header->height = CGE_SCREEN_HEIGHT;
+	header->pitch = CGE_SCREEN_WIDTH * format->BytesPerPixel;
+	header->bitsPerPixel = format->BitsPerPixel;
+	header->rmask = format->Rmask;
+	header->gmask = format->Gmask;
+	header->bmask = format->Bmask;
+	header->slots = CGE_SHAREDFRAME_SLOTS;
+	header->sequence = 0;
+	header->latest = 0;
+
+	strcpy(output->name, name);
+	output->header = header;
+	output->window = engine->screen;
+	output->current = 0;
+	output->sequence = 0;
+	for(i = 0; i < CGE_SHAREDFRAME_SLOTS; i++)
+	{
+		header->slot[i].sequence = 0;
+		header->slot[i].offset = (Uint32)(CGE_SHAREDFRAME_ALIGN + i * frame);
+		output->slot[i] = SDL_CreateRGBSurfaceFrom((unsigned char *)map + header->slot[i].offset, CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT,
+			format->BitsPerPixel, header->pitch, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+		if(output->slot[i] == NULL)
+		{
+			CGE_OutputFree(engine);
+			return CGE_ERR;
+		}
+	}
+
+	return CGE_OK;
+}
+
+/* Points the screen at the next slot, or back at the one shown for a */
+/* partial redraw. Readers see the slot's sequence at 0 until it is presented */
+CGE_EXITCODE CGE_OutputBegin(CGE_Engine *engine, int advance)
+{
+	CGE_EngineOutput *output;
+
+	output = &engine->output;
+	if(output->header == NULL)
+	{
+		return CGE_OK;
+	}
+
+	if(advance == 1)
+	{
+		output->current = (output->current + 1) % CGE_SHAREDFRAME_SLOTS;
+	}
+	output->header->slot[output->current].sequence = 0;
+	CGE_AtomicFence();
+
+	if(engine->resolution.target == engine->screen)
+	{
+		engine->resolution.target = output->slot[output->current];
+	}
+	engine->screen = output->slot[output->current];
+
+	return CGE_OK;
+}
+
+/* Shows the rectangle in the window, or publishes the slot and wakes the */
+/* readers waiting on the sequence */
+CGE_EXITCODE CGE_Present(CGE_Engine *engine, int x, int y, int w, int h)
+{
+	CGE_EngineOutput *output;
+	CGE_SharedFrameSlot *slot;
+
+	output = &engine->output;
+	if(engine->offscreen == 1)
+	{
+		return CGE_OK;
+	}
+	if(output->header == NULL)
+	{
+		SDL_UpdateRect(engine->screen, x, y, w, h);
+		return CGE_OK;
+	}
+
+	output->sequence++;
+	slot = &output->header->slot[output->current];
+	slot->x = x;
+	slot->y = y;
+	slot->w = w;
+	slot->h = h;
+	CGE_AtomicFence();
+	slot->sequence = output->sequence;
+	output->header->latest = output->current;
+	CGE_AtomicFence();
+	output->header->sequence = output->sequence;
+	CGE_AtomicFence();
+#ifdef __linux__
+	syscall(SYS_futex, &output->header->sequence, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_OutputFree(CGE_Engine *engine)
+{
+	CGE_EngineOutput *output;
+	int i;
+
+	output = &engine->output;
+	if(output->header == NULL)
+	{
+		return CGE_OK;
+	}
+
+	if(engine->resolution.target == engine->screen)
+	{
+		engine->resolution.target = output->window;
+	}
+	engine->screen = output->window;
+	for(i = 0; i < CGE_SHAREDFRAME_SLOTS; i++)
+	{
+		SDL_FreeSurface(output->slot[i]);
+		output->slot[i] = NULL;
+	}
+	munmap(output->header, output->size);
+	shm_unlink(output->name);
+	output->header = NULL;
+
+	return CGE_OK;
+}
+
+/* Turns the camera once around over the frames, timing each and counting */
+/* the allocations made after the warm up frames, which should be none */
+CGE_EXITCODE CGE_Benchmark(CGE_Engine *engine, Uint32 frames)
+{
+	Uint32 start;
+	Uint32 elapsed;
+	Uint32 worst;
+	Uint32 measured;
+	Uint32 total;
+	Uint32 i;
+#ifdef CGE_ALLOCS
+	Uint32 allocations;
+
+	allocations = 0;
+#endif
+
+	engine->idle.enabled = 0;
+	worst = 0;
+	measured = 0;
+	total = 0;
+	for(i = 0; i < frames + CGE_BENCHMARK_WARMUP && engine->states.status == CGE_ENGINESTATESSTATUS_STARTED; i++)
+	{
+#ifdef CGE_ALLOCS
+		if(i == CGE_BENCHMARK_WARMUP)
+		{
+			allocations = CGE_AllocTracker.total;
+		}
+#endif
+		start = CGE_JobsClock();
+		CGE_GetInputs(engine);
+		CGE_GetTimers(engine);
+		engine->camera.axis.y = -180.0f + 360.0f * (float)i / (float)(frames + CGE_BENCHMARK_WARMUP);
+		CGE_Move(engine);
+		CGE_Render(engine);
+		elapsed = CGE_JobsClock() - start;
+
+		if(i >= CGE_BENCHMARK_WARMUP)
+		{
+			total += elapsed;
+			worst = elapsed > worst ? elapsed : worst;
+			measured++;
+		}
+	}
+
+	printf("\nbenchmark : %u frames\taverage : %.2f ms\tworst : %.2f ms\n", measured,
+		measured > 0 ? (double)total / measured / 1000.0 : 0.0, (double)worst / 1000.0);
+#ifdef CGE_ALLOCS
+	allocations = CGE_AllocTracker.total - allocations;
+	printf("steady state allocations : %u\n", allocations);
+
+	return allocations == 0 ? CGE_OK : CGE_ERR;
+#else
+	printf("steady state allocations : not tracked, build with DEFINES=-DCGE_ALLOCS\n");
+
+	return CGE_OK;
+#endif
+}
+
+/* Renders the scene in count offscreen engines at once, one thread and one */
+/* worker each, every engine turning the camera from its own angle */
+CGE_EXITCODE CGE_Batch(char *scene, int count, Uint32 frames, int verify, int stereo)
+{
+	CGE_BatchRender *batch;
+	SDL_Thread **thread;
+	CGE_EXITCODE code;
+	Uint32 start;
+	Uint32 elapsed;
+	int created;
+	int i;
+
+	if(count <= 0 || SDL_Init(SDL_INIT_TIMER) < 0)
+	{
+		return CGE_ERR;
+	}
+
+	batch = (CGE_BatchRender *)calloc(count, sizeof(CGE_BatchRender));
+	thread = (SDL_Thread **)calloc(count, sizeof(SDL_Thread *));
+	code = batch != NULL && thread != NULL ? CGE_OK : CGE_ERR;
+	for(created = 0; code == CGE_OK && created < count; created++)
+	{
+		if(CGE_InitOffscreen(&batch[created].engine, 1) == CGE_ERR)
+		{
+			code = CGE_ERR;
+			break;
+		}
+		batch[created].engine->resolution.budget = 0.0f;
+		if(stereo == 1)
+		{
+			CGE_ViewsStereo(batch[created].engine, CGE_STEREO_EYE);
+		}
+		batch[created].frames = frames;
+		batch[created].start = -180.0f + 360.0f * (float)created / (float)count;
+		if(scene != NULL && CGE_MeshFileOpen(&batch[created].engine->scene, scene, verify) == CGE_ERR)
+		{
+			created++;
+			code = CGE_ERR;
+			break;
+		}
+	}
+
+	if(code == CGE_OK)
+	{
+		start = CGE_JobsClock();
+		for(i = 0; i < count; i++)
+		{
+			thread[i] = SDL_CreateThread(CGE_BatchThread, &batch[i]);
+		}
+		for(i = 0; i < count; i++)
+		{
+			if(thread[i] == NULL)
+			{
+				code = CGE_ERR;
+				continue;
+			}
+			SDL_WaitThread(thread[i], NULL);
+		}
+		elapsed = CGE_JobsClock() - start;
+
+		printf("\nbatch : %d engines\t%u frames\t%.2f s\t%.1f frames/s\n", count, frames * count, (double)elapsed / 1000000.0,
+			elapsed > 0 ? (double)frames * count * 1000000.0 / elapsed : 0.0);
+	}
+
+	for(i = 0; i < created; i++)
+	{
+		CGE_DeInit(batch[i].engine);
+	}
+	free(thread);
+	free(batch);
+	SDL_Quit();
+
+	return code;
+}
+
+int CGE_BatchThread(void *data)
+{
+	CGE_BatchRender *batch;
+	CGE_Engine *engine;
+	Uint32 i;
+
+	batch = (CGE_BatchRender *)data;
+	engine = batch->engine;
+	CGE_JobsAttach(&engine->jobs);
+
+	for(i = 0; i < batch->frames; i++)
+	{
+		CGE_GetTimers(engine);
+		engine->camera.axis.y = batch->start + 360.0f * (float)i / (float)batch->frames;
+		CGE_Move(engine);
+		CGE_Render(engine);
+	}
+
+	return 0;
+}
+
+/* One keyframe per line: time x y z pitch yaw roll, # starting a comment */
+CGE_EXITCODE CGE_CameraPathLoad(CGE_CameraPath *path, const char *filename)
+{
+	FILE *file;
+	char line[256];
+	float time;
+	CGE_V3 position;
+	CGE_V3 axis;
+	Uint32 capacity;
+	void *grown[3];
+
+	path->count = 0;
+	path->time = NULL;
+	path->position = NULL;
+	path->axis = NULL;
+
+	file = fopen(filename, "r");
+	if(file == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	capacity = 0;
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		if(line[0] == '#' || sscanf(line, "%f %f %f %f %f %f %f", &time, &position.x, &position.y, &position.z, &axis.x, &axis.y, &axis.z) != 7)
+		{
+			continue;
+		}
+		if(path->count > 0 && time <= path->time[path->count - 1])
+		{
+			fclose(file);
+			CGE_CameraPathFree(path);
+			return CGE_ERR;
+		}
+
+		if(path->count == capacity)
+		{
+			capacity = capacity == 0 ? 64 : capacity * 2;
+			grown[0] = realloc(path->time, capacity * sizeof(float));
+			path->time = grown[0] != NULL ? (float *)grown[0] : path->time;
+			grown[1] = realloc(path->position, capacity * sizeof(CGE_V3));
+			path->position = grown[1] != NULL ? (CGE_V3 *)grown[1] : path->position;
+			grown[2] = realloc(path->axis, capacity * sizeof(CGE_V3));
+			path->axis = grown[2] != NULL ? (CGE_V3 *)grown[2] : path->axis;
+			if(grown[0] == NULL || grown[1] == NULL || grown[2] == NULL)
+			{
+				fclose(file);
+				CGE_CameraPathFree(path);
+				return CGE_ERR;
+			}
+		}
+
+		path->time[path->count] = time;
+		path->position[path->count] = position;
+		path->axis[path->count] = axis;
+		path->count++;
+	}
+	fclose(file);
+
+	if(path->count == 0)
+	{
+		CGE_CameraPathFree(path);
+		return CGE_ERR;
+	}
+
+	return CGE_OK;
+}
+
+/* Catmull-Rom through the positions, the angles turning the short way */
+CGE_EXITCODE CGE_CameraPathSample(const CGE_CameraPath *path, float time, CGE_V3 *position, CGE_V3 *axis)
+{
+	CGE_V3 p0;
+	CGE_V3 p1;
+	CGE_V3 p2;
+	CGE_V3 p3;
+	CGE_V3 a0;
+	CGE_V3 a1;
+	float u;
+	float u2;
+	float u3;
+	Uint32 low;
+	Uint32 high;
+	Uint32 k;
+
+	if(time <= path->time[0] || path->count == 1)
+	{
+		*position = path->position[0];
+		*axis = path->axis[0];
+		return CGE_OK;
+	}
+	if(time >= path->time[path->count - 1])
+	{
+		*position = path->position[path->count - 1];
+		*axis = path->axis[path->count - 1];
+		return CGE_OK;
+	}
+
+	low = 0;
+	high = path->count - 1;
+	while(high - low > 1)
+	{
+		k = (low + high) / 2;
+		if(path->time[k] <= time)
+		{
+			low = k;
+		}
+		else
+		{
+			high = k;
+		}
+	}
+
+	p0 = path->position[low > 0 ? low - 1 : low];
+	p1 = path->position[low];
+	p2 = path->position[high];
+	p3 = path->position[high + 1 < path->count ? high + 1 : high];
+	u = (time - path->time[low]) / (path->time[high] - path->time[low]);
+	u2 = u * u;
+	u3 = u2 * u;
+
+	position->x = 0.5f * (2.0f * p1.x + (p2.x - p0.x) * u + (2.0f * p0.x - 5.0f * p1.x + 4.0f * p2.x - p3.x) * u2 + (3.0f * p1.x - p0.x - 3.0f * p2.x + p3.x) * u3);
+	position->y = 0.5f * (2.0f * p1.y + (p2.y - p0.y) * u + (2.0f * p0.y - 5.0f * p1.y + 4.0f * p2.y - p3.y) * u2 + (3.0f * p1.y - p0.y - 3.0f * p2.y + p3.y) * u3);
+	position->z = 0.5f * (2.0f * p1.z + (p2.z - p0.z) * u + (2.0f * p0.z - 5.0f * p1.z + 4.0f * p2.z - p3.z) * u2 + (3.0f * p1.z - p0.z - 3.0f * p2.z + p3.z) * u3);
+
+	a0 = path->axis[low];
+	a1 = path->axis[high];
+	a1.x -= 360.0f * floor((a1.x - a0.x + 180.0f) / 360.0f);
+	a1.y -= 360.0f * floor((a1.y - a0.y + 180.0f) / 360.0f);
+	a1.z -= 360.0f * floor((a1.z - a0.z + 180.0f) / 360.0f);
+	axis->x = a0.x + (a1.x - a0.x) * u;
+	axis->y = a0.y + (a1.y - a0.y) * u;
+	axis->z = a0.z + (a1.z - a0.z) * u;
+	axis->y -= 360.0f * floor((axis->y + 180.0f) / 360.0f);
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_CameraPathFree(CGE_CameraPath *path)
+{
+	free(path->time);
+	free(path->position);
+	free(path->axis);
+	path->time = NULL;
+	path->position = NULL;
+	path->axis = NULL;
+	path->count = 0;
+
+	return CGE_OK;
+}
+
+/* Renders the camera path at fps frames per second as numbered PPM files */
+/* named after pattern, or as one PPM stream on the standard output when */
+/* pattern is -. Each thread has its own engine and takes every threads-th */
+/* frame, frames depend only on their time so the output is the same for */
+/* any number of threads */
+CGE_EXITCODE CGE_Export(char *scene, const char *keys, const char *pattern, int threads, float fps, int verify)
+{
+	CGE_ExportFrames export;
+	CGE_ExportRender *render;
+	SDL_Thread **thread;
+	Uint32 start;
+	Uint32 elapsed;
+	int created;
+	int started;
+	int i;
+
+	if(CGE_ExportPattern(&export, pattern) == CGE_ERR)
+	{
+		fprintf(stderr, "%s : the output takes one %%u or %%d, with a width of up to 2 digits\n", pattern);
+		return CGE_ERR;
+	}
+	if(fps <= 0.0f || CGE_CameraPathLoad(&export.path, keys) == CGE_ERR)
+	{
+		return CGE_ERR;
+	}
+	if(threads <= 0)
+	{
+#ifdef _SC_NPROCESSORS_ONLN
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		threads = threads <= 0 ? 1 : threads;
+	}
+
+	export.stream = strcmp(pattern, "-") == 0 ? stdout : NULL;
+	export.fps = fps;
+	export.frames = (Uint32)((export.path.time[export.path.count - 1] - export.path.time[0]) * fps) + 1;
+	export.next = 0;
+	export.code = CGE_OK;
+	threads = (Uint32)threads > export.frames ? (int)export.frames : threads;
+
+	if(SDL_Init(SDL_INIT_TIMER) < 0)
+	{
+		CGE_CameraPathFree(&export.path);
+		return CGE_ERR;
+	}
+	export.lock = SDL_CreateMutex();
+	export.written = SDL_CreateCond();
+	render = (CGE_ExportRender *)calloc(threads, sizeof(CGE_ExportRender));
+	thread = (SDL_Thread **)calloc(threads, sizeof(SDL_Thread *));
+	if(export.lock == NULL || export.written == NULL || render == NULL || thread == NULL)
+	{
+		export.code = CGE_ERR;
+	}
+
+	for(created = 0; export.code == CGE_OK && created < threads; created++)
+	{
+		render[created].rgb = (Uint8 *)malloc(CGE_SCREEN_WIDTH * CGE_SCREEN_HEIGHT * 3);
+		if(render[created].rgb == NULL || CGE_InitOffscreen(&render[created].engine, 1) == CGE_ERR)
+		{
+			free(render[created].rgb);
+			export.code = CGE_ERR;
+			break;
+		}
+		render[created].engine->resolution.budget = 0.0f;
+		render[created].engine->hud = 0;
+		render[created].export = &export;
+		render[created].first = created;
+		render[created].stride = threads;
+		if(scene != NULL && CGE_MeshFileOpen(&render[created].engine->scene, scene, verify) == CGE_ERR)
+		{
+			created++;
+			export.code = CGE_ERR;
+			break;
+		}
+	}
+
+	/* The threads started wait on frames a missing one would write, they */
+	/* are woken on the error to stop */
+	start = CGE_JobsClock();
+	started = export.code == CGE_OK ? threads : 0;
+	for(i = 0; i < started; i++)
+	{
+		thread[i] = SDL_CreateThread(CGE_ExportThread, &render[i]);
+		if(thread[i] == NULL)
+		{
+			SDL_mutexP(export.lock);
+			export.code = CGE_ERR;
+			SDL_CondBroadcast(export.written);
+			SDL_mutexV(export.lock);
+			break;
+		}
+	}
+	for(i = 0; thread != NULL && i < threads; i++)
+	{
+		if(thread[i] != NULL)
+		{
+			SDL_WaitThread(thread[i], NULL);
+		}
+	}
+	elapsed = CGE_JobsClock() - start;
+
+	if(export.code == CGE_OK)
+	{
+		fprintf(stderr, "\nexport : %u frames\t%d threads\t%.2f s\t%.1f frames/s\n", export.frames, threads,
+			(double)elapsed / 1000000.0, elapsed > 0 ? (double)export.frames * 1000000.0 / elapsed : 0.0);
+	}
+
+	for(i = 0; i < created; i++)
+	{
+		CGE_DeInit(render[i].engine);
+		free(render[i].rgb);
+	}
+	free(thread);
+	free(render);
+	if(export.written != NULL)
+	{
+		SDL_DestroyCond(export.written);
+	}
+	if(export.lock != NULL)
+	{
+		SDL_DestroyMutex(export.lock);
+	}
+	CGE_CameraPathFree(&export.path);
+	SDL_Quit();
+
+	return export.code;
+}
+
+int CGE_ExportThread(void *data)
+{
+	CGE_ExportRender *render;
+	CGE_ExportFrames *export;
+	CGE_Engine *engine;
+	SDL_Surface *screen;
+	Uint16 *row;
+	Uint8 *rgb;
+	Uint32 frame;
+	int tries;
+	int x;
+	int y;
+
+	render = (CGE_ExportRender *)data;
+	export = render->export;
+	engine = render->engine;
+	screen = engine->screen;
+	CGE_JobsAttach(&engine->jobs);
+
+	for(frame = render->first; frame < export->frames; frame += render->stride)
+	{
+		CGE_CameraPathSample(&export->path, export->path.time[0] + (float)frame / export->fps, &engine->camera.position, &engine->camera.axis);
+		engine->states.timers.elapsed = 0;
+		CGE_Move(engine);
+
+		/* A frame sized after a smaller one is drawn again in full, one */
+		/* the frame memory still cannot hold fails the export */
+		for(tries = 0; tries < CGE_EXPORT_RETRIES; tries++)
+		{
+			CGE_Render(engine);
+			if(engine->commands.commandsNeeded <= engine->commands.capacity && engine->commands.verticesNeeded <= engine->commands.verticesCapacity
+			&& engine->frames.arena[engine->frames.current].overflow == 0)
+			{
+				break;
+			}
+		}
+		if(tries == CGE_EXPORT_RETRIES)
+		{
+			fprintf(stderr, "export : frame %u does not fit in memory\n", frame);
+			SDL_mutexP(export->lock);
+			export->code = CGE_ERR;
+			SDL_CondBroadcast(export->written);
+			SDL_mutexV(export->lock);
+			break;
+		}
+
+		rgb = render->rgb;
+		for(y = 0; y < CGE_SCREEN_HEIGHT; y++)
+		{
+			row = (Uint16 *)screen->pixels + y * (screen->pitch / 2);
+			for(x = 0; x < CGE_SCREEN_WIDTH; x++, rgb += 3)
+			{
+				SDL_GetRGB(row[x], screen->format, &rgb[0], &rgb[1], &rgb[2]);
+			}
+		}
+
+		SDL_mutexP(export->lock);
+		while(export->next != frame && export->code == CGE_OK)
+		{
+			SDL_CondWait(export->written, export->lock);
+		}
+		if(export->code == CGE_ERR)
+		{
+			SDL_mutexV(export->lock);
+			break;
+		}
+		if(CGE_ExportWrite(export, frame, render->rgb) == CGE_ERR)
+		{
+			export->code = CGE_ERR;
+		}
+		export->next++;
+		SDL_CondBroadcast(export->written);
+		SDL_mutexV(export->lock);
+	}
+
+	return 0;
+}
+
+/* A file pattern takes the frame number once, as %u or %d with at most */
+/* a 2 digit width, so its text is bounded. - is the standard output */
+CGE_EXITCODE CGE_ExportPattern(CGE_ExportFrames *export, const char *pattern)
+{
+	const char *c;
+	size_t digits;
+
+	export->pattern = pattern;
+	export->conversion = 0;
+	export->length = 0;
+	if(strcmp(pattern, "-") == 0)
+	{
+		return CGE_OK;
+	}
+	if(strlen(pattern) > CGE_EXPORT_NAME - 128)
+	{
+		return CGE_ERR;
+	}
+
+	c = strchr(pattern, '%');
+	if(c == NULL || strchr(c + 1, '%') != NULL)
+	{
+		return CGE_ERR;
+	}
+	for(digits = 0; c[1 + digits] >= '0' && c[1 + digits] <= '9'; digits++);
+	if(digits > 2 || (c[1 + digits] != 'u' && c[1 + digits] != 'd'))
+	{
+		return CGE_ERR;
+	}
+
+	export->conversion = (size_t)(c - pattern);
+	export->length = digits + 2;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ExportWrite(CGE_ExportFrames *export, Uint32 frame, const Uint8 *rgb)
+{
+	FILE *file;
+	char name[CGE_EXPORT_NAME];
+	char conversion[8];
+	char number[128];
+	size_t size;
+	int error;
+
+	file = export->stream;
+	if(file == NULL)
+	{
+		/* The number is formatted on its own, at most 99 characters */
+		memcpy(conversion, export->pattern + export->conversion, export->length);
+		conversion[export->length] = '\0';
+		sprintf(number, conversion, frame);
+		if(export->conversion + strlen(number) + strlen(export->pattern + export->conversion + export->length) >= sizeof(name))
+		{
+			return CGE_ERR;
+		}
+		memcpy(name, export->pattern, export->conversion);
+		strcpy(name + export->conversion, number);
+		strcat(name, export->pattern + export->conversion + export->length);
+		file = fopen(name, "wb");
+		if(file == NULL)
+		{
+			return CGE_ERR;
+		}
+	}
+
+	size = (size_t)CGE_SCREEN_WIDTH * CGE_SCREEN_HEIGHT * 3;
+	fprintf(file, "P6\n%d %d\n255\n", CGE_SCREEN_WIDTH, CGE_SCREEN_HEIGHT);
+	error = fwrite(rgb, 1, size, file) != size;
+	if(file != export->stream)
+	{
+		error |= fclose(file) != 0;
+	}
+	else
+	{
+		error |= fflush(file) != 0;
+	}
+
+	return error == 0 ? CGE_OK : CGE_ERR;
+}
+
+CGE_EXITCODE CGE_SetStatsMode(CGE_Engine *engine, CGE_StatsMode mode)
+{
+	static const Uint8 ramp[5][3] = {{0, 0, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}, {255, 255, 255}};
+	float t;
+	int i;
+	int k;
+
+	engine->heat.mode = mode;
+	if(mode == CGE_STATSMODE_OFF)
+	{
+		free(engine->heat.buffer);
+		engine->heat.buffer = NULL;
+		engine->heat.width = 0;
+		engine->heat.height = 0;
+		return CGE_OK;
+	}
+
+	/* Unwritten pixels stay black, then blue for one write up to white */
+	engine->heat.palette[0] = (Uint16)SDL_MapRGB(engine->screen->format, 0, 0, 0);
+	for(i = 1; i < CGE_HEAT_COLORS; i++)
+	{
+		t = (float)(i - 1) * 4.0f / (CGE_HEAT_COLORS - 2);
+		k = (int)t < 3 ? (int)t : 3;
+		t -= k;
+		engine->heat.palette[i] = (Uint16)SDL_MapRGB(engine->screen->format,
+			(Uint8)(ramp[k][0] + (ramp[k + 1][0] - ramp[k][0]) * t),
+			(Uint8)(ramp[k][1] + (ramp[k + 1][1] - ramp[k][1]) * t),
+			(Uint8)(ramp[k][2] + (ramp[k + 1][2] - ramp[k][2]) * t));
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_StatsBegin(CGE_Engine *engine)
+{
+	CGE_EngineHeat *heat;
+
+	memset(&engine->states.counters, 0, sizeof(CGE_EngineStatesStats));
+
+	heat = &engine->heat;
+	if(heat->mode == CGE_STATSMODE_OFF)
+	{
+		return CGE_OK;
+	}
+
+	/* Sized for the full screen once, the governed resolution only */
+	/* changes the stride */
+	if(heat->buffer == NULL)
+	{
+		heat->buffer = (Uint32 *)malloc((size_t)CGE_SCREEN_WIDTH * CGE_SCREEN_HEIGHT * sizeof(Uint32));
+		if(heat->buffer == NULL)
+		{
+			return CGE_ERR;
+		}
+	}
+	heat->width = engine->resolution.width;
+	heat->height = engine->resolution.height;
+	memset(heat->buffer, 0, (size_t)heat->width * heat->height * sizeof(Uint32));
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_StatsEnd(CGE_Engine *engine)
+{
+	CGE_EngineHeat *heat;
+	CGE_EngineStatesStats *counters;
+	Uint16 *tiles;
+	Uint32 count;
+	int x;
+	int y;
+
+	heat = &engine->heat;
+	counters = &engine->states.counters;
+	tiles = engine->resolution.tiles;
+
+	if(heat->buffer != NULL)
+	{
+		for(y = 0; y < heat->height; y++)
+		{
+			for(x = 0; x < heat->width; x++)
+			{
+				count = heat->buffer[y * heat->width + x];
+				counters->covered += count > 0;
+				if(heat->mode == CGE_STATSMODE_HEATMAP)
+				{
+					*CGE_TILE(tiles, x, y) = heat->palette[count < CGE_HEAT_COLORS ? count : CGE_HEAT_COLORS - 1];
+				}
+			}
+		}
+		counters->overdraw = counters->pixels - counters->covered;
+	}
+
+	engine->states.stats = *counters;
+
+	return CGE_OK;
+}
+
+/* Counters of the last frame rendered */
+CGE_EXITCODE CGE_GetStats(CGE_Engine *engine, CGE_EngineStatesStats *stats)
+{
+	*stats = engine->states.stats;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_DrawStats(CGE_Engine *engine)
+{
+	CGE_EngineStatesStats *stats;
+	SDL_Color white;
+	char text[255];
+
+	if(engine->heat.mode == CGE_STATSMODE_OFF)
+	{
+		return CGE_OK;
+	}
+
+	stats = &engine->states.stats;
+	white = CGE_ColorNew(255, 255, 255);
+
+	sprintf(text, "lines : %lu submitted  %lu culled  %lu rejected  %lu clipped  %lu drawn",
+		(unsigned long)stats->linesSubmitted, (unsigned long)stats->linesCulled, (unsigned long)stats->linesRejected,
+		(unsigned long)stats->linesClipped, (unsigned long)stats->linesRasterized);
+	CGE_DrawTextSolid(engine, text, CGE_V3New(0.0f, 532.0f, 0.0f), white);
+
+	sprintf(text, "points : %lu submitted  %lu culled  %lu rejected  %lu drawn",
+		(unsigned long)stats->pointsSubmitted, (unsigned long)stats->pointsCulled, (unsigned long)stats->pointsRejected,
+		(unsigned long)stats->pointsRasterized);
+	CGE_DrawTextSolid(engine, text, CGE_V3New(0.0f, 548.0f, 0.0f), white);
+
+	sprintf(text, "pixels : %lu written  %lu covered  %lu overdrawn  %.2f writes per pixel",
+		(unsigned long)stats->pixels, (unsigned long)stats->covered, (unsigned long)stats->overdraw,
+		stats->covered > 0 ? (double)stats->pixels / stats->covered : 0.0);
+	CGE_DrawTextSolid(engine, text, CGE_V3New(0.0f, 564.0f, 0.0f), white);
+
+	return CGE_OK;
+}
+
+
+/* Mesh functions implementations */
+
+CGE_EXITCODE CGE_MeshFileOpen(CGE_MeshFile *file, const char *path, int verify)
+{
+	struct stat status;
+	const CGE_MeshFileHeader *header;
+	const CGE_MeshFileMesh *table;
+	CGE_Mesh *mesh;
+	Uint32 checksum;
+	Uint32 flags;
+	Uint32 i;
+	size_t position;
+	size_t index;
+	int fd;
+
+	file->map = NULL;
+	file->size = 0;
+	file->meshes = 0;
+	file->mesh = NULL;
+
+	if(SDL_BYTEORDER != SDL_LIL_ENDIAN)
+	{
+		fprintf(stderr, "%s: mesh files are little endian only\n", path);
+		return CGE_ERR;
+	}
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0)
+	{
+		perror(path);
+		return CGE_ERR;
+	}
+	if(fstat(fd, &status) < 0 || (size_t)status.st_size < sizeof(CGE_MeshFileHeader))
+	{
+		fprintf(stderr, "%s: not a mesh file\n", path);
+		close(fd);
+		return CGE_ERR;
+	}
+
+	/* Read only shared pages: nothing is parsed or copied, and every */
+	/* process viewing the same file shares the page cache */
+	file->size = (size_t)status.st_size;
+	file->map = (unsigned char *)mmap(NULL, file->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(file->map == (unsigned char *)MAP_FAILED)
+	{
+		perror(path);
+		file->map = NULL;
+		return CGE_ERR;
+	}
+
+	header = (const CGE_MeshFileHeader *)file->map;
+	table = (const CGE_MeshFileMesh *)(file->map + sizeof(CGE_MeshFileHeader));
+
+	if(memcmp(header->magic, "CGEM", 4) != 0 || header->version < 1 || header->version > CGE_MESHFILE_VERSION
+	|| header->size != file->size
+	|| header->meshes > (file->size - sizeof(CGE_MeshFileHeader)) / sizeof(CGE_MeshFileMesh))
+	{
+		fprintf(stderr, "%s: bad mesh file header\n", path);
+		CGE_MeshFileClose(file);
+		return CGE_ERR;
+	}
+
+	/* The header and the mesh table are always checked, the data only on demand */
+	checksum = CGE_Adler32(1, file->map, 20);
+	checksum = CGE_Adler32(checksum, (const unsigned char *)table, header->meshes * sizeof(CGE_MeshFileMesh));
+	if(checksum != header->checksum)
+	{
+		fprintf(stderr, "%s: bad mesh table checksum\n", path);
+		CGE_MeshFileClose(file);
+		return CGE_ERR;
+	}
+
+	flags = header->version == 1 ? 0 : header->flags;
+	if((flags & ~(CGE_MESHFILE_QUANTIZED | CGE_MESHFILE_INDEX16)) != 0)
+	{
+		fprintf(stderr, "%s: unknown mesh file flags\n", path);
+		CGE_MeshFileClose(file);
+		return CGE_ERR;
+	}
+
+	file->mesh = (CGE_Mesh *)malloc(header->meshes * sizeof(CGE_Mesh) + 1);
+	if(file->mesh == NULL)
+	{
+		CGE_MeshFileClose(file);
+		return CGE_ERR;
+	}
+
+	for(i = 0; i < header->meshes; i++)
+	{
+		position = (flags & CGE_MESHFILE_QUANTIZED) != 0 ? sizeof(Uint16) : sizeof(float);
+		index = (flags & CGE_MESHFILE_INDEX16) != 0 && table[i].vertices <= 65536 ? sizeof(Uint16) : sizeof(Uint32);
+		if(table[i].x % CGE_MESHFILE_ALIGN != 0 || table[i].y % CGE_MESHFILE_ALIGN != 0
+		|| table[i].z % CGE_MESHFILE_ALIGN != 0 || table[i].index % index != 0 || table[i].lod % 4 != 0
+		|| table[i].vertices > file->size / position || table[i].indices > file->size / index
+		|| table[i].lods > file->size / sizeof(CGE_MeshFileLod)
+		|| table[i].x > file->size - table[i].vertices * position
+		|| table[i].y > file->size - table[i].vertices * position
+		|| table[i].z > file->size - table[i].vertices * position
+		|| table[i].index > file->size - table[i].indices * index
+		|| table[i].lod > file->size - table[i].lods * sizeof(CGE_MeshFileLod))
+		{
+			fprintf(stderr, "%s: mesh %lu out of the file\n", path, (unsigned long)i);
+			CGE_MeshFileClose(file);
+			return CGE_ERR;
+		}
+
+		mesh = &file->mesh[i];
+		mesh->vertices = table[i].vertices;
+		mesh->indices = table[i].indices;
+		mesh->x = NULL;
+		mesh->y = NULL;
+		mesh->z = NULL;
+		mesh->qx = NULL;
+		mesh->qy = NULL;
+		mesh->qz = NULL;
+		mesh->index = NULL;
+		mesh->index16 = NULL;
+		if(position == sizeof(Uint16))
+		{
+			mesh->qx = (const Uint16 *)(file->map + table[i].x);
+			mesh->qy = (const Uint16 *)(file->map + table[i].y);
+			mesh->qz = (const Uint16 *)(file->map + table[i].z);
+		}
+		else
+		{
+			mesh->x = (const float *)(file->map + table[i].x);
+			mesh->y = (const float *)(file->map + table[i].y);
+			mesh->z = (const float *)(file->map + table[i].z);
+		}
+		if(index == sizeof(Uint16))
+		{
+			mesh->index16 = (const Uint16 *)(file->map + table[i].index);
+		}
+		else
+		{
+			mesh->index = (const Uint32 *)(file->map + table[i].index);
+		}
+		mesh->lods = table[i].lods;
+		mesh->lod = (const CGE_MeshFileLod *)(file->map + table[i].lod);
+		mesh->min = CGE_V3New(table[i].min[0], table[i].min[1], table[i].min[2]);
+		mesh->max = CGE_V3New(table[i].max[0], table[i].max[1], table[i].max[2]);
+		mesh->color = CGE_ColorNew(table[i].color[0], table[i].color[1], table[i].color[2]);
+		mesh->origin = mesh->min;
+		mesh->step = CGE_V3New((mesh->max.x - mesh->min.x) / 65535.0f, (mesh->max.y - mesh->min.y) / 65535.0f, (mesh->max.z - mesh->min.z) / 65535.0f);
+
+		if(verify == 1)
+		{
+			checksum = CGE_Adler32(1, file->map + table[i].x, mesh->vertices * position);
+			checksum = CGE_Adler32(checksum, file->map + table[i].y, mesh->vertices * position);
+			checksum = CGE_Adler32(checksum, file->map + table[i].z, mesh->vertices * position);
+			checksum = CGE_Adler32(checksum, file->map + table[i].index, mesh->indices * index);
+			checksum = CGE_Adler32(checksum, (const unsigned char *)mesh->lod, mesh->lods * sizeof(CGE_MeshFileLod));
+			if(checksum != table[i].checksum)
+			{
+				fprintf(stderr, "%s: bad checksum for mesh %lu\n", path, (unsigned long)i);
+				CGE_MeshFileClose(file);
+				return CGE_ERR;
+			}
+		}
+
+		file->meshes++;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_MeshFileClose(CGE_MeshFile *file)
+{
+	if(file->map != NULL)
+	{
+		munmap(file->map, file->size);
+	}
+	free(file->mesh);
+
+	file->map = NULL;
+	file->size = 0;
+	file->meshes = 0;
+	file->mesh = NULL;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_MeshLod(const CGE_Mesh *mesh, float distance, Uint32 *first, Uint32 *count)
+{
+	Uint32 i;
+
+	/* Levels are sorted by distance, the last one reached wins */
+	*first = 0;
+	*count = mesh->indices;
+	for(i = 0; i < mesh->lods; i++)
+	{
+		if(distance < mesh->lod[i].distance)
+		{
+			break;
+		}
+		if(mesh->lod[i].first <= mesh->indices && mesh->lod[i].count <= mesh->indices - mesh->lod[i].first)
+		{
+			*first = mesh->lod[i].first;
+			*count = mesh->lod[i].count;
+		}
+	}
+
+	return CGE_OK;
+}
+
+/* Position i as stored, in steps of the box for a quantized mesh */
+CGE_V3 CGE_MeshStream(const CGE_Mesh *mesh, Uint32 i)
+{
+	if(mesh->qx != NULL)
+	{
+		return CGE_V3New((float)mesh->qx[i], (float)mesh->qy[i], (float)mesh->qz[i]);
+	}
+
+	return CGE_V3New(mesh->x[i], mesh->y[i], mesh->z[i]);
+}
+
+/* Position i in the mesh's own space */
+CGE_V3 CGE_MeshVertex(const CGE_Mesh *mesh, Uint32 i)
+{
+	if(mesh->qx != NULL)
+	{
+		return CGE_V3New(mesh->origin.x + mesh->step.x * mesh->qx[i], mesh->origin.y + mesh->step.y * mesh->qy[i], mesh->origin.z + mesh->step.z * mesh->qz[i]);
+	}
+
+	return CGE_V3New(mesh->x[i], mesh->y[i], mesh->z[i]);
+}
+
+/* Takes stored positions to the mesh's space, for the model matrix */
+CGE_M4 CGE_MeshDecode(const CGE_Mesh *mesh)
+{
+	if(mesh->qx == NULL)
+	{
+		return CGE_M4Identity();
+	}
+
+	return CGE_M4M4Mul(CGE_M4Translate(mesh->origin.x, mesh->origin.y, mesh->origin.z), CGE_M4Scale(mesh->step.x, mesh->step.y, mesh->step.z));
+}
+
+/* Copies of a mesh on a square grid beside it, each turned around y */
+CGE_EXITCODE CGE_InstancesGrid(CGE_Engine *engine, const CGE_Mesh *mesh, Uint32 count)
+{
+	CGE_Instance instance;
+	CGE_V3 size;
+	float spacing;
+	Uint32 side;
+	Uint32 i;
+
+	CGE_InstancesFree(engine);
+
+	engine->instances.model = (CGE_M4 *)malloc(count * sizeof(CGE_M4));
+	if(engine->instances.model == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	size = CGE_V3V3Sub(mesh->max, mesh->min);
+	spacing = size.x > size.z ? size.x : size.z;
+	spacing = spacing > 0.0f ? spacing * 1.5f : 1.0f;
+
+	/* Cell 0 is the mesh itself */
+	side = (Uint32)ceil(sqrt((double)count + 1.0));
+	for(i = 0; i < count; i++)
+	{
+		instance.position = CGE_V3New(((i + 1) % side) * spacing, 0.0f, -(float)((i + 1) / side) * spacing);
+		instance.rotation = CGE_QuatAxisAngle((float)((i * 37) % 360), 0.0f, 1.0f, 0.0f);
+		instance.scale = CGE_V3New(1.0f, 1.0f, 1.0f);
+		engine->instances.model[i] = CGE_M4Instance(instance);
+	}
+	engine->instances.count = count;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_InstancesFree(CGE_Engine *engine)
+{
+	free(engine->instances.model);
+	engine->instances.model = NULL;
+	engine->instances.count = 0;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_DrawMeshRange(CGE_Engine *engine, const CGE_Mesh *mesh, Uint32 first, Uint32 count, SDL_Color color)
+{
+	CGE_EngineVertices *vertices;
+	CGE_JobCounter counter;
+	CGE_MeshJob job;
+	size_t mark;
+	Uint32 i;
+	Uint32 a;
+	Uint32 b;
+	int views;
+	int v;
+
+	/* When there are more edge ends than vertices, transform every vertex */
+	/* once on the job workers and only draw serially. The clip space */
+	/* copy is scratch, given back to the frame arena after the draw */
+	vertices = &engine->vertices;
+	views = engine->device.views;
+	mark = CGE_FrameMark(engine);
+	vertices->clip = NULL;
+	vertices->outcode = NULL;
+	if(count >= mesh->vertices && mesh->vertices >= CGE_JOBS_GRAIN)
+	{
+		vertices->clip = (CGE_V4 *)CGE_FrameAlloc(engine, mesh->vertices * views * sizeof(CGE_V4));
+		vertices->outcode = (Uint8 *)CGE_FrameAlloc(engine, mesh->vertices * views);
+	}
+
+	if(vertices->clip != NULL && vertices->outcode != NULL)
+	{
+		job.engine = engine;
+		job.mesh = mesh;
+		job.visible = NULL;
+		counter.value = 0;
+		CGE_JobsFor(&engine->jobs, "transform", CGE_TransformJob, &job, mesh->vertices, CGE_JOBS_GRAIN, &counter);
+		CGE_JobsWait(&engine->jobs, &counter);
+
+		for(i = first; i + 1 < first + count; i += 2)
+		{
+			a = CGE_MESH_INDEX(mesh, i);
+			b = CGE_MESH_INDEX(mesh, i + 1);
+			if(a >= mesh->vertices || b >= mesh->vertices)
+			{
+				continue;
+			}
+
+			engine->states.counters.linesSubmitted++;
+			for(v = 0; v < views; v++)
+			{
+				if((vertices->outcode[a * views + v] & vertices->outcode[b * views + v]) != 0)
+				{
+					engine->states.counters.linesRejected++;
+					continue;
+				}
+				if((vertices->outcode[a * views + v] | vertices->outcode[b * views + v]) != 0)
+				{
+					engine->states.counters.linesClipped++;
+				}
+				CGE_LinePacketPush(engine, v, vertices->clip[a * views + v], vertices->clip[b * views + v], color);
+			}
+		}
+
+		/* Lines still in the packet hold copies, not pointers */
+		return CGE_FrameRelease(engine, mark);
+	}
+	CGE_FrameRelease(engine, mark);
+
+	for(i = first; i + 1 < first + count; i += 2)
+	{
+		a = CGE_MESH_INDEX(mesh, i);
+		b = CGE_MESH_INDEX(mesh, i + 1);
+
+		/* Indices are only checked on load when asked to, never trust them here */
+		if(a >= mesh->vertices || b >= mesh->vertices)
+		{
+			continue;
+		}
+
+		CGE_DrawSegment(engine, CGE_MeshStream(mesh, a), CGE_MeshStream(mesh, b), color);
+	}
+
+	return CGE_OK;
+}
+
+
+void CGE_TransformJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_MeshJob *job;
+	const CGE_Mesh *mesh;
+	CGE_EngineVertices *vertices;
+	CGE_V4Views clip;
+	CGE_V3 position;
+	int outcode[CGE_VIEWS_MAX];
+	int views;
+	Uint32 i;
+	int v;
+
+	job = (CGE_MeshJob *)data;
+	mesh = job->mesh;
+	vertices = &job->engine->vertices;
+	views = job->engine->device.views;
+
+	/* Quantized positions go in as they are, the model matrix decodes them */
+	for(i = first; i < first + count; i++)
+	{
+		if(mesh->qx != NULL)
+		{
+			position = CGE_V3New((float)mesh->qx[i], (float)mesh->qy[i], (float)mesh->qz[i]);
+		}
+		else
+		{
+			position = CGE_V3New(mesh->x[i], mesh->y[i], mesh->z[i]);
+		}
+		CGE_V4ViewsTransform(&job->engine->device, position, &clip);
+		CGE_V4ViewsOutcode(&clip, outcode);
+		for(v = 0; v < views; v++)
+		{
+			vertices->clip[i * views + v] = CGE_V4ViewsGet(&clip, v);
+			vertices->outcode[i * views + v] = (Uint8)outcode[v];
+		}
+	}
+}
+
+/* Point cloud functions implementations */
+
+CGE_EXITCODE CGE_PointCloudNew(CGE_PointCloud *cloud, Uint32 points, int quantized)
+{
+	cloud->points = 0;
+	cloud->x = NULL;
+	cloud->y = NULL;
+	cloud->z = NULL;
+	cloud->qx = NULL;
+	cloud->qy = NULL;
+	cloud->qz = NULL;
+	cloud->origin = CGE_V3New(0.0f, 0.0f, 0.0f);
+	cloud->step = CGE_V3New(1.0f, 1.0f, 1.0f);
+	cloud->pixel = NULL;
+	cloud->color = CGE_ColorNew(255, 255, 255);
+	cloud->min = CGE_V3New(0.0f, 0.0f, 0.0f);
+	cloud->max = CGE_V3New(0.0f, 0.0f, 0.0f);
+	cloud->size = 1;
+	cloud->depth = 1;
+
+	if(points == 0)
+	{
+		return CGE_OK;
+	}
+
+	if(quantized == 1)
+	{
+		cloud->qx = (Uint16 *)malloc(points * sizeof(Uint16));
+		cloud->qy = (Uint16 *)malloc(points * sizeof(Uint16));
+		cloud->qz = (Uint16 *)malloc(points * sizeof(Uint16));
+	}
+	else
+	{
+		cloud->x = (float *)malloc(points * sizeof(float));
+		cloud->y = (float *)malloc(points * sizeof(float));
+		cloud->z = (float *)malloc(points * sizeof(float));
+	}
+	cloud->pixel = (Uint16 *)malloc(points * sizeof(Uint16));
+
+	if(cloud->pixel == NULL || (quantized == 1 && (cloud->qx == NULL || cloud->qy == NULL || cloud->qz == NULL))
+	|| (quantized == 0 && (cloud->x == NULL || cloud->y == NULL || cloud->z == NULL)))
+	{
+		CGE_PointCloudFree(cloud);
+		return CGE_ERR;
+	}
+
+	cloud->points = points;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_PointCloudFree(CGE_PointCloud *cloud)
+{
+	free(cloud->x);
+	free(cloud->y);
+	free(cloud->z);
+	free(cloud->qx);
+	free(cloud->qy);
+	free(cloud->qz);
+	free(cloud->pixel);
+
+	cloud->x = NULL;
+	cloud->y = NULL;
+	cloud->z = NULL;
+	cloud->qx = NULL;
+	cloud->qy = NULL;
+	cloud->qz = NULL;
+	cloud->pixel = NULL;
+	cloud->points = 0;
+
+	return CGE_OK;
+}
+
+/* A quantized scan of rolling ground under the grid, colored by height */
+CGE_EXITCODE CGE_PointCloudTerrain(CGE_Engine *engine, CGE_PointCloud *cloud, Uint32 points)
+{
+	Uint32 seed;
+	Uint32 i;
+	float extent;
+	float x;
+	float y;
+	float z;
+	float h;
+
+	CGE_PointCloudFree(cloud);
+	if(CGE_PointCloudNew(cloud, points, 1) == CGE_ERR)
+	{
+		return CGE_ERR;
+	}
+
+	extent = 200.0f;
+	cloud->origin = CGE_V3New(-extent / 2.0f, -16.0f, -extent / 2.0f);
+	cloud->step = CGE_V3New(extent / 65535.0f, 12.0f / 65535.0f, extent / 65535.0f);
+	cloud->min = cloud->origin;
+	cloud->max = CGE_V3New(extent / 2.0f, -4.0f, extent / 2.0f);
+
+	seed = 1;
+	for(i = 0; i < points; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		x = (float)(seed >> 16) / 65535.0f * extent + cloud->origin.x;
+		seed = seed * 1664525 + 1013904223;
+		z = (float)(seed >> 16) / 65535.0f * extent + cloud->origin.z;
+		h = (sin(x / 7.0f) * cos(z / 9.0f) + 1.0f) / 2.0f;
+		y = -16.0f + h * 12.0f;
+
+		cloud->qx[i] = (Uint16)((x - cloud->origin.x) / cloud->step.x);
+		cloud->qy[i] = (Uint16)((y - cloud->origin.y) / cloud->step.y);
+		cloud->qz[i] = (Uint16)((z - cloud->origin.z) / cloud->step.z);
+		cloud->pixel[i] = (Uint16)SDL_MapRGB(engine->screen->format, (Uint8)(40 + h * 200), (Uint8)(120 + h * 100), (Uint8)(200 - h * 160));
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_CommandPointCloud(CGE_Engine *engine, CGE_CommandBuffer *buffer, const CGE_PointCloud *cloud, Uint8 state)
+{
+	CGE_DrawCommand *command;
+
+	if(CGE_BoundsVisible(engine, cloud->min, cloud->max) == 0)
+	{
+		buffer->pointsCulled += cloud->points;
+		return CGE_OK;
+	}
+
+	buffer->commandsNeeded += 1;
+	if(buffer->count >= buffer->capacity)
+	{
+		return CGE_ERR;
+	}
+
+	command = &buffer->commands[buffer->count++];
+	command->key = CGE_CommandKey(engine, CGE_V3ScalarMul(CGE_V3V3Add(cloud->min, cloud->max), 0.5f), cloud->color, state);
+	command->first = 0;
+	command->count = cloud->points;
+	command->vertices = NULL;
+	command->mesh = NULL;
+	command->model = NULL;
+	command->cloud = cloud;
+	command->billboard = NULL;
+	command->color = cloud->color;
+	command->primitive = CGE_PRIMITIVE_CLOUD;
+	command->state = state;
+
+	return CGE_OK;
+}
+
+/* Transform, cull and splat in one pass over the arrays on the job workers. */
+/* With the depth test the splats meet in the depth buffer and are resolved */
+/* to the screen afterwards. Without it the last point wins: the pass only */
+/* keeps each splat's rectangle and counts the bands of rows it covers, the */
+/* splats are binned by band in point order, then each band is written by */
+/* one worker from its own bin */
+CGE_EXITCODE CGE_DrawPointCloud(CGE_Engine *engine, const CGE_PointCloud *cloud)
+{
+	CGE_EngineDepth *depth;
+	CGE_JobCounter counter;
+	CGE_CloudJob job;
+	CGE_M4 decode;
+	Uint32 chunks;
+	Uint32 total;
+	Uint32 band;
+	Uint32 chunk;
+	Uint32 n;
+	size_t size;
+
+	depth = &engine->depth;
+	if(cloud->depth == 1)
+	{
+		depth->width = engine->resolution.width;
+		depth->height = engine->resolution.height;
+		depth->buffer = (Uint32 *)CGE_FrameAlloc(engine, (size_t)depth->width * depth->height * sizeof(Uint32));
+		if(depth->buffer == NULL)
+		{
+			return CGE_ERR;
+		}
+	}
+
+	/* Quantized positions are decoded by the transform itself */
+	job.engine = engine;
+	job.cloud = cloud;
+	job.device = engine->device;
+	job.pixel = (Uint16)SDL_MapRGB(engine->resolution.target->format, cloud->color.r, cloud->color.g, cloud->color.b);
+	job.splat = NULL;
+	job.counts = NULL;
+	job.bins = NULL;
+	job.bandFirst = NULL;
+	job.bands = (engine->resolution.height + CGE_SPLAT_BAND - 1) / CGE_SPLAT_BAND;
+	chunks = (cloud->points + CGE_SPLAT_GRAIN - 1) / CGE_SPLAT_GRAIN;
+	if(cloud->depth == 0)
+	{
+		job.splat = (CGE_Splat *)CGE_FrameAlloc(engine, (size_t)cloud->points * engine->device.views * sizeof(CGE_Splat));
+		job.counts = (Uint32 *)CGE_FrameAlloc(engine, (size_t)chunks * job.bands * sizeof(Uint32));
+		job.bandFirst = (Uint32 *)CGE_FrameAlloc(engine, (job.bands + 1) * sizeof(Uint32));
+		if(job.counts == NULL || job.bandFirst == NULL)
+		{
+			job.counts = NULL;
+		}
+		else
+		{
+			memset(job.counts, 0, (size_t)chunks * job.bands * sizeof(Uint32));
+		}
+	}
+	if(cloud->qx != NULL)
+	{
+		decode = CGE_M4M4Mul(CGE_M4Translate(cloud->origin.x, cloud->origin.y, cloud->origin.z), CGE_M4Scale(cloud->step.x, cloud->step.y, cloud->step.z));
+		CGE_DeviceModel(&job.device, CGE_M4M4Mul(engine->device.model, decode));
+	}
+
+	if(cloud->depth == 1)
+	{
+		size = (size_t)depth->width * depth->height * sizeof(Uint32);
+		memset(depth->buffer, 0xFF, size);
+	}
+
+	engine->states.counters.pointsSubmitted += cloud->points;
+
+	/* Without the rectangles the splats are written directly, on one thread */
+	if(cloud->depth == 0 && job.splat == NULL)
+	{
+		CGE_SplatJob(&job, 0, cloud->points);
+		return CGE_OK;
+	}
+
+	counter.value = 0;
+	CGE_JobsFor(&engine->jobs, "splat", CGE_SplatJob, &job, cloud->points, CGE_SPLAT_GRAIN, &counter);
+	CGE_JobsWait(&engine->jobs, &counter);
+
+	if(cloud->depth == 0)
+	{
+		/* Each chunk's counts become where it starts writing in each bin, */
+		/* bands one after the other and chunks in point order within one */
+		if(job.counts != NULL)
+		{
+			total = 0;
+			for(band = 0; band < job.bands; band++)
+			{
+				job.bandFirst[band] = total;
+				for(chunk = 0; chunk < chunks; chunk++)
+				{
+					n = job.counts[chunk * job.bands + band];
+					job.counts[chunk * job.bands + band] = total;
+					total += n;
+				}
+			}
+			job.bandFirst[job.bands] = total;
+
+			job.bins = (Uint32 *)CGE_FrameAlloc(engine, (size_t)total * sizeof(Uint32));
+			if(job.bins != NULL)
+			{
+				counter.value = 0;
+				CGE_JobsFor(&engine->jobs, "bin", CGE_BinJob, &job, cloud->points, CGE_SPLAT_GRAIN, &counter);
+				CGE_JobsWait(&engine->jobs, &counter);
+			}
+		}
+
+		counter.value = 0;
+		CGE_JobsFor(&engine->jobs, "bands", CGE_BandJob, &job, job.bands, 1, &counter);
+		CGE_JobsWait(&engine->jobs, &counter);
+	}
+	else
+	{
+		counter.value = 0;
+		CGE_JobsFor(&engine->jobs, "resolve", CGE_ResolveJob, &job, depth->height, 16, &counter);
+		CGE_JobsWait(&engine->jobs, &counter);
+	}
+
+	return CGE_OK;
+}
+
+void CGE_SplatJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_CloudJob *job;
+	const CGE_PointCloud *cloud;
+	CGE_EngineDevice *device;
+	CGE_Splat *splat;
+	Uint16 *tiles;
+	volatile Uint32 *cell;
+	Uint32 *heat;
+	Uint32 value;
+	Uint32 old;
+	Uint32 *counts;
+	Uint32 rejected;
+	Uint32 rasterized;
+	Uint32 pixels;
+	Uint32 i;
+	Uint32 band;
+	Uint16 pixel;
+	float px;
+	float py;
+	float pz;
+	float x;
+	float y;
+	float z;
+	float w;
+	int x0;
+	int x1;
+	int y0;
+	int y1;
+	int sx;
+	int sy;
+	int width;
+	int height;
+	int v;
+
+	job = (CGE_CloudJob *)data;
+	cloud = job->cloud;
+	device = &job->device;
+	tiles = job->engine->resolution.tiles;
+	width = job->engine->resolution.width;
+	height = job->engine->resolution.height;
+	pixel = job->pixel;
+	heat = job->engine->heat.buffer;
+	counts = job->counts != NULL ? &job->counts[first / CGE_SPLAT_GRAIN * job->bands] : NULL;
+	rejected = 0;
+	rasterized = 0;
+	pixels = 0;
+
+	for(i = first; i < first + count; i++)
+	{
+		if(cloud->qx != NULL)
+		{
+			px = (float)cloud->qx[i];
+			py = (float)cloud->qy[i];
+			pz = (float)cloud->qz[i];
+		}
+		else
+		{
+			px = cloud->x[i];
+			py = cloud->y[i];
+			pz = cloud->z[i];
+		}
+		if(cloud->pixel != NULL)
+		{
+			pixel = cloud->pixel[i];
+		}
+
+		for(v = 0; v < device->views; v++)
+		{
+			splat = job->splat != NULL ? &job->splat[i * device->views + v] : NULL;
+			if(splat != NULL)
+			{
+				splat->y0 = 0;
+				splat->y1 = 0;
+			}
+
+			w = (device->transform[12][v] * px) + (device->transform[13][v] * py) + (device->transform[14][v] * pz) + device->transform[15][v];
+			x = (device->transform[0][v] * px) + (device->transform[1][v] * py) + (device->transform[2][v] * pz) + device->transform[3][v];
+			y = (device->transform[4][v] * px) + (device->transform[5][v] * py) + (device->transform[6][v] * pz) + device->transform[7][v];
+			z = (device->transform[8][v] * px) + (device->transform[9][v] * py) + (device->transform[10][v] * pz) + device->transform[11][v];
+
+			/* Culled in clip space, only the kept points pay the divide */
+			if(x < -w || x > w || y < -w || y > w || z < -w || z > w)
+			{
+				rejected++;
+				continue;
+			}
+
+			w = 1.0f / w;
+			x0 = (int)(((x * w + 1.0f) * device->viewport[v].w / 2.0f) + device->viewport[v].x);
+			y0 = (int)(((-y * w + 1.0f) * device->viewport[v].h / 2.0f) + device->viewport[v].y);
+			x0 -= cloud->size / 3;
+			y0 -= cloud->size / 3;
+			x1 = x0 + cloud->size;
+			y1 = y0 + cloud->size;
+
+			/* Splats stay inside their viewport */
+			x0 = x0 < (int)device->viewport[v].x ? (int)device->viewport[v].x : x0;
+			y0 = y0 < (int)device->viewport[v].y ? (int)device->viewport[v].y : y0;
+			x1 = x1 > (int)(device->viewport[v].x + device->viewport[v].w) ? (int)(device->viewport[v].x + device->viewport[v].w) : x1;
+			y1 = y1 > (int)(device->viewport[v].y + device->viewport[v].h) ? (int)(device->viewport[v].y + device->viewport[v].h) : y1;
+			x1 = x1 > width ? width : x1;
+			y1 = y1 > height ? height : y1;
+
+			rasterized++;
+			if(x1 > x0 && y1 > y0)
+			{
+				pixels += (x1 - x0) * (y1 - y0);
+				if(heat != NULL)
+				{
+					for(sy = y0; sy < y1; sy++)
+					{
+						for(sx = x0; sx < x1; sx++)
+						{
+							CGE_AtomicAdd(&heat[sy * width + sx], 1);
+						}
+					}
+				}
+			}
+
+			if(splat != NULL)
+			{
+				splat->x0 = (Sint16)x0;
+				splat->y0 = (Sint16)y0;
+				splat->x1 = (Sint16)x1;
+				splat->y1 = (Sint16)y1;
+				splat->pixel = pixel;
+				if(counts != NULL && x1 > x0 && y1 > y0)
+				{
+					for(band = y0 / CGE_SPLAT_BAND; band <= (Uint32)(y1 - 1) / CGE_SPLAT_BAND; band++)
+					{
+						counts[band]++;
+					}
+				}
+				continue;
+			}
+			if(cloud->depth == 0)
+			{
+				for(sy = y0; sy < y1; sy++)
+				{
+					for(sx = x0; sx < x1; sx++)
+					{
+						*CGE_TILE(tiles, sx, sy) = pixel;
+					}
+				}
+				continue;
+			}
+
+			/* Depth in the high half so an atomic minimum keeps the nearest */
+			value = ((Uint32)((z * w + 1.0f) * 32767.5f) << 16) | pixel;
+			for(sy = y0; sy < y1; sy++)
+			{
+				for(sx = x0; sx < x1; sx++)
+				{
+					cell = &job->engine->depth.buffer[sy * width + sx];
+					old = *cell;
+					while(value < old && CGE_AtomicCas(cell, old, value) == 0)
+					{
+						old = *cell;
+					}
+				}
+			}
+		}
+	}
+
+	CGE_AtomicAdd(&job->engine->states.counters.pointsRejected, rejected);
+	CGE_AtomicAdd(&job->engine->states.counters.pointsRasterized, rasterized);
+	CGE_AtomicAdd(&job->engine->states.counters.pixels, pixels);
+}
+
+/* Writes the index of every splat into the bins of the bands it covers, */
+/* from where the prefix sum left this chunk */
+void CGE_BinJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_CloudJob *job;
+	const CGE_Splat *splat;
+	Uint32 *offset;
+	Uint32 views;
+	Uint32 band;
+	Uint32 i;
+
+	job = (CGE_CloudJob *)data;
+	offset = &job->counts[first / CGE_SPLAT_GRAIN * job->bands];
+	views = job->device.views;
+
+	for(i = first * views; i < (first + count) * views; i++)
+	{
+		splat = &job->splat[i];
+		if(splat->x1 <= splat->x0 || splat->y1 <= splat->y0)
+		{
+			continue;
+		}
+		for(band = splat->y0 / CGE_SPLAT_BAND; band <= (Uint32)(splat->y1 - 1) / CGE_SPLAT_BAND; band++)
+		{
+			job->bins[offset[band]++] = i;
+		}
+	}
+}
+
+/* Rows are split in bands, each written by one worker only, going over */
+/* its bin in point order. Without bins every splat is looked at */
+void CGE_BandJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_CloudJob *job;
+	const CGE_Splat *splat;
+	Uint16 *tiles;
+	Uint32 band;
+	Uint32 start;
+	Uint32 end;
+	Uint32 i;
+	Uint32 k;
+	int top;
+	int bottom;
+	int y0;
+	int y1;
+	int sx;
+	int sy;
+
+	job = (CGE_CloudJob *)data;
+	tiles = job->engine->resolution.tiles;
+
+	for(band = first; band < first + count; band++)
+	{
+		top = (int)band * CGE_SPLAT_BAND;
+		bottom = top + CGE_SPLAT_BAND;
+		start = job->bins != NULL ? job->bandFirst[band] : 0;
+		end = job->bins != NULL ? job->bandFirst[band + 1] : job->cloud->points * job->device.views;
+		for(k = start; k < end; k++)
+		{
+			i = job->bins != NULL ? job->bins[k] : k;
+			splat = &job->splat[i];
+			if(splat->y1 <= top || splat->y0 >= bottom)
+			{
+				continue;
+			}
+
+			y0 = splat->y0 > top ? splat->y0 : top;
+			y1 = splat->y1 < bottom ? splat->y1 : bottom;
+			for(sy = y0; sy < y1; sy++)
+			{
+				for(sx = splat->x0; sx < splat->x1; sx++)
+				{
+					*CGE_TILE(tiles, sx, sy) = splat->pixel;
+				}
+			}
+		}
+	}
+}
+
+void CGE_ResolveJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_CloudJob *job;
+	Uint16 *tiles;
+	Uint32 *row;
+	Uint32 y;
+	int x;
+	int width;
+
+	job = (CGE_CloudJob *)data;
+	tiles = job->engine->resolution.tiles;
+	width = job->engine->depth.width;
+
+	for(y = first; y < first + count; y++)
+	{
+		row = &job->engine->depth.buffer[y * width];
+		for(x = 0; x < width; x++)
+		{
+			if(row[x] != 0xFFFFFFFF)
+			{
+				*CGE_TILE(tiles, x, (int)y) = (Uint16)row[x];
+			}
+		}
+	}
+}
+
+
+/* Billboard functions implementations */
+
+/* Converts the surface to the screen format, padded up to powers of two, */
+/* and builds the levels down to a side of one texel. With alpha the */
+/* colour key of the surface and the padding are transparent */
+CGE_EXITCODE CGE_TextureNew(CGE_Engine *engine, CGE_Texture *texture, SDL_Surface *source, int alpha)
+{
+	SDL_PixelFormat *format;
+	Uint16 *level;
+	Uint16 *parent;
+	Uint32 total;
+	Uint32 pixel;
+	Uint32 index;
+	Uint32 r;
+	Uint32 g;
+	Uint32 b;
+	Uint8 cr;
+	Uint8 cg;
+	Uint8 cb;
+	int opaque;
+	int shared;
+	int width;
+	int height;
+	int l;
+	int x;
+	int y;
+	int i;
+
+	texture->texels = NULL;
+	texture->levels = 0;
+	if(source == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	format = engine->screen->format;
+	texture->alpha = alpha;
+	texture->key = (Uint16)SDL_MapRGB(format, 255, 0, 255);
+
+	for(texture->widthShift = 0; (1 << texture->widthShift) < source->w && texture->widthShift < CGE_TEXTURE_LEVELS - 1; texture->widthShift++);
+	for(texture->heightShift = 0; (1 << texture->heightShift) < source->h && texture->heightShift < CGE_TEXTURE_LEVELS - 1; texture->heightShift++);
+	texture->width = 1 << texture->widthShift;
+	texture->height = 1 << texture->heightShift;
+	texture->levels = (texture->widthShift < texture->heightShift ? texture->widthShift : texture->heightShift) + 1;
+
+	total = 0;
+	for(l = 0; l < texture->levels; l++)
+	{
+		texture->offset[l] = total;
+		total += (Uint32)(texture->width >> l) * (texture->height >> l);
+	}
+
+	texture->texels = (Uint16 *)malloc(total * sizeof(Uint16));
+	if(texture->texels == NULL)
+	{
+		texture->levels = 0;
+		return CGE_ERR;
+	}
+
+	if(SDL_MUSTLOCK(source))
+	{
+		SDL_LockSurface(source);
+	}
+
+	shared = texture->levels - 1;
+	level = texture->texels;
+	for(y = 0; y < texture->height; y++)
+	{
+		for(x = 0; x < texture->width; x++)
+		{
+			index = CGE_TextureSwizzle(x, shared, 0) | CGE_TextureSwizzle(y, shared, 1);
+			if(alpha == 1 && (x >= source->w || y >= source->h))
+			{
+				level[index] = texture->key;
+				continue;
+			}
+
+			pixel = CGE_SurfacePixel(source, x < source->w ? x : source->w - 1, y < source->h ? y : source->h - 1);
+			if(alpha == 1 && (source->flags & SDL_SRCCOLORKEY) && pixel == source->format->colorkey)
+			{
+				level[index] = texture->key;
+				continue;
+			}
+
+			SDL_GetRGB(pixel, source->format, &cr, &cg, &cb);
+			level[index] = (Uint16)SDL_MapRGB(format, cr, cg, cb);
+			if(level[index] == texture->key)
+			{
+				level[index] ^= 1;
+			}
+		}
+	}
+
+	if(SDL_MUSTLOCK(source))
+	{
+		SDL_UnlockSurface(source);
+	}
+
+	/* Each texel averages the opaque ones of its four parents, and stays */
+	/* transparent unless at least two of them are opaque */
+	for(l = 1; l < texture->levels; l++)
+	{
+		parent = texture->texels + texture->offset[l - 1];
+		level = texture->texels + texture->offset[l];
+		width = texture->width >> l;
+		height = texture->height >> l;
+		shared = texture->levels - 1 - l;
+
+		for(index = 0; index < (Uint32)width * height; index++)
+		{
+			/* Morton order keeps the four parents of a texel together */
+			r = 0;
+			g = 0;
+			b = 0;
+			opaque = 0;
+			for(i = 0; i < 4; i++)
+			{
+				if(alpha == 1 && parent[index * 4 + i] == texture->key)
+				{
+					continue;
+				}
+				SDL_GetRGB(parent[index * 4 + i], format, &cr, &cg, &cb);
+				r += cr;
+				g += cg;
+				b += cb;
+				opaque++;
+			}
+
+			if(opaque < 2)
+			{
+				level[index] = texture->key;
+				continue;
+			}
+
+			level[index] = (Uint16)SDL_MapRGB(format, (Uint8)(r / opaque), (Uint8)(g / opaque), (Uint8)(b / opaque));
+			if(level[index] == texture->key)
+			{
+				level[index] ^= 1;
+			}
+		}
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_TextureText(CGE_Engine *engine, CGE_Texture *texture, char *text, SDL_Color color)
+{
+	SDL_Surface *surface;
+	CGE_EXITCODE code;
+
+	surface = TTF_RenderText_Solid(engine->font, text, color);
+	code = CGE_TextureNew(engine, texture, surface, 1);
+	if(surface != NULL)
+	{
+		SDL_FreeSurface(surface);
+	}
+
+	return code;
+}
+
+CGE_EXITCODE CGE_TextureFree(CGE_Texture *texture)
+{
+	free(texture->texels);
+	texture->texels = NULL;
+	texture->levels = 0;
+
+	return CGE_OK;
+}
+
+/* Morton bits of one coordinate, x on the even bits and y on the odd */
+/* ones up to the shared bits of the shorter side, the longer side's */
+/* remaining bits going above them. The two coordinates are ORed */
+Uint32 CGE_TextureSwizzle(Uint32 coordinate, int shared, int axis)
+{
+	Uint32 index;
+	int i;
+
+	index = 0;
+	for(i = 0; i < shared; i++)
+	{
+		index |= ((coordinate >> i) & 1) << (2 * i + axis);
+	}
+
+	return index | ((coordinate >> shared) << (2 * shared));
+}
+
+Uint32 CGE_SurfacePixel(SDL_Surface *surface, int x, int y)
+{
+	Uint8 *p;
+
+	p = (Uint8 *)surface->pixels + y * surface->pitch + x * surface->format->BytesPerPixel;
+	switch(surface->format->BytesPerPixel)
+	{
+		case 1:
+			return *p;
+		case 2:
+			return *(Uint16 *)p;
+		case 3:
+			if(SDL_BYTEORDER == SDL_BIG_ENDIAN)
+			{
+				return (p[0] << 16) | (p[1] << 8) | p[2];
+			}
+			return p[0] | (p[1] << 8) | (p[2] << 16);
+		default:
+			return *(Uint32 *)p;
+	}
+}
+
+/* The visible billboards are copied into the frame arena sorted on their */
+/* texture, then back to front, and each texture's run is one command */
+CGE_EXITCODE CGE_CommandBillboards(CGE_Engine *engine, CGE_CommandBuffer *buffer, const CGE_Billboard *billboards, Uint32 count, Uint8 state)
+{
+	CGE_DrawCommand *command;
+	CGE_Billboard *sorted;
+	Uint32 histogram[256];
+	Uint32 *keys;
+	Uint32 *order;
+	Uint32 *tempKeys;
+	Uint32 *tempOrder;
+	Uint32 *swap;
+	Uint32 visible;
+	Uint32 offset;
+	Uint32 total;
+	Uint32 texture;
+	Uint32 i;
+	int shift;
+	size_t mark;
+	CGE_V3 extent;
+	float half;
+	CGE_EXITCODE code;
+
+	sorted = (CGE_Billboard *)CGE_FrameAlloc(engine, count * sizeof(CGE_Billboard));
+	mark = CGE_FrameMark(engine);
+	keys = (Uint32 *)CGE_FrameAlloc(engine, count * sizeof(Uint32));
+	order = (Uint32 *)CGE_FrameAlloc(engine, count * sizeof(Uint32));
+	tempKeys = (Uint32 *)CGE_FrameAlloc(engine, count * sizeof(Uint32));
+	tempOrder = (Uint32 *)CGE_FrameAlloc(engine, count * sizeof(Uint32));
+	if(sorted == NULL || keys == NULL || order == NULL || tempKeys == NULL || tempOrder == NULL)
+	{
+		/* The arena grows to what was asked for by the next frame */
+		CGE_FrameRelease(engine, mark);
+		return CGE_ERR;
+	}
+
+	visible = 0;
+	for(i = 0; i < count; i++)
+	{
+		half = billboards[i].size / 2.0f;
+		if(billboards[i].texture->width > billboards[i].texture->height)
+		{
+			half *= (float)billboards[i].texture->width / billboards[i].texture->height;
+		}
+		extent = CGE_V3New(half, half, half);
+		if(CGE_BoundsVisible(engine, CGE_V3V3Sub(billboards[i].position, extent), CGE_V3V3Add(billboards[i].position, extent)) == 0)
+		{
+			continue;
+		}
+
+		texture = (Uint32)(((size_t)billboards[i].texture >> 4) * 2654435761u) >> 24;
+		keys[visible] = (texture << 16) | (0xFFFF - CGE_CommandDepth(engine, billboards[i].position));
+		order[visible] = i;
+		visible++;
+	}
+
+	/* Stable LSD radix sort of the 24 bit keys, the pointers are swapped */
+	/* after each pass so they are left on the sorted copy */
+	for(shift = 0; shift < 24; shift += 8)
+	{
+		memset(histogram, 0, sizeof(histogram));
+		for(i = 0; i < visible; i++)
+		{
+			histogram[(keys[i] >> shift) & 0xFF]++;
+		}
+
+		total = 0;
+		for(i = 0; i < 256; i++)
+		{
+			offset = histogram[i];
+			histogram[i] = total;
+			total += offset;
+		}
+
+		for(i = 0; i < visible; i++)
+		{
+			offset = histogram[(keys[i] >> shift) & 0xFF]++;
+			tempKeys[offset] = keys[i];
+			tempOrder[offset] = order[i];
+		}
+
+		swap = keys;
+		keys = tempKeys;
+		tempKeys = swap;
+		swap = order;
+		order = tempOrder;
+		tempOrder = swap;
+	}
+
+	code = CGE_OK;
+	command = NULL;
+	for(i = 0; i < visible; i++)
+	{
+		sorted[i] = billboards[order[i]];
+		if(i > 0 && sorted[i].texture == sorted[i - 1].texture)
+		{
+			if(command != NULL)
+			{
+				command->count++;
+			}
+			continue;
+		}
+
+		/* Past the capacity the count still sizes the next frame's buffer */
+		command = NULL;
+		buffer->commandsNeeded += 1;
+		if(buffer->count >= buffer->capacity)
+		{
+			code = CGE_ERR;
+			continue;
+		}
+
+		/* A run is keyed on its texture and its farthest billboard */
+		command = &buffer->commands[buffer->count++];
+		command->key = ((Uint32)state << 24) | keys[i];
+		command->first = 0;
+		command->count = 1;
+		command->vertices = NULL;
+		command->mesh = NULL;
+		command->model = NULL;
+		command->cloud = NULL;
+		command->billboard = &sorted[i];
+		command->color = CGE_ColorNew(255, 255, 255);
+		command->primitive = CGE_PRIMITIVE_BILLBOARD;
+		command->state = state;
+	}
+
+	CGE_FrameRelease(engine, mark);
+
+	return code;
+}
+
+/* The level is the one closest to a texel per pixel, sampled nearest in */
+/* 16.16 fixed point with the column swizzles computed once per billboard */
+CGE_EXITCODE CGE_DrawBillboard(CGE_Engine *engine, const CGE_Billboard *billboard)
+{
+	const CGE_Texture *texture;
+	CGE_V4Views clip;
+	CGE_V4 c;
+	CGE_Viewport viewport;
+	Uint16 *tiles;
+	Uint32 columns[CGE_SCREEN_WIDTH];
+	Uint32 row;
+	Uint32 ustep;
+	Uint32 vstep;
+	Uint32 u;
+	Uint32 v;
+	Uint32 pixels;
+	Uint16 *level;
+	Uint16 texel;
+	float height;
+	float width;
+	float cx;
+	float cy;
+	float ratio;
+	int shared;
+	int l;
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	int left;
+	int top;
+	int x;
+	int y;
+	int i;
+
+	texture = billboard->texture;
+	if(texture->levels == 0)
+	{
+		return CGE_ERR;
+	}
+
+	tiles = engine->resolution.tiles;
+	pixels = 0;
+	CGE_V4ViewsTransform(&engine->device, billboard->position, &clip);
+
+	for(i = 0; i < engine->device.views; i++)
+	{
+		c = CGE_V4ViewsGet(&clip, i);
+		if(c.w <= 0.0f || c.z < -c.w || c.z > c.w)
+		{
+			continue;
+		}
+
+		viewport = engine->device.viewport[i];
+		height = billboard->size * engine->device.projection[i].m22 / c.w * viewport.h / 2.0f;
+		if(height < 1.0f)
+		{
+			continue;
+		}
+		width = height * texture->width / texture->height;
+
+		l = 0;
+		ratio = texture->height / height;
+		while(l + 1 < texture->levels && ratio >= 2.0f)
+		{
+			ratio /= 2.0f;
+			l++;
+		}
+		level = texture->texels + texture->offset[l];
+		shared = texture->levels - 1 - l;
+
+		cx = (c.x / c.w + 1.0f) * viewport.w / 2.0f + viewport.x;
+		cy = (-c.y / c.w + 1.0f) * viewport.h / 2.0f + viewport.y;
+		left = (int)(cx - width / 2.0f);
+		top = (int)(cy - height / 2.0f);
+
+		x0 = left > (int)viewport.x ? left : (int)viewport.x;
+		y0 = top > (int)viewport.y ? top : (int)viewport.y;
+		x1 = (int)(cx + width / 2.0f);
+		y1 = (int)(cy + height / 2.0f);
+		x1 = x1 < (int)(viewport.x + viewport.w) ? x1 : (int)(viewport.x + viewport.w);
+		y1 = y1 < (int)(viewport.y + viewport.h) ? y1 : (int)(viewport.y + viewport.h);
+		x1 = x1 < CGE_SCREEN_WIDTH ? x1 : CGE_SCREEN_WIDTH;
+		y1 = y1 < CGE_SCREEN_HEIGHT ? y1 : CGE_SCREEN_HEIGHT;
+		if(x0 >= x1 || y0 >= y1)
+		{
+			continue;
+		}
+
+		ustep = (Uint32)((texture->width >> l) * 65536.0f / width);
+		vstep = (Uint32)((texture->height >> l) * 65536.0f / height);
+
+		/* Rounding the corners may step one texel past the last one */
+		for(x = x0, u = (x0 - left) * ustep + ustep / 2; x < x1; x++, u += ustep)
+		{
+			columns[x - x0] = CGE_TextureSwizzle((u >> 16) < (Uint32)(texture->width >> l) ? u >> 16 : (texture->width >> l) - 1, shared, 0);
+		}
+
+		for(y = y0, v = (y0 - top) * vstep + vstep / 2; y < y1; y++, v += vstep)
+		{
+			row = CGE_TextureSwizzle((v >> 16) < (Uint32)(texture->height >> l) ? v >> 16 : (texture->height >> l) - 1, shared, 1);
+			for(x = x0; x < x1; x++)
+			{
+				texel = level[columns[x - x0] | row];
+				if(texture->alpha == 1 && texel == texture->key)
+				{
+					continue;
+				}
+				*CGE_TILE(tiles, x, y) = texel;
+				pixels++;
+				if(engine->heat.buffer != NULL && x < engine->heat.width && y < engine->heat.height)
+				{
+					engine->heat.buffer[y * engine->heat.width + x]++;
+				}
+			}
+		}
+	}
+
+	engine->states.counters.pixels += pixels;
+
+	return CGE_OK;
+}
+
+/* Labelled markers scattered over the ground, a few textures shared */
+CGE_EXITCODE CGE_MarkersScatter(CGE_Engine *engine, Uint32 count)
+{
+	CGE_EngineMarkers *markers;
+	char label[32];
+	Uint32 seed;
+	Uint32 i;
+	int t;
+
+	CGE_MarkersFree(engine);
+	markers = &engine->markers;
+
+	for(t = 0; t < CGE_MARKERS_TEXTURES; t++)
+	{
+		sprintf(label, "P%d", t);
+		if(CGE_TextureText(engine, &markers->texture[t], label, CGE_ColorNew(255 - t * 24, 160 + t * 12, 60 + t * 24)) == CGE_ERR)
+		{
+			CGE_MarkersFree(engine);
+			return CGE_ERR;
+		}
+		markers->textures++;
+	}
+
+	markers->billboard = (CGE_Billboard *)malloc(count * sizeof(CGE_Billboard));
+	if(markers->billboard == NULL)
+	{
+		CGE_MarkersFree(engine);
+		return CGE_ERR;
+	}
+
+	seed = 7;
+	for(i = 0; i < count; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		markers->billboard[i].position.x = (float)(seed >> 16) / 65535.0f * 200.0f - 100.0f;
+		seed = seed * 1664525 + 1013904223;
+		markers->billboard[i].position.z = (float)(seed >> 16) / 65535.0f * 200.0f - 100.0f;
+		markers->billboard[i].position.y = -8.0f;
+		markers->billboard[i].size = 1.5f;
+		markers->billboard[i].texture = &markers->texture[i % CGE_MARKERS_TEXTURES];
+	}
+	markers->count = count;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_MarkersFree(CGE_Engine *engine)
+{
+	int t;
+
+	for(t = 0; t < engine->markers.textures; t++)
+	{
+		CGE_TextureFree(&engine->markers.texture[t]);
+	}
+	free(engine->markers.billboard);
+	engine->markers.textures = 0;
+	engine->markers.billboard = NULL;
+	engine->markers.count = 0;
+
+	return CGE_OK;
+}
+
+/* Collision functions implementations */
+
+CGE_EXITCODE CGE_HashNew(CGE_SpatialHash *hash, float cell)
+{
+	Uint32 i;
+
+	hash->cell = cell;
+	hash->buckets = CGE_HASH_BUCKETS;
+	hash->linked = 0;
+	hash->entry = NULL;
+	hash->entries = 0;
+	hash->entriesCapacity = 0;
+	hash->entryFree = CGE_HASH_NONE;
+	hash->collider = NULL;
+	hash->colliders = 0;
+	hash->collidersCapacity = 0;
+	hash->colliderFree = CGE_HASH_NONE;
+	hash->points = NULL;
+	hash->pointsCount = 0;
+	hash->pointsCapacity = 0;
+	hash->pointsFree = CGE_HASH_NONE;
+	hash->count = 0;
+	hash->stamp = 0;
+
+	hash->bucket = (Uint32 *)malloc(CGE_HASH_BUCKETS * sizeof(Uint32));
+	if(hash->bucket == NULL)
+	{
+		return CGE_ERR;
+	}
+	for(i = 0; i < CGE_HASH_BUCKETS; i++)
+	{
+		hash->bucket[i] = CGE_HASH_NONE;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_HashFree(CGE_SpatialHash *hash)
+{
+	free(hash->bucket);
+	free(hash->entry);
+	free(hash->collider);
+	free(hash->points);
+	hash->bucket = NULL;
+	hash->entry = NULL;
+	hash->collider = NULL;
+	hash->points = NULL;
+	hash->linked = 0;
+	hash->entries = 0;
+	hash->entriesCapacity = 0;
+	hash->colliders = 0;
+	hash->collidersCapacity = 0;
+	hash->pointsCount = 0;
+	hash->pointsCapacity = 0;
+	hash->count = 0;
+
+	return CGE_OK;
+}
+
+/* Takes an unused collider, CGE_HASH_NONE when out of memory */
+Uint32 CGE_HashCollider(CGE_SpatialHash *hash)
+{
+	CGE_Collider *colliders;
+	Uint32 capacity;
+	Uint32 handle;
+
+	if(hash->colliderFree != CGE_HASH_NONE)
+	{
+		handle = hash->colliderFree;
+		hash->colliderFree = hash->collider[handle].next;
+		return handle;
+	}
+
+	if(hash->colliders == hash->collidersCapacity)
+	{
+		capacity = hash->collidersCapacity == 0 ? 1024 : hash->collidersCapacity * 2;
+		colliders = (CGE_Collider *)realloc(hash->collider, capacity * sizeof(CGE_Collider));
+		if(colliders == NULL)
+		{
+			return CGE_HASH_NONE;
+		}
+		hash->collider = colliders;
+		hash->collidersCapacity = capacity;
+	}
+
+	return hash->colliders++;
+}
+
+/* Returns the handle of the collider, CGE_HASH_NONE when out of memory. */
+/* Segments use a and b, triangles a, b and c */
+Uint32 CGE_HashInsert(CGE_SpatialHash *hash, CGE_ColliderShape shape, CGE_V3 a, CGE_V3 b, CGE_V3 c)
+{
+	CGE_ColliderPoints *points;
+	Uint32 capacity;
+	Uint32 first;
+	Uint32 handle;
+
+	if(hash->bucket == NULL)
+	{
+		return CGE_HASH_NONE;
+	}
+
+	if(hash->pointsFree != CGE_HASH_NONE)
+	{
+		first = hash->pointsFree;
+		hash->pointsFree = hash->points[first].next;
+	}
+	else
+	{
+		if(hash->pointsCount == hash->pointsCapacity)
+		{
+			capacity = hash->pointsCapacity == 0 ? 256 : hash->pointsCapacity * 2;
+			points = (CGE_ColliderPoints *)realloc(hash->points, capacity * sizeof(CGE_ColliderPoints));
+			if(points == NULL)
+			{
+				return CGE_HASH_NONE;
+			}
+			hash->points = points;
+			hash->pointsCapacity = capacity;
+		}
+		first = hash->pointsCount++;
+	}
+
+	handle = CGE_HashCollider(hash);
+	if(handle == CGE_HASH_NONE)
+	{
+		hash->points[first].next = hash->pointsFree;
+		hash->pointsFree = first;
+		return CGE_HASH_NONE;
+	}
+
+	hash->points[first].point[0] = a;
+	hash->points[first].point[1] = b;
+	hash->points[first].point[2] = c;
+	hash->points[first].next = CGE_HASH_NONE;
+	hash->collider[handle].mesh = NULL;
+	hash->collider[handle].first = first;
+	hash->collider[handle].shape = (Uint8)shape;
+	hash->collider[handle].used = 1;
+	hash->collider[handle].stamp = hash->stamp;
+	hash->collider[handle].next = CGE_HASH_NONE;
+	hash->count++;
+
+	if(CGE_HashCells(hash, handle, 1) == CGE_ERR)
+	{
+		CGE_HashRemove(hash, handle);
+		return CGE_HASH_NONE;
+	}
+
+	return handle;
+}
+
+/* A collider over the indices of the mesh from first on, two for a */
+/* segment and three for a triangle. The mesh must outlive the hash */
+Uint32 CGE_HashInsertMesh(CGE_SpatialHash *hash, CGE_ColliderShape shape, const CGE_Mesh *mesh, Uint32 first)
+{
+	Uint32 handle;
+
+	if(hash->bucket == NULL)
+	{
+		return CGE_HASH_NONE;
+	}
+
+	handle = CGE_HashCollider(hash);
+	if(handle == CGE_HASH_NONE)
+	{
+		return CGE_HASH_NONE;
+	}
+
+	hash->collider[handle].mesh = mesh;
+	hash->collider[handle].first = first;
+	hash->collider[handle].shape = (Uint8)shape;
+	hash->collider[handle].used = 1;
+	hash->collider[handle].stamp = hash->stamp;
+	hash->collider[handle].next = CGE_HASH_NONE;
+	hash->count++;
+
+	if(CGE_HashCells(hash, handle, 1) == CGE_ERR)
+	{
+		CGE_HashRemove(hash, handle);
+		return CGE_HASH_NONE;
+	}
+
+	return handle;
+}
+
+/* Moves a collider, for objects moving through the scene. Colliders cut */
+/* from a mesh move with it */
+CGE_EXITCODE CGE_HashUpdate(CGE_SpatialHash *hash, Uint32 handle, CGE_V3 a, CGE_V3 b, CGE_V3 c)
+{
+	CGE_ColliderPoints *points;
+
+	if(handle >= hash->colliders || hash->collider[handle].used == 0 || hash->collider[handle].mesh != NULL)
+	{
+		return CGE_ERR;
+	}
+
+	CGE_HashCells(hash, handle, 0);
+	points = &hash->points[hash->collider[handle].first];
+	points->point[0] = a;
+	points->point[1] = b;
+	points->point[2] = c;
+
+	return CGE_HashCells(hash, handle, 1);
+}
+
+CGE_EXITCODE CGE_HashRemove(CGE_SpatialHash *hash, Uint32 handle)
+{
+	CGE_Collider *collider;
+
+	if(handle >= hash->colliders || hash->collider[handle].used == 0)
+	{
+		return CGE_ERR;
+	}
+
+	CGE_HashCells(hash, handle, 0);
+	collider = &hash->collider[handle];
+	if(collider->mesh == NULL)
+	{
+		hash->points[collider->first].next = hash->pointsFree;
+		hash->pointsFree = collider->first;
+	}
+	collider->used = 0;
+	collider->next = hash->colliderFree;
+	hash->colliderFree = handle;
+	hash->count--;
+
+	return CGE_OK;
+}
+
+/* Links or unlinks the collider in every cell it touches. Segments walk */
+/* the cells they cross, a long segment does not fill its bounding box; */
+/* triangles take the cells of their bounding box */
+CGE_EXITCODE CGE_HashCells(CGE_SpatialHash *hash, Uint32 handle, int link)
+{
+	CGE_Collider *collider;
+	CGE_V3 point[3];
+	float origin[3];
+	float direction[3];
+	float next[3];
+	float delta[3];
+	float min;
+	float max;
+	int cell[3];
+	int last[3];
+	int step[3];
+	int lo[3];
+	int hi[3];
+	int steps;
+	int axis;
+	int i;
+	int x;
+	int y;
+	int z;
+
+	collider = &hash->collider[handle];
+	CGE_ColliderPointsGet(hash, collider, point);
+
+	if(collider->shape == CGE_COLLIDER_TRIANGLE)
+	{
+		for(i = 0; i < 3; i++)
+		{
+			min = CGE_V3Axis(point[0], i);
+			max = min;
+			min = CGE_V3Axis(point[1], i) < min ? CGE_V3Axis(point[1], i) : min;
+			max = CGE_V3Axis(point[1], i) > max ? CGE_V3Axis(point[1], i) : max;
+			min = CGE_V3Axis(point[2], i) < min ? CGE_V3Axis(point[2], i) : min;
+			max = CGE_V3Axis(point[2], i) > max ? CGE_V3Axis(point[2], i) : max;
+			lo[i] = (int)floor(min / hash->cell);
+			hi[i] = (int)floor(max / hash->cell);
+		}
+
+		for(z = lo[2]; z <= hi[2]; z++)
+		{
+			for(y = lo[1]; y <= hi[1]; y++)
+			{
+				for(x = lo[0]; x <= hi[0]; x++)
+				{
+					if(CGE_HashCell(hash, handle, x, y, z, link) == CGE_ERR)
+					{
+						return CGE_ERR;
+					}
+				}
+			}
+		}
+
+		return CGE_OK;
+	}
+
+	/* Amanatides and Woo, the next cell is across the nearest boundary */
+	steps = 1;
+	for(i = 0; i < 3; i++)
+	{
+		origin[i] = CGE_V3Axis(point[0], i);
+		direction[i] = CGE_V3Axis(point[1], i) - origin[i];
+		cell[i] = (int)floor(origin[i] / hash->cell);
+		last[i] = (int)floor(CGE_V3Axis(point[1], i) / hash->cell);
+		step[i] = last[i] > cell[i] ? 1 : (last[i] < cell[i] ? -1 : 0);
+		steps += step[i] * (last[i] - cell[i]);
+		if(step[i] == 0)
+		{
+			next[i] = 2.0f;
+			delta[i] = 0.0f;
+		}
+		else
+		{
+			next[i] = ((cell[i] + (step[i] > 0 ? 1 : 0)) * hash->cell - origin[i]) / direction[i];
+			delta[i] = hash->cell / (float)fabs(direction[i]);
+		}
+	}
+
+	for(i = 0; i < steps; i++)
+	{
+		if(CGE_HashCell(hash, handle, cell[0], cell[1], cell[2], link) == CGE_ERR)
+		{
+			return CGE_ERR;
+		}
+
+		axis = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) : (next[1] < next[2] ? 1 : 2);
+		if(step[axis] == 0)
+		{
+			break;
+		}
+		cell[axis] += step[axis];
+		next[axis] += delta[axis];
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_HashCell(CGE_SpatialHash *hash, Uint32 handle, int x, int y, int z, int link)
+{
+	CGE_HashEntry *entries;
+	Uint32 *previous;
+	Uint32 capacity;
+	Uint32 bucket;
+	Uint32 e;
+
+	bucket = CGE_HashBucket(hash->buckets, x, y, z);
+
+	if(link == 0)
+	{
+		for(previous = &hash->bucket[bucket]; *previous != CGE_HASH_NONE; previous = &hash->entry[*previous].next)
+		{
+			e = *previous;
+			if(hash->entry[e].collider == handle && hash->entry[e].x == x && hash->entry[e].y == y && hash->entry[e].z == z)
+			{
+				*previous = hash->entry[e].next;
+				hash->entry[e].next = hash->entryFree;
+				hash->entryFree = e;
+				hash->linked--;
+				return CGE_OK;
+			}
+		}
+		return CGE_OK;
+	}
+
+	if(hash->entryFree != CGE_HASH_NONE)
+	{
+		e = hash->entryFree;
+		hash->entryFree = hash->entry[e].next;
+	}
+	else
+	{
+		if(hash->entries == hash->entriesCapacity)
+		{
+			capacity = hash->entriesCapacity == 0 ? 4096 : hash->entriesCapacity * 2;
+			entries = (CGE_HashEntry *)realloc(hash->entry, capacity * sizeof(CGE_HashEntry));
+			if(entries == NULL)
+			{
+				return CGE_ERR;
+			}
+			hash->entry = entries;
+			hash->entriesCapacity = capacity;
+		}
+		e = hash->entries++;
+	}
+
+	hash->entry[e].collider = handle;
+	hash->entry[e].x = x;
+	hash->entry[e].y = y;
+	hash->entry[e].z = z;
+	hash->entry[e].next = hash->bucket[bucket];
+	hash->bucket[bucket] = e;
+	hash->linked++;
+
+	/* Chains stay short as the scene grows, a failed grow only makes */
+	/* them longer */
+	if(hash->linked > hash->buckets * CGE_HASH_LOAD)
+	{
+		CGE_HashGrow(hash);
+	}
+
+	return CGE_OK;
+}
+
+/* Doubles the buckets and moves every linked entry to its new chain */
+CGE_EXITCODE CGE_HashGrow(CGE_SpatialHash *hash)
+{
+	Uint32 *bucket;
+	Uint32 buckets;
+	Uint32 next;
+	Uint32 b;
+	Uint32 i;
+	Uint32 e;
+
+	buckets = hash->buckets * 2;
+	if(buckets == 0)
+	{
+		return CGE_ERR;
+	}
+	bucket = (Uint32 *)malloc(buckets * sizeof(Uint32));
+	if(bucket == NULL)
+	{
+		return CGE_ERR;
+	}
+	for(i = 0; i < buckets; i++)
+	{
+		bucket[i] = CGE_HASH_NONE;
+	}
+
+	for(i = 0; i < hash->buckets; i++)
+	{
+		for(e = hash->bucket[i]; e != CGE_HASH_NONE; e = next)
+		{
+			next = hash->entry[e].next;
+			b = CGE_HashBucket(buckets, hash->entry[e].x, hash->entry[e].y, hash->entry[e].z);
+			hash->entry[e].next = bucket[b];
+			bucket[b] = e;
+		}
+	}
+
+	free(hash->bucket);
+	hash->bucket = bucket;
+	hash->buckets = buckets;
+
+	return CGE_OK;
+}
+
+/* Buckets are a power of two */
+Uint32 CGE_HashBucket(Uint32 buckets, int x, int y, int z)
+{
+	return (((Uint32)x * 73856093u) ^ ((Uint32)y * 19349663u) ^ ((Uint32)z * 83492791u)) & (buckets - 1);
+}
+
+CGE_EXITCODE CGE_ColliderPointsGet(const CGE_SpatialHash *hash, const CGE_Collider *collider, CGE_V3 *point)
+{
+	int i;
+
+	if(collider->mesh == NULL)
+	{
+		point[0] = hash->points[collider->first].point[0];
+		point[1] = hash->points[collider->first].point[1];
+		point[2] = hash->points[collider->first].point[2];
+		return CGE_OK;
+	}
+
+	point[2] = CGE_V3New(0.0f, 0.0f, 0.0f);
+	for(i = 0; i < (collider->shape == CGE_COLLIDER_TRIANGLE ? 3 : 2); i++)
+	{
+		point[i] = CGE_MeshVertex(collider->mesh, CGE_MESH_INDEX(collider->mesh, collider->first + i));
+	}
+
+	return CGE_OK;
+}
+
+/* Cells within radius of the box around a and b */
+CGE_EXITCODE CGE_HashRange(CGE_SpatialHash *hash, CGE_V3 a, CGE_V3 b, float radius, int *lo, int *hi)
+{
+	float min;
+	float max;
+	int i;
+
+	for(i = 0; i < 3; i++)
+	{
+		min = CGE_V3Axis(a, i) < CGE_V3Axis(b, i) ? CGE_V3Axis(a, i) : CGE_V3Axis(b, i);
+		max = CGE_V3Axis(a, i) > CGE_V3Axis(b, i) ? CGE_V3Axis(a, i) : CGE_V3Axis(b, i);
+		lo[i] = (int)floor((min - radius) / hash->cell);
+		hi[i] = (int)floor((max + radius) / hash->cell);
+	}
+
+	return CGE_OK;
+}
+
+/* First contact of a sphere moving from from to to. Each candidate is */
+/* approached by conservative advancement: the sphere moves by its */
+/* distance to the collider, which cannot skip over it. Contacts the */
+/* sphere starts in and moves away from are ignored so it can slide off */
+int CGE_HashSweep(CGE_SpatialHash *hash, CGE_V3 from, CGE_V3 to, float radius, CGE_Contact *contact)
+{
+	CGE_Collider *collider;
+	CGE_HashEntry *entry;
+	CGE_V3 point[3];
+	CGE_V3 motion;
+	CGE_V3 center;
+	CGE_V3 closest;
+	CGE_V3 away;
+	float length;
+	float distance;
+	float t;
+	int lo[3];
+	int hi[3];
+	int found;
+	int i;
+	int x;
+	int y;
+	int z;
+	Uint32 e;
+
+	motion = CGE_V3V3Sub(to, from);
+	length = CGE_V3Length(motion);
+	contact->time = 1.0f;
+	found = 0;
+	if(hash->count == 0 || length == 0.0f)
+	{
+		return 0;
+	}
+
+	CGE_HashRange(hash, from, to, radius, lo, hi);
+
+	hash->stamp++;
+	for(z = lo[2]; z <= hi[2]; z++)
+	{
+		for(y = lo[1]; y <= hi[1]; y++)
+		{
+			for(x = lo[0]; x <= hi[0]; x++)
+			{
+				for(e = hash->bucket[CGE_HashBucket(hash->buckets, x, y, z)]; e != CGE_HASH_NONE; e = entry->next)
+				{
+					entry = &hash->entry[e];
+					collider = &hash->collider[entry->collider];
+					if(entry->x != x || entry->y != y || entry->z != z || collider->stamp == hash->stamp)
+					{
+						continue;
+					}
+					collider->stamp = hash->stamp;
+					CGE_ColliderPointsGet(hash, collider, point);
+
+					t = 0.0f;
+					for(i = 0; i < 32 && t < contact->time; i++)
+					{
+						center = CGE_V3V3Add(from, CGE_V3ScalarMul(motion, t));
+						closest = CGE_ClosestCollider(collider->shape, point, center);
+						away = CGE_V3V3Sub(center, closest);
+						distance = CGE_V3Length(away) - radius;
+
+						if(distance < CGE_COLLISION_SKIN)
+						{
+							/* Sliding along a contact is moving away from it */
+							if(t == 0.0f && CGE_V3V3Mul(away, motion) > -0.001f * CGE_V3Length(away) * length)
+							{
+								break;
+							}
+							contact->time = t;
+							contact->depth = -distance;
+							contact->point = closest;
+							contact->normal = CGE_V3Normalize(away);
+							contact->collider = entry->collider;
+							found = 1;
+							break;
+						}
+						t += (distance - CGE_COLLISION_SKIN / 2.0f) / length;
+					}
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+/* Deepest overlap of the capsule from a to b with the colliders */
+int CGE_HashCapsule(CGE_SpatialHash *hash, CGE_V3 a, CGE_V3 b, float radius, CGE_Contact *contact)
+{
+	CGE_Collider *collider;
+	CGE_HashEntry *entry;
+	CGE_V3 point[3];
+	CGE_V3 onCapsule;
+	CGE_V3 onCollider;
+	float squared;
+	float distance;
+	int lo[3];
+	int hi[3];
+	int found;
+	int x;
+	int y;
+	int z;
+	Uint32 e;
+
+	contact->time = 0.0f;
+	contact->depth = 0.0f;
+	found = 0;
+	if(hash->count == 0)
+	{
+		return 0;
+	}
+
+	CGE_HashRange(hash, a, b, radius, lo, hi);
+
+	hash->stamp++;
+	for(z = lo[2]; z <= hi[2]; z++)
+	{
+		for(y = lo[1]; y <= hi[1]; y++)
+		{
+			for(x = lo[0]; x <= hi[0]; x++)
+			{
+				for(e = hash->bucket[CGE_HashBucket(hash->buckets, x, y, z)]; e != CGE_HASH_NONE; e = entry->next)
+				{
+					entry = &hash->entry[e];
+					collider = &hash->collider[entry->collider];
+					if(entry->x != x || entry->y != y || entry->z != z || collider->stamp == hash->stamp)
+					{
+						continue;
+					}
+					collider->stamp = hash->stamp;
+					CGE_ColliderPointsGet(hash, collider, point);
+
+					squared = CGE_CapsuleClosest(collider->shape, point, a, b, &onCapsule, &onCollider);
+					if(squared >= radius * radius)
+					{
+						continue;
+					}
+
+					distance = (float)sqrt(squared);
+					if(radius - distance > contact->depth || found == 0)
+					{
+						contact->depth = radius - distance;
+						contact->point = onCollider;
+						contact->normal = CGE_V3Normalize(CGE_V3V3Sub(onCapsule, onCollider));
+						contact->collider = entry->collider;
+						found = 1;
+					}
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+CGE_V3 CGE_ClosestSegment(CGE_V3 p, CGE_V3 a, CGE_V3 b)
+{
+	CGE_V3 ab;
+	float length;
+	float t;
+
+	ab = CGE_V3V3Sub(b, a);
+	length = CGE_V3V3Mul(ab, ab);
+	if(length == 0.0f)
+	{
+		return a;
+	}
+
+	t = CGE_V3V3Mul(CGE_V3V3Sub(p, a), ab) / length;
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+
+	return CGE_V3V3Add(a, CGE_V3ScalarMul(ab, t));
+}
+
+/* Ericson, Real-Time Collision Detection 5.1.5, by Voronoi regions */
+CGE_V3 CGE_ClosestTriangle(CGE_V3 p, CGE_V3 a, CGE_V3 b, CGE_V3 c)
+{
+	CGE_V3 ab;
+	CGE_V3 ac;
+	CGE_V3 ap;
+	CGE_V3 bp;
+	CGE_V3 cp;
+	float d1;
+	float d2;
+	float d3;
+	float d4;
+	float d5;
+	float d6;
+	float va;
+	float vb;
+	float vc;
+	float v;
+	float w;
+
+	ab = CGE_V3V3Sub(b, a);
+	ac = CGE_V3V3Sub(c, a);
+	ap = CGE_V3V3Sub(p, a);
+	d1 = CGE_V3V3Mul(ab, ap);
+	d2 = CGE_V3V3Mul(ac, ap);
+	if(d1 <= 0.0f && d2 <= 0.0f)
+	{
+		return a;
+	}
+
+	bp = CGE_V3V3Sub(p, b);
+	d3 = CGE_V3V3Mul(ab, bp);
+	d4 = CGE_V3V3Mul(ac, bp);
+	if(d3 >= 0.0f && d4 <= d3)
+	{
+		return b;
+	}
+
+	vc = d1 * d4 - d3 * d2;
+	if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+	{
+		return CGE_V3V3Add(a, CGE_V3ScalarMul(ab, d1 / (d1 - d3)));
+	}
+
+	cp = CGE_V3V3Sub(p, c);
+	d5 = CGE_V3V3Mul(ab, cp);
+	d6 = CGE_V3V3Mul(ac, cp);
+	if(d6 >= 0.0f && d5 <= d6)
+	{
+		return c;
+	}
+
+	vb = d5 * d2 - d1 * d6;
+	if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+	{
+		return CGE_V3V3Add(a, CGE_V3ScalarMul(ac, d2 / (d2 - d6)));
+	}
+
+	va = d3 * d6 - d5 * d4;
+	if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+	{
+		return CGE_V3V3Add(b, CGE_V3ScalarMul(CGE_V3V3Sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6))));
+	}
+
+	v = vb / (va + vb + vc);
+	w = vc / (va + vb + vc);
+
+	return CGE_V3V3Add(a, CGE_V3V3Add(CGE_V3ScalarMul(ab, v), CGE_V3ScalarMul(ac, w)));
+}
+
+CGE_V3 CGE_ClosestCollider(int shape, const CGE_V3 *point, CGE_V3 p)
+{
+	if(shape == CGE_COLLIDER_TRIANGLE)
+	{
+		return CGE_ClosestTriangle(p, point[0], point[1], point[2]);
+	}
+
+	return CGE_ClosestSegment(p, point[0], point[1]);
+}
+
+/* Ericson 5.1.9, returns the squared distance between the closest points */
+float CGE_SegmentsClosest(CGE_V3 p1, CGE_V3 q1, CGE_V3 p2, CGE_V3 q2, CGE_V3 *c1, CGE_V3 *c2)
+{
+	CGE_V3 d1;
+	CGE_V3 d2;
+	CGE_V3 r;
+	CGE_V3 between;
+	float a;
+	float e;
+	float f;
+	float c;
+	float b;
+	float denominator;
+	float s;
+	float t;
+
+	d1 = CGE_V3V3Sub(q1, p1);
+	d2 = CGE_V3V3Sub(q2, p2);
+	r = CGE_V3V3Sub(p1, p2);
+	a = CGE_V3V3Mul(d1, d1);
+	e = CGE_V3V3Mul(d2, d2);
+	f = CGE_V3V3Mul(d2, r);
+
+	if(a <= 1e-12f && e <= 1e-12f)
+	{
+		s = 0.0f;
+		t = 0.0f;
+	}
+	else if(a <= 1e-12f)
+	{
+		s = 0.0f;
+		t = f / e;
+		t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	}
+	else
+	{
+		c = CGE_V3V3Mul(d1, r);
+		if(e <= 1e-12f)
+		{
+			t = 0.0f;
+			s = -c / a;
+			s = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+		}
+		else
+		{
+			b = CGE_V3V3Mul(d1, d2);
+			denominator = a * e - b * b;
+			s = 0.0f;
+			if(denominator != 0.0f)
+			{
+				s = (b * f - c * e) / denominator;
+				s = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+			}
+			t = (b * s + f) / e;
+			if(t < 0.0f)
+			{
+				t = 0.0f;
+				s = -c / a;
+				s = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+			}
+			else if(t > 1.0f)
+			{
+				t = 1.0f;
+				s = (b - c) / a;
+				s = s < 0.0f ? 0.0f : (s > 1.0f ? 1.0f : s);
+			}
+		}
+	}
+
+	*c1 = CGE_V3V3Add(p1, CGE_V3ScalarMul(d1, s));
+	*c2 = CGE_V3V3Add(p2, CGE_V3ScalarMul(d2, t));
+	between = CGE_V3V3Sub(*c1, *c2);
+
+	return CGE_V3V3Mul(between, between);
+}
+
+/* Squared distance from the segment a b to the collider. Against a */
+/* triangle it is zero where the segment crosses it, otherwise the */
+/* nearest of the edges and of the segment's ends */
+float CGE_CapsuleClosest(int shape, const CGE_V3 *p, CGE_V3 a, CGE_V3 b, CGE_V3 *onCapsule, CGE_V3 *onCollider)
+{
+	CGE_V3 normal;
+	CGE_V3 ab;
+	CGE_V3 hit;
+	CGE_V3 c1;
+	CGE_V3 c2;
+	CGE_V3 between;
+	float best;
+	float squared;
+	float da;
+	float db;
+	int i;
+
+	if(shape == CGE_COLLIDER_SEGMENT)
+	{
+		return CGE_SegmentsClosest(a, b, p[0], p[1], onCapsule, onCollider);
+	}
+
+	normal = CGE_V3V3Cross(CGE_V3V3Sub(p[1], p[0]), CGE_V3V3Sub(p[2], p[0]));
+	da = CGE_V3V3Mul(normal, CGE_V3V3Sub(a, p[0]));
+	db = CGE_V3V3Mul(normal, CGE_V3V3Sub(b, p[0]));
+	if((da <= 0.0f && db >= 0.0f) || (da >= 0.0f && db <= 0.0f))
+	{
+		ab = CGE_V3V3Sub(b, a);
+		hit = da == db ? a : CGE_V3V3Add(a, CGE_V3ScalarMul(ab, da / (da - db)));
+		c2 = CGE_ClosestTriangle(hit, p[0], p[1], p[2]);
+		between = CGE_V3V3Sub(hit, c2);
+		if(CGE_V3V3Mul(between, between) < 1e-10f)
+		{
+			*onCapsule = hit;
+			*onCollider = c2;
+			return 0.0f;
+		}
+	}
+
+	*onCapsule = a;
+	*onCollider = CGE_ClosestTriangle(a, p[0], p[1], p[2]);
+	between = CGE_V3V3Sub(*onCapsule, *onCollider);
+	best = CGE_V3V3Mul(between, between);
+
+	c1 = b;
+	c2 = CGE_ClosestTriangle(b, p[0], p[1], p[2]);
+	between = CGE_V3V3Sub(c1, c2);
+	squared = CGE_V3V3Mul(between, between);
+	if(squared < best)
+	{
+		best = squared;
+		*onCapsule = c1;
+		*onCollider = c2;
+	}
+
+	for(i = 0; i < 3; i++)
+	{
+		squared = CGE_SegmentsClosest(a, b, p[i], p[(i + 1) % 3], &c1, &c2);
+		if(squared < best)
+		{
+			best = squared;
+			*onCapsule = c1;
+			*onCollider = c2;
+		}
+	}
+
+	return best;
+}
+
+/* Moves a sphere by motion, sliding along what it meets */
+CGE_V3 CGE_SlideMove(CGE_SpatialHash *hash, CGE_V3 position, CGE_V3 motion, float radius)
+{
+	CGE_Contact contact;
+	int i;
+
+	for(i = 0; i < 3; i++)
+	{
+		if(CGE_HashSweep(hash, position, CGE_V3V3Add(position, motion), radius, &contact) == 0)
+		{
+			return CGE_V3V3Add(position, motion);
+		}
+
+		position = CGE_V3V3Add(position, CGE_V3ScalarMul(motion, contact.time));
+		motion = CGE_V3ScalarMul(motion, 1.0f - contact.time);
+		motion = CGE_V3V3Sub(motion, CGE_V3ScalarMul(contact.normal, CGE_V3V3Mul(motion, contact.normal)));
+	}
+
+	return position;
+}
+
+/* The scene's segments at full detail, for the camera to collide with. */
+/* They refer to the mapped mesh instead of copying its vertices */
+CGE_EXITCODE CGE_CollisionScene(CGE_Engine *engine)
+{
+	const CGE_Mesh *mesh;
+	Uint32 first;
+	Uint32 count;
+	Uint32 a;
+	Uint32 b;
+	Uint32 i;
+	Uint32 j;
+
+	for(i = 0; i < engine->scene.meshes; i++)
+	{
+		mesh = &engine->scene.mesh[i];
+		CGE_MeshLod(mesh, 0.0f, &first, &count);
+		for(j = first; j + 1 < first + count; j += 2)
+		{
+			a = CGE_MESH_INDEX(mesh, j);
+			b = CGE_MESH_INDEX(mesh, j + 1);
+			if(a >= mesh->vertices || b >= mesh->vertices)
+			{
+				continue;
+			}
+			if(CGE_HashInsertMesh(&engine->collision, CGE_COLLIDER_SEGMENT, mesh, j) == CGE_HASH_NONE)
+			{
+				return CGE_ERR;
+			}
+		}
+	}
+
+	return CGE_OK;
+}
+
+/* Entity functions implementations */
+
+CGE_EXITCODE CGE_EntitiesNew(CGE_Entities *entities)
+{
+	memset(entities, 0, sizeof(CGE_Entities));
+	entities->slotFree = CGE_ENTITY_NONE;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_EntitiesFree(CGE_Entities *entities)
+{
+	CGE_ArenaFree(&entities->arena);
+
+	return CGE_EntitiesNew(entities);
+}
+
+/* Every array lives in one arena, each on its own cache lines. Growing */
+/* carves a bigger arena and copies the arrays across */
+CGE_EXITCODE CGE_EntitiesGrow(CGE_Entities *entities, Uint32 capacity)
+{
+	CGE_Entities grown;
+	size_t size;
+
+	if(capacity <= entities->capacity || capacity > CGE_ENTITY_SLOT_MASK)
+	{
+		return CGE_ERR;
+	}
+
+	grown = *entities;
+	size = (size_t)capacity * (9 * sizeof(float) + 3 * sizeof(Uint32) + sizeof(CGE_M4) + sizeof(Uint16)) + 14 * CGE_ARENA_ALIGN;
+	if(CGE_ArenaNew(&grown.arena, size) == CGE_ERR)
+	{
+		return CGE_ERR;
+	}
+
+	grown.x = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.y = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.z = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.yaw = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.vx = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.vy = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.vz = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.spin = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.radius = (float *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(float));
+	grown.render = (Uint32 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint32));
+	grown.handle = (Uint32 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint32));
+	grown.model = (CGE_M4 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(CGE_M4));
+	grown.dense = (Uint32 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint32));
+	grown.generation = (Uint16 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint16));
+	grown.capacity = capacity;
+
+	if(entities->capacity > 0)
+	{
+		memcpy(grown.x, entities->x, entities->count * sizeof(float));
+		memcpy(grown.y, entities->y, entities->count * sizeof(float));
+		memcpy(grown.z, entities->z, entities->count * sizeof(float));
+		memcpy(grown.yaw, entities->yaw, entities->count * sizeof(float));
+		memcpy(grown.vx, entities->vx, entities->count * sizeof(float));
+		memcpy(grown.vy, entities->vy, entities->count * sizeof(float));
+		memcpy(grown.vz, entities->vz, entities->count * sizeof(float));
+		memcpy(grown.spin, entities->spin, entities->count * sizeof(float));
+		memcpy(grown.radius, entities->radius, entities->count * sizeof(float));
+		memcpy(grown.render, entities->render, entities->count * sizeof(Uint32));
+		memcpy(grown.handle, entities->handle, entities->count * sizeof(Uint32));
+		memcpy(grown.dense, entities->dense, entities->slots * sizeof(Uint32));
+		memcpy(grown.generation, entities->generation, entities->slots * sizeof(Uint16));
+	}
+
+	CGE_ArenaFree(&entities->arena);
+	*entities = grown;
+
+	return CGE_OK;
+}
+
+/* Velocity in units and spin in degrees per second, render is the index of */
+/* the scene mesh drawn at the entity or CGE_ENTITY_NONE */
+Uint32 CGE_EntityCreate(CGE_Entities *entities, CGE_V3 position, CGE_V3 velocity, float radius, Uint32 render)
+{
+	Uint32 capacity;
+	Uint32 slot;
+	Uint32 i;
+
+	if(entities->slotFree != CGE_ENTITY_NONE)
+	{
+		slot = entities->slotFree;
+		entities->slotFree = entities->dense[slot];
+	}
+	else
+	{
+		if(entities->slots == entities->capacity)
+		{
+			capacity = entities->capacity == 0 ? 1024 : entities->capacity * 2;
+			capacity = capacity > CGE_ENTITY_SLOT_MASK ? CGE_ENTITY_SLOT_MASK : capacity;
+			if(CGE_EntitiesGrow(entities, capacity) == CGE_ERR)
+			{
+				return CGE_ENTITY_NONE;
+			}
+		}
+		slot = entities->slots++;
+		entities->generation[slot] = 0;
+	}
+
+	i = entities->count++;
+	entities->x[i] = position.x;
+	entities->y[i] = position.y;
+	entities->z[i] = position.z;
+	entities->yaw[i] = 0.0f;
+	entities->vx[i] = velocity.x;
+	entities->vy[i] = velocity.y;
+	entities->vz[i] = velocity.z;
+	entities->spin[i] = 0.0f;
+	entities->radius[i] = radius;
+	entities->render[i] = render;
+	entities->handle[i] = ((Uint32)entities->generation[slot] << CGE_ENTITY_SLOT_BITS) | slot;
+	entities->dense[slot] = i;
+
+	return entities->handle[i];
+}
+
+CGE_EXITCODE CGE_EntityDestroy(CGE_Entities *entities, Uint32 handle)
+{
+	Uint32 slot;
+	Uint32 last;
+	Uint32 i;
+
+	i = CGE_EntityIndex(entities, handle);
+	if(i == CGE_ENTITY_NONE)
+	{
+		return CGE_ERR;
+	}
+
+	/* The last entity fills the hole so the arrays stay dense */
+	last = --entities->count;
+	if(i != last)
+	{
+		entities->x[i] = entities->x[last];
+		entities->y[i] = entities->y[last];
+		entities->z[i] = entities->z[last];
+		entities->yaw[i] = entities->yaw[last];
+		entities->vx[i] = entities->vx[last];
+		entities->vy[i] = entities->vy[last];
+		entities->vz[i] = entities->vz[last];
+		entities->spin[i] = entities->spin[last];
+		entities->radius[i] = entities->radius[last];
+		entities->render[i] = entities->render[last];
+		entities->handle[i] = entities->handle[last];
+		entities->model[i] = entities->model[last];
+		entities->dense[entities->handle[i] & CGE_ENTITY_SLOT_MASK] = i;
+	}
+
+	slot = handle & CGE_ENTITY_SLOT_MASK;
+	entities->generation[slot] = (Uint16)((entities->generation[slot] + 1) & CGE_ENTITY_GENERATION_MASK);
+	entities->dense[slot] = entities->slotFree;
+	entities->slotFree = slot;
+
+	return CGE_OK;
+}
+
+/* Dense index of a live entity, CGE_ENTITY_NONE for a stale handle */
+Uint32 CGE_EntityIndex(const CGE_Entities *entities, Uint32 handle)
+{
+	Uint32 slot;
+	Uint32 i;
+
+	slot = handle & CGE_ENTITY_SLOT_MASK;
+	if(slot >= entities->slots)
+	{
+		return CGE_ENTITY_NONE;
+	}
+
+	i = entities->dense[slot];
+	if(i >= entities->count || entities->handle[i] != handle)
+	{
+		return CGE_ENTITY_NONE;
+	}
+
+	return i;
+}
+
+/* One straight loop per component, nothing in them stops the compiler */
+/* from vectorizing when optimizing */
+CGE_EXITCODE CGE_EntitiesIntegrate(CGE_Entities *entities, float t)
+{
+	float *position;
+	const float *velocity;
+	Uint32 count;
+	Uint32 i;
+
+	count = entities->count;
+
+	position = entities->x;
+	velocity = entities->vx;
+	for(i = 0; i < count; i++)
+	{
+		position[i] += velocity[i] * t;
+	}
+
+	position = entities->y;
+	velocity = entities->vy;
+	for(i = 0; i < count; i++)
+	{
+		position[i] += velocity[i] * t;
+	}
+
+	position = entities->z;
+	velocity = entities->vz;
+	for(i = 0; i < count; i++)
+	{
+		position[i] += velocity[i] * t;
+	}
+
+	position = entities->yaw;
+	velocity = entities->spin;
+	for(i = 0; i < count; i++)
+	{
+		position[i] += velocity[i] * t;
+	}
+
+	return CGE_OK;
+}
+
+/* Entities leaving the box turn back towards it */
+CGE_EXITCODE CGE_EntitiesConfine(CGE_Entities *entities, CGE_V3 min, CGE_V3 max)
+{
+	const float *position;
+	float *velocity;
+	float lo;
+	float hi;
+	float v;
+	Uint32 count;
+	Uint32 i;
+	int axis;
+
+	count = entities->count;
+	for(axis = 0; axis < 3; axis++)
+	{
+		position = axis == 0 ? entities->x : (axis == 1 ? entities->y : entities->z);
+		velocity = axis == 0 ? entities->vx : (axis == 1 ? entities->vy : entities->vz);
+		lo = CGE_V3Axis(min, axis);
+		hi = CGE_V3Axis(max, axis);
+		for(i = 0; i < count; i++)
+		{
+			v = velocity[i] < 0.0f ? -velocity[i] : velocity[i];
+			velocity[i] = position[i] < lo ? v : (position[i] > hi ? -v : velocity[i]);
+		}
+	}
+
+	return CGE_OK;
+}
+
+/* Culling writes the models of the visible entities, recording stays in */
+/* entity order */
+CGE_EXITCODE CGE_CommandEntities(CGE_Engine *engine, CGE_CommandBuffer *buffer, CGE_Entities *entities, const CGE_MeshFile *scene, Uint8 state)
+{
+	CGE_JobCounter counter;
+	CGE_EntityJob job;
+	Uint32 i;
+
+	job.engine = engine;
+	job.entities = entities;
+	job.scene = scene;
+	job.visible = (Uint8 *)CGE_FrameAlloc(engine, entities->count);
+	if(job.visible == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	counter.value = 0;
+	CGE_JobsFor(&engine->jobs, "entities", CGE_EntityCullJob, &job, entities->count, 256, &counter);
+	CGE_JobsWait(&engine->jobs, &counter);
+
+	for(i = 0; i < entities->count; i++)
+	{
+		if(job.visible[i] == 1)
+		{
+			CGE_CommandMeshVisible(engine, buffer, &scene->mesh[entities->render[i]], &entities->model[i], state);
+		}
+		else if(entities->render[i] < scene->meshes)
+		{
+			buffer->linesCulled += scene->mesh[entities->render[i]].indices / 2;
+		}
+	}
+
+	return CGE_OK;
+}
+
+void CGE_EntityCullJob(void *data, Uint32 first, Uint32 count)
+{
+	CGE_EntityJob *job;
+	CGE_Entities *entities;
+	CGE_M4 *model;
+	CGE_V3 r;
+	float angle;
+	Uint32 i;
+
+	job = (CGE_EntityJob *)data;
+	entities = job->entities;
+	for(i = first; i < first + count; i++)
+	{
+		job->visible[i] = 0;
+		if(entities->render[i] >= job->scene->meshes)
+		{
+			continue;
+		}
+
+		r = CGE_V3New(entities->radius[i], entities->radius[i], entities->radius[i]);
+		if(CGE_BoundsVisible(job->engine, CGE_V3New(entities->x[i] - r.x, entities->y[i] - r.y, entities->z[i] - r.z),
+			CGE_V3New(entities->x[i] + r.x, entities->y[i] + r.y, entities->z[i] + r.z)) == 0)
+		{
+			continue;
+		}
+
+		/* Translation * rotation around y */
+		angle = CGE_DegToRad(entities->yaw[i]);
+		model = &entities->model[i];
+		*model = CGE_M4Identity();
+		model->m11 = cos(angle);
+		model->m13 = sin(angle);
+		model->m31 = -model->m13;
+		model->m33 = model->m11;
+		model->m14 = entities->x[i];
+		model->m24 = entities->y[i];
+		model->m34 = entities->z[i];
+		job->visible[i] = 1;
+	}
+}
+
+/* Entities wandering over the ground, each showing one of the scene meshes */
+CGE_EXITCODE CGE_EntitiesScatter(CGE_Engine *engine, Uint32 count)
+{
+	CGE_Entities *entities;
+	const CGE_Mesh *mesh;
+	CGE_V3 position;
+	CGE_V3 velocity;
+	CGE_V3 corner;
+	float radius;
+	Uint32 render;
+	Uint32 handle;
+	Uint32 seed;
+	Uint32 i;
+
+	entities = &engine->entities;
+	CGE_EntitiesFree(entities);
+	if(count > CGE_ENTITY_SLOT_MASK || CGE_EntitiesGrow(entities, count) == CGE_ERR)
+	{
+		return CGE_ERR;
+	}
+
+	seed = 11;
+	for(i = 0; i < count; i++)
+	{
+		seed = seed * 1664525 + 1013904223;
+		position.x = (float)(seed >> 16) / 65535.0f * 2.0f * CGE_ENTITIES_AREA - CGE_ENTITIES_AREA;
+		seed = seed * 1664525 + 1013904223;
+		position.z = (float)(seed >> 16) / 65535.0f * 2.0f * CGE_ENTITIES_AREA - CGE_ENTITIES_AREA;
+		seed = seed * 1664525 + 1013904223;
+		position.y = (float)(seed >> 16) / 65535.0f * CGE_ENTITIES_AREA * 0.25f;
+		seed = seed * 1664525 + 1013904223;
+		velocity.x = (float)(seed >> 16) / 65535.0f * 20.0f - 10.0f;
+		seed = seed * 1664525 + 1013904223;
+		velocity.z = (float)(seed >> 16) / 65535.0f * 20.0f - 10.0f;
+		seed = seed * 1664525 + 1013904223;
+		velocity.y = (float)(seed >> 16) / 65535.0f * 4.0f - 2.0f;
+
+		/* Sphere around the mesh origin, it holds the mesh however it turns */
+		render = CGE_ENTITY_NONE;
+		radius = 1.0f;
+		if(engine->scene.meshes > 0)
+		{
+			render = i % engine->scene.meshes;
+			mesh = &engine->scene.mesh[render];
+			corner.x = fabs(mesh->min.x) > fabs(mesh->max.x) ? fabs(mesh->min.x) : fabs(mesh->max.x);
+			corner.y = fabs(mesh->min.y) > fabs(mesh->max.y) ? fabs(mesh->min.y) : fabs(mesh->max.y);
+			corner.z = fabs(mesh->min.z) > fabs(mesh->max.z) ? fabs(mesh->min.z) : fabs(mesh->max.z);
+			radius = CGE_V3Length(corner);
+		}
+
+		handle = CGE_EntityCreate(entities, position, velocity, radius, render);
+		if(handle == CGE_ENTITY_NONE)
+		{
+			return CGE_ERR;
+		}
+		entities->spin[CGE_EntityIndex(entities, handle)] = (float)((i * 37) % 181) - 90.0f;
+	}
+
+	return CGE_OK;
+}
+
+/* Hierarchy functions implementations */
+
+CGE_EXITCODE CGE_HierarchyNew(CGE_Hierarchy *hierarchy)
+{
+	memset(hierarchy, 0, sizeof(CGE_Hierarchy));
+	hierarchy->first = CGE_NODE_NONE;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_HierarchyFree(CGE_Hierarchy *hierarchy)
+{
+	CGE_ArenaFree(&hierarchy->arena);
+
+	return CGE_HierarchyNew(hierarchy);
+}
+
+CGE_EXITCODE CGE_HierarchyGrow(CGE_Hierarchy *hierarchy, Uint32 capacity)
+{
+	CGE_Hierarchy grown;
+	size_t size;
+
+	if(capacity <= hierarchy->capacity)
+	{
+		return CGE_ERR;
+	}
+
+	grown = *hierarchy;
+	size = (size_t)capacity * (3 * sizeof(Uint32) + 2 * sizeof(CGE_M4) + 4 * sizeof(CGE_V3) + sizeof(Uint8)) + 10 * CGE_ARENA_ALIGN;
+	if(CGE_ArenaNew(&grown.arena, size) == CGE_ERR)
+	{
+		return CGE_ERR;
+	}
+
+	grown.parent = (Uint32 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint32));
+	grown.local = (CGE_M4 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(CGE_M4));
+	grown.world = (CGE_M4 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(CGE_M4));
+	grown.min = (CGE_V3 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(CGE_V3));
+	grown.max = (CGE_V3 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(CGE_V3));
+	grown.worldMin = (CGE_V3 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(CGE_V3));
+	grown.worldMax = (CGE_V3 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(CGE_V3));
+	grown.dirty = (Uint8 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint8));
+	grown.stamp = (Uint32 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint32));
+	grown.changed = (Uint32 *)CGE_ArenaAlloc(&grown.arena, capacity * sizeof(Uint32));
+	grown.capacity = capacity;
+
+	if(hierarchy->capacity > 0)
+	{
+		memcpy(grown.parent, hierarchy->parent, hierarchy->nodes * sizeof(Uint32));
+		memcpy(grown.local, hierarchy->local, hierarchy->nodes * sizeof(CGE_M4));
+		memcpy(grown.world, hierarchy->world, hierarchy->nodes * sizeof(CGE_M4));
+		memcpy(grown.min, hierarchy->min, hierarchy->nodes * sizeof(CGE_V3));
+		memcpy(grown.max, hierarchy->max, hierarchy->nodes * sizeof(CGE_V3));
+		memcpy(grown.worldMin, hierarchy->worldMin, hierarchy->nodes * sizeof(CGE_V3));
+		memcpy(grown.worldMax, hierarchy->worldMax, hierarchy->nodes * sizeof(CGE_V3));
+		memcpy(grown.dirty, hierarchy->dirty, hierarchy->nodes * sizeof(Uint8));
+		memcpy(grown.stamp, hierarchy->stamp, hierarchy->nodes * sizeof(Uint32));
+		memcpy(grown.changed, hierarchy->changed, hierarchy->changes * sizeof(Uint32));
+	}
+
+	CGE_ArenaFree(&hierarchy->arena);
+	*hierarchy = grown;
+
+	return CGE_OK;
+}
+
+/* Nodes are appended, so a parent must already be there. Bounds are in */
+/* the node's space */
+Uint32 CGE_HierarchyAdd(CGE_Hierarchy *hierarchy, Uint32 parent, CGE_M4 local, CGE_V3 min, CGE_V3 max)
+{
+	Uint32 node;
+
+	if(parent != CGE_NODE_NONE && parent >= hierarchy->nodes)
+	{
+		return CGE_NODE_NONE;
+	}
+
+	if(hierarchy->nodes == hierarchy->capacity)
+	{
+		if(CGE_HierarchyGrow(hierarchy, hierarchy->capacity == 0 ? 1024 : hierarchy->capacity * 2) == CGE_ERR)
+		{
+			return CGE_NODE_NONE;
+		}
+	}
+
+	node = hierarchy->nodes++;
+	hierarchy->parent[node] = parent;
+	hierarchy->local[node] = local;
+	hierarchy->min[node] = min;
+	hierarchy->max[node] = max;
+	hierarchy->dirty[node] = 1;
+	hierarchy->stamp[node] = 0;
+	if(node < hierarchy->first)
+	{
+		hierarchy->first = node;
+	}
+
+	return node;
+}
+
+CGE_EXITCODE CGE_HierarchySetLocal(CGE_Hierarchy *hierarchy, Uint32 node, CGE_M4 local)
+{
+	if(node >= hierarchy->nodes)
+	{
+		return CGE_ERR;
+	}
+
+	hierarchy->local[node] = local;
+	hierarchy->dirty[node] = 1;
+	if(node < hierarchy->first)
+	{
+		hierarchy->first = node;
+	}
+
+	return CGE_OK;
+}
+
+/* Nothing before the first dirty node can change, and nothing at all when */
+/* no node is dirty */
+CGE_EXITCODE CGE_HierarchyUpdate(CGE_Hierarchy *hierarchy)
+{
+	Uint32 parent;
+	Uint32 i;
+
+	hierarchy->changes = 0;
+	if(hierarchy->first == CGE_NODE_NONE)
+	{
+		return CGE_OK;
+	}
+
+	hierarchy->update++;
+	for(i = hierarchy->first; i < hierarchy->nodes; i++)
+	{
+		parent = hierarchy->parent[i];
+		if(hierarchy->dirty[i] == 0 && (parent == CGE_NODE_NONE || hierarchy->stamp[parent] != hierarchy->update))
+		{
+			continue;
+		}
+
+		if(parent == CGE_NODE_NONE)
+		{
+			hierarchy->world[i] = hierarchy->local[i];
+		}
+		else
+		{
+			hierarchy->world[i] = CGE_M4M4Mul(hierarchy->world[parent], hierarchy->local[i]);
+		}
+		CGE_BoundsTransform(hierarchy->world[i], hierarchy->min[i], hierarchy->max[i], &hierarchy->worldMin[i], &hierarchy->worldMax[i]);
+		hierarchy->dirty[i] = 0;
+		hierarchy->stamp[i] = hierarchy->update;
+		hierarchy->changed[hierarchy->changes++] = i;
+	}
+	hierarchy->first = CGE_NODE_NONE;
+
+	return CGE_OK;
+}
+
+/* A binary tree standing on the grid, every bone up its node's y axis and */
+/* shorter than its parent's. A few subtrees deep in the tree turn */
+CGE_EXITCODE CGE_RigNew(CGE_Engine *engine, Uint32 nodes, int collide)
+{
+	CGE_EngineRig *rig;
+	CGE_M4 local;
+	CGE_V3 origin;
+	CGE_V3 tip;
+	Uint32 parent;
+	Uint32 depth;
+	Uint32 level;
+	Uint32 levels;
+	Uint32 i;
+
+	CGE_RigFree(engine);
+	rig = &engine->rig;
+
+	rig->length = (float *)malloc(nodes * sizeof(float));
+	rig->collider = (Uint32 *)malloc(nodes * sizeof(Uint32));
+	rig->animated = (Uint32 *)malloc(nodes * sizeof(Uint32));
+	rig->base = (CGE_M4 *)malloc(nodes * sizeof(CGE_M4));
+	if(rig->length == NULL || rig->collider == NULL || rig->animated == NULL || rig->base == NULL
+		|| CGE_HierarchyGrow(&rig->hierarchy, nodes) == CGE_ERR)
+	{
+		CGE_RigFree(engine);
+		return CGE_ERR;
+	}
+
+	levels = 0;
+	while((2u << levels) <= nodes)
+	{
+		levels++;
+	}
+	level = levels >= 5 ? levels - 4 : (levels > 0 ? 1 : 0);
+
+	for(i = 0; i < nodes; i++)
+	{
+		depth = 0;
+		while((2u << depth) <= i + 1)
+		{
+			depth++;
+		}
+		rig->length[i] = 6.0f * pow(0.8f, (double)depth);
+
+		if(i == 0)
+		{
+			parent = CGE_NODE_NONE;
+			local = CGE_M4Translate(0.0f, -10.0f, 0.0f);
+		}
+		else
+		{
+			parent = (i - 1) / 2;
+			local = CGE_M4M4Mul(CGE_M4Translate(0.0f, rig->length[parent], 0.0f),
+				CGE_M4M4Mul(CGE_M4Rotate((float)((i * 137) % 360), 0.0f, 1.0f, 0.0f),
+				CGE_M4Rotate(i % 2 == 0 ? 30.0f : -30.0f, 0.0f, 0.0f, 1.0f)));
+		}
+
+		CGE_HierarchyAdd(&rig->hierarchy, parent, local, CGE_V3New(0.0f, 0.0f, 0.0f), CGE_V3New(0.0f, rig->length[i], 0.0f));
+		if(depth == level && i % 13 == 0)
+		{
+			rig->animated[rig->count] = i;
+			rig->base[rig->count] = local;
+			rig->count++;
+		}
+	}
+
+	CGE_HierarchyUpdate(&rig->hierarchy);
+	for(i = 0; i < nodes; i++)
+	{
+		rig->collider[i] = CGE_HASH_NONE;
+		if(collide == 1)
+		{
+			CGE_RigBone(engine, i, &origin, &tip);
+			rig->collider[i] = CGE_HashInsert(&engine->collision, CGE_COLLIDER_SEGMENT, origin, tip, CGE_V3New(0.0f, 0.0f, 0.0f));
+		}
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_RigFree(CGE_Engine *engine)
+{
+	CGE_EngineRig *rig;
+	Uint32 i;
+
+	rig = &engine->rig;
+	if(rig->collider != NULL)
+	{
+		for(i = 0; i < rig->hierarchy.nodes; i++)
+		{
+			if(rig->collider[i] != CGE_HASH_NONE)
+			{
+				CGE_HashRemove(&engine->collision, rig->collider[i]);
+			}
+		}
+	}
+
+	CGE_HierarchyFree(&rig->hierarchy);
+	free(rig->length);
+	free(rig->collider);
+	free(rig->animated);
+	free(rig->base);
+	rig->length = NULL;
+	rig->collider = NULL;
+	rig->animated = NULL;
+	rig->base = NULL;
+	rig->count = 0;
+	rig->phase = 0.0f;
+
+	return CGE_OK;
+}
+
+/* Only the bones of the turning subtrees move in the collision hash */
+CGE_EXITCODE CGE_RigAnimate(CGE_Engine *engine, float t)
+{
+	CGE_EngineRig *rig;
+	CGE_Hierarchy *hierarchy;
+	CGE_V3 origin;
+	CGE_V3 tip;
+	Uint32 node;
+	Uint32 i;
+
+	rig = &engine->rig;
+	hierarchy = &rig->hierarchy;
+
+	rig->phase += t * 45.0f;
+	if(rig->phase > 360.0f)
+	{
+		rig->phase -= 360.0f;
+	}
+	for(i = 0; i < rig->count; i++)
+	{
+		CGE_HierarchySetLocal(hierarchy, rig->animated[i], CGE_M4M4Mul(rig->base[i], CGE_M4Rotate(rig->phase, 0.0f, 1.0f, 0.0f)));
+	}
+
+	CGE_HierarchyUpdate(hierarchy);
+	for(i = 0; i < hierarchy->changes; i++)
+	{
+		node = hierarchy->changed[i];
+		if(rig->collider[node] != CGE_HASH_NONE)
+		{
+			CGE_RigBone(engine, node, &origin, &tip);
+			CGE_HashUpdate(&engine->collision, rig->collider[node], origin, tip, CGE_V3New(0.0f, 0.0f, 0.0f));
+		}
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_RigBone(CGE_Engine *engine, Uint32 node, CGE_V3 *origin, CGE_V3 *tip)
+{
+	const CGE_M4 *world;
+	float length;
+
+	world = &engine->rig.hierarchy.world[node];
+	length = engine->rig.length[node];
+	*origin = CGE_V3New(world->m14, world->m24, world->m34);
+	*tip = CGE_V3New(world->m14 + world->m12 * length, world->m24 + world->m22 * length, world->m34 + world->m32 * length);
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_CommandRig(CGE_Engine *engine, CGE_CommandBuffer *buffer, Uint8 state)
+{
+	CGE_Hierarchy *hierarchy;
+	CGE_V3 origin;
+	CGE_V3 tip;
+	Uint32 i;
+
+	hierarchy = &engine->rig.hierarchy;
+	for(i = 0; i < hierarchy->nodes; i++)
+	{
+		if(CGE_BoundsVisible(engine, hierarchy->worldMin[i], hierarchy->worldMax[i]) == 0)
+		{
+			buffer->linesCulled++;
+			continue;
+		}
+		CGE_RigBone(engine, i, &origin, &tip);
+		CGE_CommandLine(engine, buffer, CGE_LineNew(CGE_PointNew(origin.x, origin.y, origin.z, 160, 110, 60),
+			CGE_PointNew(tip.x, tip.y, tip.z, 120, 200, 80)), state);
+	}
+
+	return CGE_OK;
+}
+
+/* World functions implementations */
+
+CGE_EXITCODE CGE_WorldNew(CGE_World *world)
+{
+	memset(world, 0, sizeof(CGE_World));
+	world->radius = CGE_WORLD_RADIUS;
+
+	return CGE_OK;
+}
+
+/* One chunk per line of the index: min x y z, max x y z, then its mesh */
+/* file relative to the index. budget is in megabytes */
+CGE_EXITCODE CGE_WorldOpen(CGE_World *world, const char *path, Uint32 budget)
+{
+	FILE *file;
+	CGE_WorldChunk *chunk;
+	struct stat info;
+	char line[1024];
+	char name[512];
+	CGE_V3 min;
+	CGE_V3 max;
+	Uint32 capacity;
+	size_t directory;
+	void *grown;
+	int i;
+
+	CGE_WorldClose(world);
+
+	file = fopen(path, "r");
+	if(file == NULL)
+	{
+		perror(path);
+		return CGE_ERR;
+	}
+	directory = strrchr(path, '/') != NULL ? (size_t)(strrchr(path, '/') - path) + 1 : 0;
+
+	capacity = 0;
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		if(line[0] == '#' || sscanf(line, "%f %f %f %f %f %f %511s", &min.x, &min.y, &min.z, &max.x, &max.y, &max.z, name) != 7)
+		{
+			continue;
+		}
+
+		if(world->chunks == capacity)
+		{
+			capacity = capacity == 0 ? 64 : capacity * 2;
+			grown = realloc(world->chunk, capacity * sizeof(CGE_WorldChunk));
+			if(grown == NULL)
+			{
+				fclose(file);
+				CGE_WorldClose(world);
+				return CGE_ERR;
+			}
+			world->chunk = (CGE_WorldChunk *)grown;
+		}
+
+		chunk = &world->chunk[world->chunks];
+		chunk->path = (char *)malloc(directory + strlen(name) + 1);
+		if(chunk->path == NULL)
+		{
+			fclose(file);
+			CGE_WorldClose(world);
+			return CGE_ERR;
+		}
+		memcpy(chunk->path, path, directory);
+		strcpy(chunk->path + directory, name);
+		chunk->min = min;
+		chunk->max = max;
+		chunk->state = CGE_CHUNKSTATE_EMPTY;
+		chunk->file.map = NULL;
+		chunk->file.size = 0;
+		chunk->file.meshes = 0;
+		chunk->file.mesh = NULL;
+		chunk->bytes = stat(chunk->path, &info) == 0 ? (Uint32)info.st_size : 0;
+		chunk->retry = 0;
+		chunk->failures = 0;
+		chunk->distance = 0.0f;
+		world->chunks++;
+	}
+	fclose(file);
+
+	world->queue = (Uint32 *)malloc((world->chunks + 1) * sizeof(Uint32));
+	world->lock = SDL_CreateMutex();
+	world->wake = SDL_CreateSemaphore(0);
+	if(world->chunks == 0 || world->queue == NULL || world->lock == NULL || world->wake == NULL)
+	{
+		CGE_WorldClose(world);
+		return CGE_ERR;
+	}
+
+	world->budget = budget > 4095 ? 0xFFFFFFFF : budget * 1024 * 1024;
+	world->running = 1;
+	for(i = 0; i < CGE_WORLD_THREADS; i++)
+	{
+		world->thread[i] = SDL_CreateThread(CGE_WorldThread, world);
+		if(world->thread[i] == NULL)
+		{
+			break;
+		}
+		world->threads++;
+	}
+	if(world->threads == 0)
+	{
+		CGE_WorldClose(world);
+		return CGE_ERR;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_WorldClose(CGE_World *world)
+{
+	Uint32 i;
+	int t;
+
+	world->running = 0;
+	CGE_AtomicFence();
+	for(t = 0; t < world->threads; t++)
+	{
+		SDL_SemPost(world->wake);
+	}
+	for(t = 0; t < world->threads; t++)
+	{
+		SDL_WaitThread(world->thread[t], NULL);
+	}
+
+	for(i = 0; i < world->chunks; i++)
+	{
+		CGE_MeshFileClose(&world->chunk[i].file);
+		free(world->chunk[i].path);
+	}
+	if(world->wake != NULL)
+	{
+		SDL_DestroySemaphore(world->wake);
+	}
+	if(world->lock != NULL)
+	{
+		SDL_DestroyMutex(world->lock);
+	}
+	free(world->queue);
+	free(world->chunk);
+
+	return CGE_WorldNew(world);
+}
+
+/* Hands a queued or retired chunk to the I/O threads */
+CGE_EXITCODE CGE_WorldPush(CGE_World *world, Uint32 chunk)
+{
+	SDL_mutexP(world->lock);
+	world->queue[world->tail] = chunk;
+	world->tail = (world->tail + 1) % (world->chunks + 1);
+	SDL_mutexV(world->lock);
+	SDL_SemPost(world->wake);
+
+	return CGE_OK;
+}
+
+/* Loads queued chunks and closes retired ones. A chunk is mapped and read */
+/* through once while checking it, so drawing it takes no page faults */
+int CGE_WorldThread(void *data)
+{
+	CGE_World *world;
+	CGE_WorldChunk *chunk;
+	SDL_Event e;
+	Uint32 state;
+
+	world = (CGE_World *)data;
+	while(1)
+	{
+		SDL_SemWait(world->wake);
+		if(world->running == 0)
+		{
+			break;
+		}
+
+		SDL_mutexP(world->lock);
+		if(world->head == world->tail)
+		{
+			SDL_mutexV(world->lock);
+			continue;
+		}
+		chunk = &world->chunk[world->queue[world->head]];
+		world->head = (world->head + 1) % (world->chunks + 1);
+		SDL_mutexV(world->lock);
+
+		CGE_AtomicFence();
+		if(chunk->state == CGE_CHUNKSTATE_RETIRED)
+		{
+			CGE_MeshFileClose(&chunk->file);
+			CGE_AtomicCas(&chunk->state, CGE_CHUNKSTATE_RETIRED, CGE_CHUNKSTATE_EMPTY);
+			continue;
+		}
+
+		/* A missing or broken file is tried again later, waiting twice */
+		/* as long each time up to a minute */
+		state = CGE_MeshFileOpen(&chunk->file, chunk->path, 1) == CGE_OK ? CGE_CHUNKSTATE_READY : CGE_CHUNKSTATE_FAILED;
+		if(state == CGE_CHUNKSTATE_FAILED)
+		{
+			chunk->retry = SDL_GetTicks() + (CGE_WORLD_RETRY << (chunk->failures < 6 ? chunk->failures : 6));
+			chunk->failures++;
+		}
+		else
+		{
+			chunk->failures = 0;
+		}
+		CGE_AtomicCas(&chunk->state, CGE_CHUNKSTATE_QUEUED, state);
+		CGE_AtomicAdd(&world->published, 1);
+
+		/* Wakes an idle engine to show it */
+		e.type = SDL_USEREVENT;
+		SDL_PushEvent(&e);
+	}
+
+	return 0;
+}
+
+/* Distance from a point to a box, 0 inside */
+float CGE_BoundsDistance(CGE_V3 p, CGE_V3 min, CGE_V3 max)
+{
+	CGE_V3 d;
+
+	d.x = p.x < min.x ? min.x - p.x : (p.x > max.x ? p.x - max.x : 0.0f);
+	d.y = p.y < min.y ? min.y - p.y : (p.y > max.y ? p.y - max.y : 0.0f);
+	d.z = p.z < min.z ? min.z - p.z : (p.z > max.z ? p.z - max.z : 0.0f);
+
+	return CGE_V3Length(d);
+}
+
+/* Ranks the chunks by their distance to the path the camera takes over */
+/* the next CGE_WORLD_LOOKAHEAD milliseconds, queues the nearest missing */
+/* ones within the radius and retires the farthest over the budget. Only */
+/* states are changed here, the files are opened and closed elsewhere */
+CGE_EXITCODE CGE_WorldUpdate(CGE_Engine *engine, CGE_World *world)
+{
+	CGE_WorldChunk *chunk;
+	CGE_V3 position;
+	CGE_V3 ahead;
+	CGE_V3 center;
+	CGE_V3 nearest;
+	float along;
+	float length;
+	Uint32 elapsed;
+	Uint32 now;
+	Uint32 inflight;
+	Uint32 candidate;
+	Uint32 farthest;
+	Uint32 i;
+	int fits;
+
+	position = engine->camera.position;
+	elapsed = engine->states.timers.elapsed > 0 ? engine->states.timers.elapsed : 1;
+	ahead = CGE_V3ScalarMul(CGE_V3V3Sub(position, world->last), CGE_WORLD_LOOKAHEAD / elapsed);
+	world->ahead = CGE_V3V3Add(CGE_V3ScalarMul(world->ahead, 0.9f), CGE_V3ScalarMul(ahead, 0.1f));
+	world->last = position;
+	length = CGE_V3V3Mul(world->ahead, world->ahead);
+
+	if(world->published != world->seen)
+	{
+		world->seen = world->published;
+		CGE_Invalidate(engine);
+	}
+
+	CGE_AtomicFence();
+	now = SDL_GetTicks();
+	inflight = 0;
+	world->resident = 0;
+	for(i = 0; i < world->chunks; i++)
+	{
+		chunk = &world->chunk[i];
+		center = CGE_V3ScalarMul(CGE_V3V3Add(chunk->min, chunk->max), 0.5f);
+		along = length > 0.0f ? CGE_V3V3Mul(CGE_V3V3Sub(center, position), world->ahead) / length : 0.0f;
+		along = along < 0.0f ? 0.0f : (along > 1.0f ? 1.0f : along);
+		nearest = CGE_V3V3Add(position, CGE_V3ScalarMul(world->ahead, along));
+		chunk->distance = CGE_BoundsDistance(nearest, chunk->min, chunk->max);
+
+		/* Chunks in flight already count against the budget */
+		if(chunk->state == CGE_CHUNKSTATE_QUEUED)
+		{
+			inflight++;
+			world->resident += chunk->bytes;
+		}
+		else if(chunk->state == CGE_CHUNKSTATE_READY)
+		{
+			world->resident += chunk->bytes;
+		}
+		else if(chunk->state == CGE_CHUNKSTATE_FAILED && (Sint32)(now - chunk->retry) >= 0)
+		{
+			chunk->state = CGE_CHUNKSTATE_EMPTY;
+		}
+	}
+
+	while(1)
+	{
+		candidate = CGE_NODE_NONE;
+		farthest = CGE_NODE_NONE;
+		for(i = 0; i < world->chunks; i++)
+		{
+			chunk = &world->chunk[i];
+			if(chunk->state == CGE_CHUNKSTATE_EMPTY && chunk->distance < world->radius && chunk->bytes <= world->budget
+			&& (candidate == CGE_NODE_NONE || chunk->distance < world->chunk[candidate].distance))
+			{
+				candidate = i;
+			}
+			if(chunk->state == CGE_CHUNKSTATE_READY
+			&& (farthest == CGE_NODE_NONE || chunk->distance > world->chunk[farthest].distance))
+			{
+				farthest = i;
+			}
+		}
+
+		/* Over the budget the farthest goes, and so it does to make room */
+		/* for a nearer one. Loaded chunks are never swapped for farther */
+		/* ones, so the set settles while the camera stands still. A chunk */
+		/* bigger than the whole budget is never loaded */
+		fits = candidate != CGE_NODE_NONE && world->resident + world->chunk[candidate].bytes <= world->budget;
+		if(farthest != CGE_NODE_NONE && (world->resident > world->budget
+		|| (candidate != CGE_NODE_NONE && fits == 0 && world->chunk[farthest].distance > world->chunk[candidate].distance)))
+		{
+			world->resident -= world->chunk[farthest].bytes;
+			world->chunk[farthest].state = CGE_CHUNKSTATE_RETIRED;
+			CGE_WorldPush(world, farthest);
+			continue;
+		}
+		if(candidate == CGE_NODE_NONE || inflight >= CGE_WORLD_INFLIGHT || fits == 0)
+		{
+			break;
+		}
+
+		world->resident += world->chunk[candidate].bytes;
+		world->chunk[candidate].state = CGE_CHUNKSTATE_QUEUED;
+		CGE_WorldPush(world, candidate);
+		inflight++;
+	}
+
+	return CGE_OK;
+}
+
+/* Loaded chunks draw their meshes, the missing ones within the radius */
+/* their box until they arrive */
+CGE_EXITCODE CGE_CommandWorld(CGE_Engine *engine, CGE_CommandBuffer *buffer, CGE_World *world, Uint8 state)
+{
+	CGE_WorldChunk *chunk;
+	CGE_Point corner[8];
+	Uint32 i;
+	Uint32 j;
+	int k;
+
+	CGE_AtomicFence();
+	for(i = 0; i < world->chunks; i++)
+	{
+		chunk = &world->chunk[i];
+		if(CGE_BoundsVisible(engine, chunk->min, chunk->max) == 0)
+		{
+			continue;
+		}
+
+		if(chunk->state == CGE_CHUNKSTATE_READY)
+		{
+			for(j = 0; j < chunk->file.meshes; j++)
+			{
+				if(CGE_BoundsVisible(engine, chunk->file.mesh[j].min, chunk->file.mesh[j].max) == 1)
+				{
+					CGE_CommandMeshVisible(engine, buffer, &chunk->file.mesh[j], NULL, state);
+				}
+				else
+				{
+					buffer->linesCulled += chunk->file.mesh[j].indices / 2;
+				}
 			}
-			break;
-		case SDL_KEYUP:
-			switch (e.key.keysym.sym)
+			continue;
+		}
+		if(chunk->distance >= world->radius)
+		{
+			continue;
+		}
+
+		for(k = 0; k < 8; k++)
+		{
+			corner[k] = CGE_PointNew((k & 1) ? chunk->max.x : chunk->min.x, (k & 2) ? chunk->max.y : chunk->min.y,
+				(k & 4) ? chunk->max.z : chunk->min.z, 70, 70, 90);
+		}
+		for(k = 0; k < 8; k++)
+		{
+			if((k & 1) == 0)
 			{
-				case SDLK_ESCAPE:
-					break;
-				case SDLK_LEFT:
-					engine->states.inputs.physicals.CGE_KeyLeft = 0;
-					break;
-				case SDLK_RIGHT:
-					engine->states.inputs.physicals.CGE_KeyRight = 0;
-					break;
-				case SDLK_UP:
-					engine->states.inputs.physicals.CGE_KeyUp = 0;
-					break;
-				case SDLK_DOWN:
-					engine->states.inputs.physicals.CGE_KeyDown = 0;
-					break;
-				case SDLK_a:
-					engine->states.inputs.physicals.CGE_KeyA = 0;
-					break;
-				case SDLK_d:
-					engine->states.inputs.physicals.CGE_KeyD = 0;
-					break;
-				case SDLK_w:
-					engine->states.inputs.physicals.CGE_KeyW = 0;
-					break;
-				case SDLK_s:
-					engine->states.inputs.physicals.CGE_KeyS = 0;
-					break;
-				case SDLK_q:
-					engine->states.inputs.physicals.CGE_KeyQ = 0;
-					break;
-				case SDLK_e:
-					engine->states.inputs.physicals.CGE_KeyE = 0;
-					break;
-				default:
-					break;
+				CGE_CommandLine(engine, buffer, CGE_LineNew(corner[k], corner[k | 1]), state);
 			}
-			break;
-		case SDL_QUIT: 
-			engine->states.status = CGE_ENGINESTATESSTATUS_STOPPED;
-			break;
-		default:
-			break;
+			if((k & 2) == 0)
+			{
+				CGE_CommandLine(engine, buffer, CGE_LineNew(corner[k], corner[k | 2]), state);
+			}
+			if((k & 4) == 0)
+			{
+				CGE_CommandLine(engine, buffer, CGE_LineNew(corner[k], corner[k | 4]), state);
+			}
+		}
 	}
 
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_MapInputsLogicals(CGE_Engine *engine)
+
+/* Memory functions implementations */
+
+CGE_EXITCODE CGE_ArenaNew(CGE_Arena *arena, size_t size)
 {
-	engine->states.inputs.logicals.CGE_Yaw = 0.0f;
-	engine->states.inputs.logicals.CGE_Pitch = 0.0f;
-	engine->states.inputs.logicals.CGE_Roll = 0.0f;
-	engine->states.inputs.logicals.CGE_AxisX = 0.0f;
-	engine->states.inputs.logicals.CGE_AxisY = 0.0f;
-	engine->states.inputs.logicals.CGE_AxisZ = 0.0f;
-	engine->states.inputs.logicals.CGE_Advance = 0.0f;
-	engine->states.inputs.logicals.CGE_Strafe = 0.0f;
-	
+	size_t misalign;
 
-	if(engine->states.inputs.physicals.CGE_KeyLeft == 1)
+	/* Round up to whole cache lines and keep one spare line for the alignment */
+	size = (size + CGE_ARENA_ALIGN - 1) / CGE_ARENA_ALIGN * CGE_ARENA_ALIGN;
+
+	arena->memory = (unsigned char *)malloc(size + CGE_ARENA_ALIGN);
+	if(arena->memory == NULL)
 	{
-		engine->states.inputs.logicals.CGE_Strafe -= 1.0f;
+		arena->base = NULL;
+		arena->size = 0;
+		return CGE_ERR;
 	}
-	if(engine->states.inputs.physicals.CGE_KeyRight == 1)
+
+	misalign = (size_t)arena->memory % CGE_ARENA_ALIGN;
+	arena->base = arena->memory + (misalign == 0 ? 0 : CGE_ARENA_ALIGN - misalign);
+	arena->size = size;
+	arena->used = 0;
+	arena->highWater = 0;
+	arena->overflow = 0;
+
+	return CGE_OK;
+}
+
+void *CGE_ArenaAlloc(CGE_Arena *arena, size_t size)
+{
+	void *newp;
+
+	/* Every allocation starts on its own cache line */
+	size = (size + CGE_ARENA_ALIGN - 1) / CGE_ARENA_ALIGN * CGE_ARENA_ALIGN;
+
+	if(size > arena->size - arena->used)
 	{
-		engine->states.inputs.logicals.CGE_Strafe += 1.0f;
+		/* Remember what would have been needed so the report can tell */
+		arena->overflow += size;
+		if(arena->used + arena->overflow > arena->highWater)
+		{
+			arena->highWater = arena->used + arena->overflow;
+		}
+		return NULL;
 	}
-	if(engine->states.inputs.physicals.CGE_KeyUp == 1)
+
+	newp = arena->base + arena->used;
+	arena->used += size;
+	if(arena->used + arena->overflow > arena->highWater)
 	{
-		engine->states.inputs.logicals.CGE_Advance += 1.0f;
+		arena->highWater = arena->used + arena->overflow;
 	}
-	if(engine->states.inputs.physicals.CGE_KeyDown == 1)
+
+	return newp;
+}
+
+CGE_EXITCODE CGE_ArenaReset(CGE_Arena *arena)
+{
+#ifdef CGE_DEBUG
+	/* Anything still pointing into the last frame reads garbage */
+	memset(arena->base, CGE_ARENA_POISON, arena->used);
+#endif
+
+	arena->used = 0;
+	arena->overflow = 0;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ArenaFree(CGE_Arena *arena)
+{
+	free(arena->memory);
+	arena->memory = NULL;
+	arena->base = NULL;
+	arena->size = 0;
+	arena->used = 0;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_FramesNew(CGE_Engine *engine, size_t size, int buffers)
+{
+	int i;
+
+	/* Two buffers let the data of frame n live while frame n + 1 is built */
+	if(buffers < 1 || buffers > 2)
 	{
-		engine->states.inputs.logicals.CGE_Advance -= 1.0f;
+		return CGE_ERR;
 	}
-	if(engine->states.inputs.physicals.CGE_KeyA == 1)
+
+	engine->frames.buffers = buffers;
+	engine->frames.current = 0;
+	engine->frames.count = 0;
+
+	for(i = 0; i < buffers; i++)
 	{
-		engine->states.inputs.logicals.CGE_Yaw += 1.0f;
+		if(CGE_ArenaNew(&engine->frames.arena[i], size) != CGE_OK)
+		{
+			while(i-- > 0)
+			{
+				CGE_ArenaFree(&engine->frames.arena[i]);
+			}
+			return CGE_ERR;
+		}
 	}
-	if(engine->states.inputs.physicals.CGE_KeyD == 1)
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_FrameBegin(CGE_Engine *engine)
+{
+	CGE_Arena *arena;
+	CGE_Arena grown;
+	size_t needed;
+	int i;
+
+	engine->frames.current = (engine->frames.current + 1) % engine->frames.buffers;
+	engine->frames.count++;
+	arena = &engine->frames.arena[engine->frames.current];
+
+	/* Nothing lives in the arena starting a frame, so it grows here to the */
+	/* most a recent frame asked for, with half again to spare */
+	needed = 0;
+	for(i = 0; i < engine->frames.buffers; i++)
 	{
-		engine->states.inputs.logicals.CGE_Yaw -= 1.0f;
+		if(engine->frames.arena[i].highWater > needed)
+		{
+			needed = engine->frames.arena[i].highWater;
+		}
 	}
-	if(engine->states.inputs.physicals.CGE_KeyW == 1)
+	if(needed > arena->size && CGE_ArenaNew(&grown, needed + needed / 2) == CGE_OK)
 	{
-		engine->states.inputs.logicals.CGE_Pitch += 1.0f;
+		grown.highWater = arena->highWater;
+		CGE_ArenaFree(arena);
+		*arena = grown;
 	}
-	if(engine->states.inputs.physicals.CGE_KeyS == 1)
+
+	return CGE_ArenaReset(arena);
+}
+
+void *CGE_FrameAlloc(CGE_Engine *engine, size_t size)
+{
+	return CGE_ArenaAlloc(&engine->frames.arena[engine->frames.current], size);
+}
+
+/* Scratch for one call: whatever was allocated after the mark goes back */
+size_t CGE_FrameMark(CGE_Engine *engine)
+{
+	return engine->frames.arena[engine->frames.current].used;
+}
+
+CGE_EXITCODE CGE_FrameRelease(CGE_Engine *engine, size_t mark)
+{
+	CGE_Arena *arena;
+
+	arena = &engine->frames.arena[engine->frames.current];
+#ifdef CGE_DEBUG
+	/* Scratch still used after its release reads garbage */
+	memset(arena->base + mark, CGE_ARENA_POISON, arena->used - mark);
+#endif
+	arena->used = mark;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_FramesFree(CGE_Engine *engine)
+{
+	int i;
+
+	for(i = 0; i < engine->frames.buffers; i++)
 	{
-		engine->states.inputs.logicals.CGE_Pitch -= 1.0f;
+		CGE_ArenaFree(&engine->frames.arena[i]);
 	}
-	if(engine->states.inputs.physicals.CGE_KeyQ == 1)
+
+	return CGE_OK;
+}
+
+
+/* Job functions implementations */
+
+CGE_EXITCODE CGE_JobsNew(CGE_Jobs *jobs, int workers)
+{
+	int i;
+
+	if(workers <= 0)
 	{
-		engine->states.inputs.logicals.CGE_Roll += 1.0f;
+#ifdef _SC_NPROCESSORS_ONLN
+		workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		workers = workers <= 0 ? 1 : workers;
 	}
-	if(engine->states.inputs.physicals.CGE_KeyE == 1)
+	workers = workers > CGE_JOBS_WORKERS_MAX ? CGE_JOBS_WORKERS_MAX : workers;
+
+	jobs->worker = (CGE_JobWorker *)calloc(workers, sizeof(CGE_JobWorker));
+	jobs->wake = SDL_CreateSemaphore(0);
+	jobs->workers = 0;
+	jobs->running = 1;
+	jobs->sleeping = 0;
+	jobs->profile = NULL;
+	jobs->profileData = NULL;
+	if(jobs->worker == NULL || jobs->wake == NULL)
 	{
-		engine->states.inputs.logicals.CGE_Roll -= 1.0f;
+		return CGE_ERR;
 	}
-	
-	return CGE_OK;
-}
 
-CGE_EXITCODE CGE_GetTimers(CGE_Engine *engine)
-{
-	Uint32 absolute = SDL_GetTicks();
-	engine->states.timers.elapsed = absolute - engine->states.timers.absolute;
-	engine->states.timers.absolute = absolute;
+	for(i = 0; i < workers; i++)
+	{
+		jobs->worker[i].jobs = jobs;
+		jobs->worker[i].index = i;
+		jobs->worker[i].seed = 2463534242UL + i;
+	}
 
-	engine->states.timers.fpsFrames++;
-	engine->states.timers.fpsTicks += engine->states.timers.elapsed;
-	if(engine->states.timers.fpsTicks > 1000)
+	/* Worker 0 is the calling thread, it only runs jobs while it waits */
+	jobs->worker[0].id = SDL_ThreadID();
+	jobs->workers = 1;
+	for(i = 1; i < workers; i++)
 	{
-		/*printf("fps: %d/sec\n", engine->states.timers.fpsFrames);*/
-		engine->states.timers.fps = engine->states.timers.fpsFrames;
-		engine->states.timers.fpsFrames = 0;
-		engine->states.timers.fpsTicks = 0;
+		jobs->worker[i].thread = SDL_CreateThread(CGE_JobsThread, &jobs->worker[i]);
+		if(jobs->worker[i].thread == NULL)
+		{
+			break;
+		}
+		jobs->workers++;
 	}
 
 	return CGE_OK;
 }
 
-CGE_EXITCODE CGE_Move(CGE_Engine *engine)
-{	
-	float t;
-	CGE_V4 forward;
-	CGE_V4 left;
-	CGE_V4 velocity;
-	CGE_M4 rotate;
+/* Makes the calling thread worker 0, for jobs created on another thread */
+CGE_EXITCODE CGE_JobsAttach(CGE_Jobs *jobs)
+{
+	jobs->worker[0].id = SDL_ThreadID();
+	CGE_AtomicFence();
 
-	t = (float)engine->states.timers.elapsed;
-		
-	engine->camera.axis.x += engine->states.inputs.logicals.CGE_Pitch * 0.05f * t;
-	engine->camera.axis.y += engine->states.inputs.logicals.CGE_Yaw * 0.05f * t;
-	engine->camera.axis.z += engine->states.inputs.logicals.CGE_Roll * 0.05f *t;
+	return CGE_OK;
+}
 
-	if(engine->camera.axis.x > 40.0f)
+CGE_EXITCODE CGE_JobsFree(CGE_Jobs *jobs)
+{
+	int i;
+
+	jobs->running = 0;
+	CGE_AtomicFence();
+	for(i = 1; i < jobs->workers; i++)
 	{
-		engine->camera.axis.x = 40.0f;
+		SDL_SemPost(jobs->wake);
 	}
-	if(engine->camera.axis.x < -40.0f)
+	for(i = 1; i < jobs->workers; i++)
 	{
-		engine->camera.axis.x = -40.0f;
+		SDL_WaitThread(jobs->worker[i].thread, NULL);
 	}
-	if(engine->camera.axis.y > 180.0f)
+
+	SDL_DestroySemaphore(jobs->wake);
+	free(jobs->worker);
+	jobs->worker = NULL;
+	jobs->workers = 0;
+
+	return CGE_OK;
+}
+
+/* The hook gets its data, the job name, the worker and start and end */
+/* times in microseconds, from whichever worker ran the job */
+CGE_EXITCODE CGE_JobsProfile(CGE_Jobs *jobs, CGE_JobProfile profile, void *data)
+{
+	jobs->profileData = data;
+	jobs->profile = profile;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_JobsRun(CGE_Jobs *jobs, const char *name, CGE_JobFunction function, void *data, Uint32 first, Uint32 count, CGE_JobCounter *counter)
+{
+	CGE_JobWorker *worker;
+	CGE_Job *job;
+	long bottom;
+	int index;
+
+	if(counter != NULL)
 	{
-		engine->camera.axis.y = -180.0f;
+		CGE_AtomicAdd(&counter->value, 1);
 	}
-	if(engine->camera.axis.y < -180.0f)
+
+	/* Threads outside the pool and full deques run the job right away */
+	index = CGE_JobsWorker(jobs);
+	worker = index >= 0 ? &jobs->worker[index] : NULL;
+	if(worker == NULL || worker->bottom - worker->top >= CGE_JOBS_DEQUE)
 	{
-		engine->camera.axis.y = 180.0f;
+		function(data, first, count);
+		if(counter != NULL)
+		{
+			CGE_AtomicAdd(&counter->value, -1);
+		}
+		return CGE_OK;
 	}
-	if(engine->camera.axis.z > 10.0f)
+
+	bottom = worker->bottom;
+	job = &worker->deque[bottom & (CGE_JOBS_DEQUE - 1)];
+	job->function = function;
+	job->data = data;
+	job->first = first;
+	job->count = count;
+	job->counter = counter;
+	job->name = name;
+
+	/* The job must be visible before the new bottom, and the new bottom */
+	/* before the sleeping count is read, see CGE_JobsThread */
+	CGE_AtomicFence();
+	worker->bottom = bottom + 1;
+	CGE_AtomicFence();
+
+	if(jobs->sleeping > 0)
 	{
-		engine->camera.axis.z = 10.0f;
+		SDL_SemPost(jobs->wake);
 	}
-	if(engine->camera.axis.z < -10.0f)
+
+	return CGE_OK;
+}
+
+/* Splits [0, count) into jobs of grain indices, the caller's deque holds */
+/* them and idle workers steal what the caller does not get to */
+CGE_EXITCODE CGE_JobsFor(CGE_Jobs *jobs, const char *name, CGE_JobFunction function, void *data, Uint32 count, Uint32 grain, CGE_JobCounter *counter)
+{
+	Uint32 first;
+
+	grain = grain == 0 ? 1 : grain;
+	for(first = 0; first < count; first += grain)
 	{
-		engine->camera.axis.z = -10.0f;
+		CGE_JobsRun(jobs, name, function, data, first, count - first < grain ? count - first : grain, counter);
 	}
 
-	rotate = CGE_M4Rotate(engine->camera.axis.y, 0.0f, 1.0f, 0.0f);
-	forward = CGE_V4New(0.0f, 0.0f, -1.0f, 0.0f);
-	left = CGE_V4New(1.0f, 0.0f, 0.0f, 0.0f);
-	forward = CGE_M4V4Mul(rotate, forward);
-	left = CGE_M4V4Mul(rotate, left);
-	forward = CGE_V4ScalarMul(forward, engine->states.inputs.logicals.CGE_Advance);
-	left = CGE_V4ScalarMul(left, engine->states.inputs.logicals.CGE_Strafe);
-	velocity = CGE_V4V4Add(forward, left);
-	velocity = CGE_V4Normalize(velocity);
-	
-	engine->camera.position.x += velocity.x * 0.05f * t;
-	engine->camera.position.y += velocity.y * 0.05f * t;
-	engine->camera.position.z += velocity.z * 0.05f * t;
-		
-	engine->camera.view = CGE_M4View(engine->camera.position, engine->camera.axis);
-			
-	/*	
-	engine->camera.position.x += engine->states.inputs.logicals.CGE_AxisX * 0.05f * t;
-	engine->camera.position.y += engine->states.inputs.logicals.CGE_AxisY * 0.05f * t;
-	engine->camera.position.z += engine->states.inputs.logicals.CGE_AxisZ * 0.05f * t;
-	*/
-	/*CGE_SetCamera(engine, engine->camera.position, engine->camera.target);*/
+	return CGE_OK;
+}
+
+/* Waiting runs other jobs, so a job can wait on the counter of jobs it */
+/* depends on without tying up its worker */
+CGE_EXITCODE CGE_JobsWait(CGE_Jobs *jobs, CGE_JobCounter *counter)
+{
+	int index;
+
+	index = CGE_JobsWorker(jobs);
+	while(counter->value > 0)
+	{
+		if(index < 0 || CGE_JobsExecute(jobs, index) == 0)
+		{
+			SDL_Delay(0);
+		}
+	}
+	CGE_AtomicFence();
 
 	return CGE_OK;
 }
 
+int CGE_JobsWorker(CGE_Jobs *jobs)
+{
+	Uint32 id;
+	int i;
 
-CGE_EXITCODE CGE_Render(CGE_Engine *engine)
-{	
-	char fps[255];
+	id = SDL_ThreadID();
+	for(i = 0; i < jobs->workers; i++)
+	{
+		if(jobs->worker[i].id == id)
+		{
+			return i;
+		}
+	}
 
-	if(SDL_MUSTLOCK(engine->screen))
+	return -1;
+}
+
+int CGE_JobsPending(CGE_Jobs *jobs)
+{
+	int i;
+
+	for(i = 0; i < jobs->workers; i++)
 	{
-		if(SDL_LockSurface(engine->screen) < 0)
+		if(jobs->worker[i].bottom > jobs->worker[i].top)
 		{
-			return CGE_ERR;
+			return 1;
 		}
 	}
 
-	SDL_FillRect(engine->screen, NULL, 0);
+	return 0;
+}
 
-		
-	engine->device.view = engine->camera.view;
-	engine->device.projection = engine->camera.projection;
+/* Runs one job, from the worker's own deque first, otherwise stolen */
+/* from another one. Returns 0 when there was nothing to run */
+int CGE_JobsExecute(CGE_Jobs *jobs, int index)
+{
+	CGE_JobWorker *worker;
+	CGE_JobWorker *victim;
+	CGE_Job job;
+	Uint32 start;
+	long bottom;
+	long top;
+	int found;
+	int i;
+
+	worker = &jobs->worker[index];
+	found = 0;
+
+	/* Pop: take the bottom first, then look at what thieves left */
+	bottom = worker->bottom - 1;
+	worker->bottom = bottom;
+	CGE_AtomicFence();
+	top = worker->top;
+	if(top <= bottom)
+	{
+		job = worker->deque[bottom & (CGE_JOBS_DEQUE - 1)];
+		found = 1;
+		if(top == bottom)
+		{
+			/* Last job, race the thieves for it */
+			found = CGE_AtomicCas(&worker->top, top, top + 1);
+			worker->bottom = bottom + 1;
+		}
+	}
+	else
+	{
+		worker->bottom = bottom + 1;
+	}
 
-	
-	CGE_DrawGrid(engine, CGE_V3New(50.0f, 50.0f, 50.0f), 20.0f);
+	for(i = 1; found == 0 && i < jobs->workers; i++)
+	{
+		worker->seed ^= worker->seed << 13;
+		worker->seed ^= worker->seed >> 17;
+		worker->seed ^= worker->seed << 5;
+		victim = &jobs->worker[(index + 1 + worker->seed % (jobs->workers - 1)) % jobs->workers];
+
+		top = victim->top;
+		CGE_AtomicFence();
+		bottom = victim->bottom;
+		if(top < bottom)
+		{
+			/* A copy torn by the owner reusing the slot fails the swap */
+			job = victim->deque[top & (CGE_JOBS_DEQUE - 1)];
+			found = CGE_AtomicCas(&victim->top, top, top + 1);
+			worker->stolen += found;
+		}
+	}
 
-	CGE_DrawLine(engine, engine->axe[0], 0);
-	CGE_DrawLine(engine, engine->axe[1], 0);
-	CGE_DrawLine(engine, engine->axe[2], 0);
+	if(found == 0)
+	{
+		return 0;
+	}
 
-	CGE_DrawLine(engine, CGE_LineNew(engine->point[0], engine->point[1]), 0);
-	CGE_DrawLine(engine, CGE_LineNew(engine->point[1], engine->point[2]), 0);
-	CGE_DrawLine(engine, CGE_LineNew(engine->point[2], engine->point[0]), 0);
-	CGE_DrawLine(engine, CGE_LineNew(engine->point[2], engine->point[3]), 0);
-	CGE_DrawLine(engine, CGE_LineNew(engine->point[3], engine->point[0]), 0);
-/*
-	CGE_DrawPoint(engine, engine->point[0]);
-	CGE_DrawPoint(engine, engine->point[1]);
-	CGE_DrawPoint(engine, engine->point[2]);
-	CGE_DrawPoint(engine, engine->point[3]);
-*/
+	start = CGE_JobsClock();
+	job.function(job.data, job.first, job.count);
+	worker->busy += (double)(CGE_JobsClock() - start);
+	worker->executed++;
+	if(jobs->profile != NULL)
+	{
+		jobs->profile(jobs->profileData, job.name, index, start, CGE_JobsClock());
+	}
 
+	if(job.counter != NULL)
+	{
+		CGE_AtomicAdd(&job.counter->value, -1);
+	}
 
-	sprintf(fps, "FPS : %i", engine->states.timers.fps);
-	CGE_DrawTextSolid(engine, fps, CGE_V3New(0.0f, 580.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 255.0f));
+	return 1;
+}
 
-/*	
-	CGE_DrawMatrix(engine, engine->device.view, CGE_V3New(0.0f, 332.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 255.0f));
-	CGE_DrawMatrix(engine, engine->device.projection, CGE_V3New(0.0f, 112.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 255.0f));
-*/
-/*
-	CGE_DrawTextSolid(engine, "Mala", CGE_V3New(0.0f, 14.0f, 0.0f), CGE_ColorNew(255.0f, 255.0f, 155.0f));
-	CGE_DrawTextSolid(engine, "Osaur", CGE_V3New(0.0f, 28.0f, 0.0f), CGE_ColorNew(155.0f, 255.0f, 255.0f));
-	CGE_DrawTextSolid(engine, "Trrrain", CGE_V3New(0.0f, 42.0f, 0.0f), CGE_ColorNew(255.0f, 155.0f, 255.0f));
-*/
-	/*CGE_M4Print(engine->device.view, "view");*/
-	/*CGE_M4Print(engine->device.projection, "projection");*/
+int CGE_JobsThread(void *data)
+{
+	CGE_JobWorker *worker;
+	CGE_Jobs *jobs;
+	int idle;
 
+	worker = (CGE_JobWorker *)data;
+	jobs = worker->jobs;
+	worker->id = SDL_ThreadID();
+	idle = 0;
 
-	if(SDL_MUSTLOCK(engine->screen))
+	while(jobs->running)
 	{
-		SDL_UnlockSurface(engine->screen);
-	}
+		if(CGE_JobsExecute(jobs, worker->index) == 1)
+		{
+			idle = 0;
+			continue;
+		}
+		if(++idle < CGE_JOBS_SPIN)
+		{
+			continue;
+		}
 
-	SDL_UpdateRect(engine->screen, 0, 0, 800, 600);
+		/* Announce the sleep, then look again: a job pushed meanwhile */
+		/* either shows up here or its pusher sees the sleeper and posts */
+		CGE_AtomicAdd(&jobs->sleeping, 1);
+		if(jobs->running && CGE_JobsPending(jobs) == 0)
+		{
+			SDL_SemWait(jobs->wake);
+		}
+		CGE_AtomicAdd(&jobs->sleeping, -1);
+		idle = 0;
+	}
 
-	return CGE_OK;
+	return 0;
 }
 
-CGE_EXITCODE CGE_DeInit(CGE_Engine *engine)
+Uint32 CGE_JobsClock(void)
 {
-	free(engine);
-	SDL_Quit();
-		
-	return CGE_OK;
-}
+	struct timespec now;
 
-CGE_EXITCODE CGE_SetCamera(CGE_Engine *engine, CGE_V3 position, CGE_V3 target)
-{	
-	engine->camera.position = position;
-	engine->camera.target = target;	
-	engine->camera.view = CGE_M4View(position, target);
+	clock_gettime(CLOCK_MONOTONIC, &now);
 
-	return CGE_OK;
+	return (Uint32)now.tv_sec * 1000000 + (Uint32)(now.tv_nsec / 1000);
 }
 
-
 /* Entry point */
 
 int main(int argc, char *agrv[])
 {
 	CGE_Engine *engine = NULL;
+	char *scene = NULL;
+	float budget = CGE_RESOLUTION_BUDGET;
+	int instances = 0;
+	int points = 0;
+	int stats = CGE_STATSMODE_OFF;
+	int markers = 0;
+	int noclip = 0;
+	int entities = 0;
+	int rig = 0;
+	char *shared = NULL;
+	int benchmark = 0;
+	int batch = 0;
+	char *keys = NULL;
+	char *output = "frame%05u.ppm";
+	float fps = CGE_EXPORT_FPS;
+	int threads = 0;
+	char *world = NULL;
+	int memory = CGE_WORLD_BUDGET;
+	CGE_EXITCODE code = CGE_OK;
+	int continuous = 0;
+	int stereo = 0;
+	int verify = 0;
+	int i;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(agrv[i], "--verify") == 0)
+		{
+			verify = 1;
+		}
+		else if(strcmp(agrv[i], "--budget") == 0 && i + 1 < argc)
+		{
+			budget = atof(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--instances") == 0 && i + 1 < argc)
+		{
+			instances = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--continuous") == 0)
+		{
+			continuous = 1;
+		}
+		else if(strcmp(agrv[i], "--stats") == 0)
+		{
+			stats = CGE_STATSMODE_HUD;
+		}
+		else if(strcmp(agrv[i], "--heatmap") == 0)
+		{
+			stats = CGE_STATSMODE_HEATMAP;
+		}
+		else if(strcmp(agrv[i], "--noclip") == 0)
+		{
+			noclip = 1;
+		}
+		else if(strcmp(agrv[i], "--stereo") == 0)
+		{
+			stereo = 1;
+		}
+		else if(strcmp(agrv[i], "--markers") == 0 && i + 1 < argc)
+		{
+			markers = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--entities") == 0 && i + 1 < argc)
+		{
+			entities = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--rig") == 0 && i + 1 < argc)
+		{
+			rig = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--shm") == 0 && i + 1 < argc)
+		{
+			shared = agrv[++i];
+		}
+		else if(strcmp(agrv[i], "--benchmark") == 0 && i + 1 < argc)
+		{
+			benchmark = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--batch") == 0 && i + 1 < argc)
+		{
+			batch = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--export") == 0 && i + 1 < argc)
+		{
+			keys = agrv[++i];
+		}
+		else if(strcmp(agrv[i], "--output") == 0 && i + 1 < argc)
+		{
+			output = agrv[++i];
+		}
+		else if(strcmp(agrv[i], "--fps") == 0 && i + 1 < argc)
+		{
+			fps = atof(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--world") == 0 && i + 1 < argc)
+		{
+			world = agrv[++i];
+		}
+		else if(strcmp(agrv[i], "--memory") == 0 && i + 1 < argc)
+		{
+			memory = atoi(agrv[++i]);
+		}
+		else if(strcmp(agrv[i], "--points") == 0 && i + 1 < argc)
+		{
+			points = atoi(agrv[++i]);
+		}
+		else
+		{
+			scene = agrv[i];
+		}
+	}
 	
-	CGE_Init(&engine);	
+	if(keys != NULL)
+	{
+		code = CGE_Export(scene, keys, output, threads, fps, verify);
+		return code == CGE_OK ? 0 : 1;
+	}
+
+	if(batch > 0)
+	{
+		code = CGE_Batch(scene, batch, benchmark > 0 ? benchmark : CGE_BATCH_FRAMES, verify, stereo);
+		return code == CGE_OK ? 0 : 1;
+	}
+
+	if(CGE_Init(&engine) == CGE_ERR)
+	{
+		return 1;
+	}
+	engine->resolution.budget = budget;
+	CGE_SetStatsMode(engine, (CGE_StatsMode)stats);
+	engine->idle.enabled = !continuous;
+	if(stereo == 1)
+	{
+		CGE_ViewsStereo(engine, CGE_STEREO_EYE);
+	}
+	/* A reader waits on the frames, so no shared output ends the run */
+	if(shared != NULL && CGE_OutputShared(engine, shared) == CGE_ERR)
+	{
+		fprintf(stderr, "%s : the shared frame output cannot be set up\n", shared);
+		CGE_DeInit(engine);
+		return 1;
+	}
+
+	/* A scene or world that cannot be read ends the run, not an empty view */
+	if(scene != NULL)
+	{
+		if(CGE_MeshFileOpen(&engine->scene, scene, verify) == CGE_ERR)
+		{
+			CGE_DeInit(engine);
+			return 1;
+		}
+		if(noclip == 0)
+		{
+			CGE_CollisionScene(engine);
+		}
+	}
+
+	if(world != NULL)
+	{
+		if(CGE_WorldOpen(&engine->world, world, memory) == CGE_ERR)
+		{
+			fprintf(stderr, "%s: no world chunks could be read\n", world);
+			CGE_DeInit(engine);
+			return 1;
+		}
+		engine->world.last = engine->camera.position;
+	}
+
+	if(instances > 0 && engine->scene.meshes > 0)
+	{
+		CGE_InstancesGrid(engine, &engine->scene.mesh[0], instances);
+	}
+
+	if(entities > 0)
+	{
+		CGE_EntitiesScatter(engine, entities);
+	}
+
+	if(rig > 0)
+	{
+		CGE_RigNew(engine, rig, noclip == 0);
+	}
+
+	if(points > 0)
+	{
+		CGE_PointCloudTerrain(engine, &engine->cloud, points);
+	}
+
+	if(markers > 0)
+	{
+		CGE_MarkersScatter(engine, markers);
+	}
+
+	if(benchmark > 0)
+	{
+		code = CGE_Benchmark(engine, benchmark);
+		engine->states.status = CGE_ENGINESTATESSTATUS_STOPPED;
+	}
 
 	while(engine->states.status == CGE_ENGINESTATESSTATUS_STARTED)
 	{
 		CGE_GetInputs(engine);
 		CGE_GetTimers(engine);
 		CGE_Move(engine);
-		CGE_Render(engine);
-		SDL_Delay(1);
+		if(CGE_Idle(engine) == 1)
+		{
+			CGE_RenderHud(engine);
+		}
+		else
+		{
+			CGE_Render(engine);
+			SDL_Delay(1);
+		}
 		/*engine->states.status = CGE_ENGINESTATESSTATUS_STOPPED;*/
 	}
 
 	CGE_DeInit(engine);
 
-	return 0;
+	return code == CGE_OK ? 0 : 1;
 }
 
 
@@ -1778,4 +10031,181 @@ CGE_EXITCODE CGE_V4Print(CGE_V4 v, char *label)
 	return CGE_OK;
 }
 
+CGE_EXITCODE CGE_ArenaPrint(CGE_Arena *arena, char *label)
+{
+	printf("\narena %s\n", label);
+	printf("size : %lu\t", (unsigned long)arena->size);
+	printf("used : %lu\t", (unsigned long)arena->used);
+	printf("high water : %lu\n", (unsigned long)arena->highWater);
+	if(arena->highWater > arena->size)
+	{
+		printf("overflowed by %lu\n", (unsigned long)(arena->highWater - arena->size));
+	}
+	printf("\n");
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_JobsPrint(CGE_Jobs *jobs)
+{
+	int i;
+
+	printf("\njobs %d workers\n", jobs->workers);
+	for(i = 0; i < jobs->workers; i++)
+	{
+		printf("worker %d : executed : %lu\tstolen : %lu\tbusy : %.0f us\n", i,
+		(unsigned long)jobs->worker[i].executed, (unsigned long)jobs->worker[i].stolen, jobs->worker[i].busy);
+	}
+
+	return CGE_OK;
+}
+
+#ifdef CGE_ALLOCS
+/* Sites are found by line with open addressing, claimed by CAS since the */
+/* job workers allocate too */
+void *CGE_AllocTrack(void *pointer, size_t size, int line)
+{
+	CGE_AllocSite *site;
+	Uint32 i;
+	Uint32 h;
+
+	if(pointer == NULL)
+	{
+		return NULL;
+	}
+
+	h = ((Uint32)line * 2654435761u) % CGE_ALLOC_SITES;
+	for(i = 0; i < CGE_ALLOC_SITES; i++)
+	{
+		site = &CGE_AllocTracker.site[(h + i) % CGE_ALLOC_SITES];
+		if(site->line == line || (site->line == 0 && CGE_AtomicCas(&site->line, 0, line)) || site->line == line)
+		{
+			CGE_AtomicAdd(&site->count, 1);
+			CGE_AtomicAdd(&site->frame, 1);
+			CGE_AtomicAdd(&site->bytes, size);
+			break;
+		}
+	}
+	CGE_AtomicAdd(&CGE_AllocTracker.total, 1);
+	CGE_AtomicAdd(&CGE_AllocTracker.frame, 1);
+	CGE_AtomicAdd(&CGE_AllocTracker.bytes, size);
+
+	return pointer;
+}
+
+SDL_Surface *CGE_SurfaceTrack(SDL_Surface *surface, int line)
+{
+	if(surface == NULL)
+	{
+		return NULL;
+	}
+	CGE_AllocTrack(surface, (size_t)surface->pitch * surface->h + sizeof(SDL_Surface), line);
+
+	return surface;
+}
+
+/* Reports the allocations of the frame that ended, by line. The tracker */
+/* is shared by the whole process, so with several engines live their */
+/* frames cannot be told apart and only the totals are kept. What is */
+/* reported is taken off, allocations made meanwhile stay for the next */
+CGE_EXITCODE CGE_AllocsFrame(void)
+{
+	CGE_AllocSite *site;
+	Uint32 frame;
+	Uint32 count;
+	int i;
+
+	if(CGE_AllocTracker.engines > 1)
+	{
+		return CGE_OK;
+	}
+
+	frame = CGE_AllocTracker.frame;
+	if(frame > 0)
+	{
+		printf("allocations frame %u : %u\n", CGE_AllocTracker.frames, frame);
+		for(i = 0; i < CGE_ALLOC_SITES; i++)
+		{
+			site = &CGE_AllocTracker.site[i];
+			count = site->frame;
+			if(count > 0)
+			{
+				printf("\tline %d : %u\n", site->line, count);
+				CGE_AtomicAdd(&site->frame, -count);
+			}
+		}
+		CGE_AtomicAdd(&CGE_AllocTracker.frame, -frame);
+	}
+	CGE_AllocTracker.frames++;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_AllocsPrint(void)
+{
+	CGE_AllocSite *site;
+	int i;
+
+	printf("\nallocations : %u\tbytes : %lu\n", CGE_AllocTracker.total, (unsigned long)CGE_AllocTracker.bytes);
+	for(i = 0; i < CGE_ALLOC_SITES; i++)
+	{
+		site = &CGE_AllocTracker.site[i];
+		if(site->count > 0)
+		{
+			printf("line %d : %u\tbytes : %lu\n", site->line, site->count, (unsigned long)site->bytes);
+		}
+	}
+
+	return CGE_OK;
+}
+#endif
+
+#ifdef CGE_DEBUG
+CGE_EXITCODE CGE_OverlayTrace(CGE_Engine *engine, const char *label, CGE_V4 value, int components)
+{
+	CGE_OverlayValue *entry;
+
+	if(engine->overlay.trace == 0 || engine->overlay.count >= CGE_OVERLAY_VALUES)
+	{
+		return CGE_OK;
+	}
+
+	entry = &engine->overlay.value[engine->overlay.count++];
+	entry->label = label;
+	entry->value = value;
+	entry->components = components;
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_OverlayDraw(CGE_Engine *engine)
+{
+	CGE_OverlayValue *entry;
+	SDL_Color white;
+	char text[255];
+	float y;
+	int i;
+
+	white = CGE_ColorNew(255, 255, 255);
+	for(i = 0; i < engine->overlay.count; i++)
+	{
+		entry = &engine->overlay.value[i];
+		y = i * 16.0f;
+
+		CGE_DrawTextSolid(engine, (char *)entry->label, CGE_V3New(0.0f, y, 0.0f), white);
+		sprintf(text, "%f", entry->value.x);
+		CGE_DrawTextSolid(engine, text, CGE_V3New(200.0f, y, 0.0f), white);
+		sprintf(text, "%f", entry->value.y);
+		CGE_DrawTextSolid(engine, text, CGE_V3New(300.0f, y, 0.0f), white);
+		sprintf(text, "%f", entry->value.z);
+		CGE_DrawTextSolid(engine, text, CGE_V3New(400.0f, y, 0.0f), white);
+		if(entry->components == 4)
+		{
+			sprintf(text, "%f", entry->value.w);
+			CGE_DrawTextSolid(engine, text, CGE_V3New(500.0f, y, 0.0f), white);
+		}
+	}
 
+	return CGE_OK;
+}
+#endif
@@ -0,0 +1,54 @@
+/*
+
+CGE. Camomile Game Engine.
+
+Code shared by the engine and its tools.
+
+Copyright (C) 2016 slughnaz
+ 
+CGE is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CGE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+   
+You should have received a copy of the GNU General Public License
+along with CGE.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "CGECommon.h"
+
+
+/* Common functions implementations */
+
+Uint32 CGE_Adler32(Uint32 adler, const unsigned char *data, size_t size)
+{
+	Uint32 a;
+	Uint32 b;
+	size_t n;
+
+	a = adler & 0xFFFF;
+	b = adler >> 16;
+
+	/* 5552 bytes is the most that can be summed before b overflows */
+	while(size > 0)
+	{
+		n = size < 5552 ? size : 5552;
+		size -= n;
+		while(n > 0)
+		{
+			a += *data++;
+			b += a;
+			n--;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return (b << 16) | a;
+}
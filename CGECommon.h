@@ -0,0 +1,153 @@
+/*
+
+CGE. Camomile Game Engine.
+
+Types and file formats shared by the engine and its tools.
+
+Copyright (C) 2016 slughnaz
+ 
+CGE is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CGE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+   
+You should have received a copy of the GNU General Public License
+along with CGE.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CGE_COMMON_H
+#define CGE_COMMON_H
+
+#include <SDL.h>
+#include <stddef.h>
+
+
+#define CGE_MESHFILE_VERSION 2
+#define CGE_MESHFILE_ALIGN 64
+#define CGE_MESHFILE_QUANTIZED 0x1
+#define CGE_MESHFILE_INDEX16 0x2
+#define CGE_SHAREDFRAME_VERSION 1
+#define CGE_SHAREDFRAME_SLOTS 3
+#define CGE_SHAREDFRAME_ALIGN 4096
+
+
+/* Common structures */
+
+enum CGE_EXITCODE
+{
+	CGE_OK = 0,
+	CGE_ERR
+};
+
+typedef enum CGE_EXITCODE CGE_EXITCODE;
+
+
+/* Mesh file structures */
+
+/* On disk, little endian. Arrays start on CGE_MESHFILE_ALIGN boundaries, */
+/* offsets are from the start of the file. The flags of the header choose */
+/* the streams of every mesh: with CGE_MESHFILE_QUANTIZED positions are */
+/* Uint16 steps across the mesh's box, min + q * (max - min) / 65535, and */
+/* with CGE_MESHFILE_INDEX16 meshes of at most 65536 vertices have Uint16 */
+/* indices. Version 1 files have no flags, floats and Uint32 indices */
+
+struct CGE_MeshFileHeader
+{
+	char magic[4];
+	Uint32 version;
+	Uint32 flags;
+	Uint32 meshes;
+	Uint32 size;
+	Uint32 checksum;
+	Uint32 reserved[10];
+};
+
+typedef struct CGE_MeshFileHeader CGE_MeshFileHeader;
+
+struct CGE_MeshFileMesh
+{
+	Uint32 vertices;
+	Uint32 indices;
+	Uint32 x;
+	Uint32 y;
+	Uint32 z;
+	Uint32 index;
+	Uint32 lods;
+	Uint32 lod;
+	Uint32 checksum;
+	float min[3];
+	float max[3];
+	Uint8 color[4];
+};
+
+typedef struct CGE_MeshFileMesh CGE_MeshFileMesh;
+
+struct CGE_MeshFileLod
+{
+	float distance;
+	Uint32 first;
+	Uint32 count;
+};
+
+typedef struct CGE_MeshFileLod CGE_MeshFileLod;
+
+/* The layout above must not depend on the compiler */
+typedef char CGE_MeshFileHeaderSize[sizeof(CGE_MeshFileHeader) == 64 ? 1 : -1];
+typedef char CGE_MeshFileMeshSize[sizeof(CGE_MeshFileMesh) == 64 ? 1 : -1];
+typedef char CGE_MeshFileLodSize[sizeof(CGE_MeshFileLod) == 12 ? 1 : -1];
+
+
+/* Shared framebuffer structures */
+
+/* A POSIX shared memory object holding the header then a ring of frames, */
+/* each on its own page at its slot offset, in the engine's pixel format. */
+/* sequence counts the published frames and is the futex word the engine */
+/* wakes on. A slot's sequence is 0 while the engine draws into it, a reader */
+/* copying latest checks it did not change before trusting the copy */
+
+struct CGE_SharedFrameSlot
+{
+	Uint32 sequence;
+	Uint32 offset;
+	Uint32 x;
+	Uint32 y;
+	Uint32 w;
+	Uint32 h;
+};
+
+typedef struct CGE_SharedFrameSlot CGE_SharedFrameSlot;
+
+struct CGE_SharedFrameHeader
+{
+	char magic[4];
+	Uint32 version;
+	Uint32 width;
+	Uint32 height;
+	Uint32 pitch;
+	Uint32 bitsPerPixel;
+	Uint32 rmask;
+	Uint32 gmask;
+	Uint32 bmask;
+	Uint32 slots;
+	Uint32 sequence;
+	Uint32 latest;
+	Uint32 reserved[4];
+	CGE_SharedFrameSlot slot[CGE_SHAREDFRAME_SLOTS];
+};
+
+typedef struct CGE_SharedFrameHeader CGE_SharedFrameHeader;
+
+typedef char CGE_SharedFrameHeaderSize[sizeof(CGE_SharedFrameHeader) == 64 + 24 * CGE_SHAREDFRAME_SLOTS ? 1 : -1];
+
+
+/* Common functions definitions */
+
+Uint32 CGE_Adler32(Uint32, const unsigned char *, size_t);
+
+#endif
@@ -0,0 +1,1704 @@
+/*
+
+CGE. Camomile Game Engine.
+
+Converts OBJ and ASCII PLY wireframes into CGE mesh files.
+
+Copyright (C) 2016 slughnaz
+
+CGE is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CGE is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with CGE.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <SDL.h>
+#include "CGECommon.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#define CGE_IMPORT_THREADS_MAX 64
+#define CGE_IMPORT_CHUNK_MIN (256*1024)
+#define CGE_IMPORT_LODS 3
+#define CGE_IMPORT_PLY_ELEMENTS 16
+#define CGE_MERGE_NONE 0xFFFFFFFFUL
+
+
+/* Import structures */
+
+enum CGE_ImportFormat
+{
+	CGE_IMPORTFORMAT_OBJ = 0,
+	CGE_IMPORTFORMAT_PLY
+};
+
+typedef enum CGE_ImportFormat CGE_ImportFormat;
+
+enum CGE_PlyElementType
+{
+	CGE_PLYELEMENTTYPE_OTHER = 0,
+	CGE_PLYELEMENTTYPE_VERTEX,
+	CGE_PLYELEMENTTYPE_FACE,
+	CGE_PLYELEMENTTYPE_EDGE
+};
+
+typedef enum CGE_PlyElementType CGE_PlyElementType;
+
+struct CGE_PlyElement
+{
+	CGE_PlyElementType type;
+	Uint32 count;
+	int properties;
+	int x;
+	int y;
+	int z;
+};
+
+typedef struct CGE_PlyElement CGE_PlyElement;
+
+struct CGE_PlyHeader
+{
+	CGE_PlyElement element[CGE_IMPORT_PLY_ELEMENTS];
+	int elements;
+	const char *body;
+};
+
+typedef struct CGE_PlyHeader CGE_PlyHeader;
+
+struct CGE_ImportArray
+{
+	void *data;
+	size_t size;
+	size_t count;
+	size_t capacity;
+};
+
+typedef struct CGE_ImportArray CGE_ImportArray;
+
+/* One thread's share of the text, cut on line boundaries */
+struct CGE_ImportChunk
+{
+	const char *begin;
+	const char *end;
+	CGE_ImportFormat format;
+	const CGE_PlyHeader *ply;
+	int pass;
+	Uint32 line;
+	Uint32 lines;
+	Uint32 base;
+	CGE_ImportArray vertices;
+	CGE_ImportArray edges;
+	CGE_ImportArray relative;
+	const char *error;
+};
+
+typedef struct CGE_ImportChunk CGE_ImportChunk;
+
+struct CGE_ImportMesh
+{
+	Uint32 vertices;
+	Uint32 indices;
+	float *x;
+	float *y;
+	float *z;
+	Uint32 *index;
+	Uint32 lods;
+	CGE_MeshFileLod lod[CGE_IMPORT_LODS];
+	float min[3];
+	float max[3];
+	Uint8 color[4];
+};
+
+typedef struct CGE_ImportMesh CGE_ImportMesh;
+
+struct CGE_ImportHash
+{
+	Uint32 *slot;
+	Uint32 mask;
+};
+
+typedef struct CGE_ImportHash CGE_ImportHash;
+
+enum CGE_MergePass
+{
+	CGE_MERGEPASS_HASH = 0,
+	CGE_MERGEPASS_FIRST,
+	CGE_MERGEPASS_COUNT,
+	CGE_MERGEPASS_PLACE,
+	CGE_MERGEPASS_REMAP
+};
+
+typedef enum CGE_MergePass CGE_MergePass;
+
+/* Merging alternates passes over the chunks with passes over hash */
+/* partitions. Each partition finds the first copy of its own keys, so */
+/* the output keeps the order vertices and edges were first read in */
+struct CGE_ImportMerger
+{
+	CGE_ImportMesh *mesh;
+	CGE_ImportChunk *chunk;
+	int chunks;
+	CGE_MergePass pass;
+	int edges;
+	Uint32 vertices;
+	Uint32 total;
+	Uint32 base[CGE_IMPORT_THREADS_MAX + 1];
+	Uint32 placed[CGE_IMPORT_THREADS_MAX + 1];
+	Uint32 missing[CGE_IMPORT_THREADS_MAX];
+	int bad[CGE_IMPORT_THREADS_MAX];
+	Uint32 *hash;
+	Uint32 *first;
+	Uint32 *remap;
+};
+
+typedef struct CGE_ImportMerger CGE_ImportMerger;
+
+struct CGE_MergeJob
+{
+	CGE_ImportMerger *merger;
+	int index;
+};
+
+typedef struct CGE_MergeJob CGE_MergeJob;
+
+
+/* Parser functions definitions */
+
+const char *CGE_ParseSpace(const char *, const char *);
+const char *CGE_ParseLine(const char *, const char *);
+const char *CGE_ParseFloat(const char *, const char *, float *);
+const char *CGE_ParseInt(const char *, const char *, long *);
+CGE_EXITCODE CGE_PlyHeaderRead(CGE_PlyHeader *, const char *, const char *);
+
+
+/* Import functions definitions */
+
+CGE_EXITCODE CGE_ArrayNew(CGE_ImportArray *, size_t);
+void *CGE_ArrayGrow(CGE_ImportArray *, size_t);
+CGE_EXITCODE CGE_ArrayFree(CGE_ImportArray *);
+CGE_EXITCODE CGE_HashNew(CGE_ImportHash *, size_t);
+Uint32 CGE_HashMix(Uint32, Uint32);
+CGE_EXITCODE CGE_HashFree(CGE_ImportHash *);
+CGE_EXITCODE CGE_ImportEdge(CGE_ImportChunk *, Uint32, int, Uint32, int);
+CGE_EXITCODE CGE_ImportObj(CGE_ImportChunk *);
+CGE_EXITCODE CGE_ImportPly(CGE_ImportChunk *);
+int CGE_ImportThread(void *);
+CGE_EXITCODE CGE_ImportRun(CGE_ImportChunk *, int);
+int CGE_MergeChunk(const CGE_ImportMerger *, Uint32);
+int CGE_MergeEqual(const CGE_ImportMerger *, int, Uint32, Uint32);
+CGE_EXITCODE CGE_MergeHash(CGE_ImportMerger *, int);
+CGE_EXITCODE CGE_MergeFirst(CGE_ImportMerger *, int);
+CGE_EXITCODE CGE_MergePlace(CGE_ImportMerger *, int);
+int CGE_MergeThread(void *);
+CGE_EXITCODE CGE_MergeRun(CGE_ImportMerger *, CGE_MergePass);
+CGE_EXITCODE CGE_ImportMerge(CGE_ImportMesh *, CGE_ImportChunk *, int);
+CGE_EXITCODE CGE_ImportLods(CGE_ImportMesh *);
+CGE_EXITCODE CGE_ImportWrite(CGE_ImportMesh *, const char *, int);
+CGE_EXITCODE CGE_ImportMeshFree(CGE_ImportMesh *);
+
+
+/* Parser functions implementations */
+
+const char *CGE_ParseSpace(const char *p, const char *end)
+{
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+	{
+		p++;
+	}
+
+	return p;
+}
+
+const char *CGE_ParseLine(const char *p, const char *end)
+{
+	p = (const char *)memchr(p, '\n', end - p);
+
+	return p == NULL ? end : p + 1;
+}
+
+/* Digits add up in a double and are scaled by one power of ten, which */
+/* can round a few times: the float may rarely differ from strtod's by */
+/* one unit in the last place. That is far below what wireframe */
+/* coordinates need, and skips strtod's locale lookup and the */
+/* terminated string it wants */
+const char *CGE_ParseFloat(const char *p, const char *end, float *value)
+{
+	static const double power[23] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	double mantissa = 0.0;
+	int negative = 0;
+	int digits = 0;
+	int exponent = 0;
+	long e;
+	const char *start;
+
+	if(p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	start = p;
+	while(p < end && *p >= '0' && *p <= '9')
+	{
+		if(digits < 17)
+		{
+			mantissa = mantissa * 10.0 + (*p - '0');
+			digits += mantissa > 0.0;
+		}
+		else
+		{
+			exponent++;
+		}
+		p++;
+	}
+	if(p < end && *p == '.')
+	{
+		p++;
+		while(p < end && *p >= '0' && *p <= '9')
+		{
+			if(digits < 17)
+			{
+				mantissa = mantissa * 10.0 + (*p - '0');
+				digits += mantissa > 0.0;
+				exponent--;
+			}
+			p++;
+		}
+	}
+	if(p == start || (p == start + 1 && *start == '.'))
+	{
+		return NULL;
+	}
+	if(p < end && (*p == 'e' || *p == 'E'))
+	{
+		p = CGE_ParseInt(p + 1, end, &e);
+		if(p == NULL || e > 1000 || e < -1000)
+		{
+			return NULL;
+		}
+		exponent += (int)e;
+	}
+
+	if(exponent >= 0)
+	{
+		mantissa *= exponent <= 22 ? power[exponent] : pow(10.0, exponent);
+	}
+	else
+	{
+		mantissa /= exponent >= -22 ? power[-exponent] : pow(10.0, -exponent);
+	}
+
+	*value = (float)(negative ? -mantissa : mantissa);
+
+	return p;
+}
+
+const char *CGE_ParseInt(const char *p, const char *end, long *value)
+{
+	long n = 0;
+	int negative = 0;
+	const char *start;
+
+	if(p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	start = p;
+	while(p < end && *p >= '0' && *p <= '9' && p - start < 10)
+	{
+		n = n * 10 + (*p - '0');
+		p++;
+	}
+	if(p == start || (p < end && *p >= '0' && *p <= '9'))
+	{
+		return NULL;
+	}
+
+	*value = negative ? -n : n;
+
+	return p;
+}
+
+CGE_EXITCODE CGE_PlyHeaderRead(CGE_PlyHeader *header, const char *p, const char *end)
+{
+	char line[256];
+	char word[64];
+	char name[64];
+	unsigned long count;
+	const char *next;
+	CGE_PlyElement *element = NULL;
+	size_t n;
+	int ascii = 0;
+
+	header->elements = 0;
+	header->body = NULL;
+
+	while(p < end)
+	{
+		next = CGE_ParseLine(p, end);
+		n = next - p < (long)sizeof(line) ? (size_t)(next - p) : sizeof(line) - 1;
+		memcpy(line, p, n);
+		line[n] = '\0';
+		p = next;
+
+		if(strncmp(line, "format ascii", 12) == 0)
+		{
+			ascii = 1;
+		}
+		else if(sscanf(line, "element %63s %lu", name, &count) == 2)
+		{
+			if(header->elements == CGE_IMPORT_PLY_ELEMENTS)
+			{
+				return CGE_ERR;
+			}
+			element = &header->element[header->elements++];
+			element->type = CGE_PLYELEMENTTYPE_OTHER;
+			if(strcmp(name, "vertex") == 0)
+			{
+				element->type = CGE_PLYELEMENTTYPE_VERTEX;
+			}
+			else if(strcmp(name, "face") == 0)
+			{
+				element->type = CGE_PLYELEMENTTYPE_FACE;
+			}
+			else if(strcmp(name, "edge") == 0)
+			{
+				element->type = CGE_PLYELEMENTTYPE_EDGE;
+			}
+			element->count = (Uint32)count;
+			element->properties = 0;
+			element->x = -1;
+			element->y = -1;
+			element->z = -1;
+		}
+		else if(sscanf(line, "property %63s", word) == 1 && element != NULL)
+		{
+			/* Lists are only expected as the first property of faces */
+			if(strcmp(word, "list") != 0 && sscanf(line, "property %63s %63s", word, name) == 2)
+			{
+				if(strcmp(name, "x") == 0)
+				{
+					element->x = element->properties;
+				}
+				else if(strcmp(name, "y") == 0)
+				{
+					element->y = element->properties;
+				}
+				else if(strcmp(name, "z") == 0)
+				{
+					element->z = element->properties;
+				}
+			}
+			element->properties++;
+		}
+		else if(strncmp(line, "end_header", 10) == 0)
+		{
+			header->body = p;
+			break;
+		}
+	}
+
+	if(ascii == 0 || header->body == NULL)
+	{
+		return CGE_ERR;
+	}
+	for(n = 0; n < (size_t)header->elements; n++)
+	{
+		element = &header->element[n];
+		if(element->type == CGE_PLYELEMENTTYPE_VERTEX && (element->x < 0 || element->y < 0 || element->z < 0))
+		{
+			return CGE_ERR;
+		}
+	}
+
+	return CGE_OK;
+}
+
+
+/* Import functions implementations */
+
+CGE_EXITCODE CGE_ArrayNew(CGE_ImportArray *array, size_t size)
+{
+	array->data = NULL;
+	array->size = size;
+	array->count = 0;
+	array->capacity = 0;
+
+	return CGE_OK;
+}
+
+/* Returns room for n more elements, counted as used */
+void *CGE_ArrayGrow(CGE_ImportArray *array, size_t n)
+{
+	size_t capacity;
+	void *data;
+
+	if(array->count + n > array->capacity)
+	{
+		capacity = array->capacity < 1024 ? 1024 : array->capacity * 2;
+		while(capacity < array->count + n)
+		{
+			capacity *= 2;
+		}
+		data = realloc(array->data, capacity * array->size);
+		if(data == NULL)
+		{
+			return NULL;
+		}
+		array->data = data;
+		array->capacity = capacity;
+	}
+
+	data = (char *)array->data + array->count * array->size;
+	array->count += n;
+
+	return data;
+}
+
+CGE_EXITCODE CGE_ArrayFree(CGE_ImportArray *array)
+{
+	free(array->data);
+	array->data = NULL;
+	array->count = 0;
+	array->capacity = 0;
+
+	return CGE_OK;
+}
+
+/* Open addressing, slots hold an index plus one so zero means empty */
+CGE_EXITCODE CGE_HashNew(CGE_ImportHash *hash, size_t count)
+{
+	size_t size = 16;
+
+	while(size < count * 2)
+	{
+		size *= 2;
+	}
+
+	hash->slot = (Uint32 *)calloc(size, sizeof(Uint32));
+	hash->mask = (Uint32)(size - 1);
+
+	return hash->slot == NULL ? CGE_ERR : CGE_OK;
+}
+
+Uint32 CGE_HashMix(Uint32 h, Uint32 k)
+{
+	k *= 0xCC9E2D51UL;
+	k = (k << 15) | (k >> 17);
+	k *= 0x1B873593UL;
+	h ^= k;
+	h = (h << 13) | (h >> 19);
+
+	return h * 5 + 0xE6546B64UL;
+}
+
+CGE_EXITCODE CGE_HashFree(CGE_ImportHash *hash)
+{
+	free(hash->slot);
+	hash->slot = NULL;
+
+	return CGE_OK;
+}
+
+/* OBJ negative indices count back from the vertices read so far, which */
+/* a chunk only knows relative to its own start: those are recorded and */
+/* fixed up once every chunk's vertex count is known */
+CGE_EXITCODE CGE_ImportEdge(CGE_ImportChunk *chunk, Uint32 a, int ra, Uint32 b, int rb)
+{
+	Uint32 *edge;
+	Uint32 *relative;
+	Uint32 at;
+
+	at = (Uint32)chunk->edges.count;
+	edge = (Uint32 *)CGE_ArrayGrow(&chunk->edges, 2);
+	if(edge == NULL)
+	{
+		return CGE_ERR;
+	}
+	edge[0] = a;
+	edge[1] = b;
+
+	if(ra == 1 || rb == 1)
+	{
+		relative = (Uint32 *)CGE_ArrayGrow(&chunk->relative, ra + rb);
+		if(relative == NULL)
+		{
+			return CGE_ERR;
+		}
+		if(ra == 1)
+		{
+			*relative++ = at;
+		}
+		if(rb == 1)
+		{
+			*relative = at + 1;
+		}
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ImportObj(CGE_ImportChunk *chunk)
+{
+	const char *p = chunk->begin;
+	const char *end = chunk->end;
+	const char *line;
+	float *vertex;
+	long value;
+	Uint32 index;
+	Uint32 first = 0;
+	Uint32 previous = 0;
+	int relative;
+	int firstRelative = 0;
+	int previousRelative = 0;
+	int count;
+	char type;
+
+	while(p < end)
+	{
+		line = p;
+		p = CGE_ParseSpace(p, end);
+		if(p + 1 >= end || (p[1] != ' ' && p[1] != '\t'))
+		{
+			p = CGE_ParseLine(p, end);
+			continue;
+		}
+
+		type = *p++;
+		if(type == 'v')
+		{
+			vertex = (float *)CGE_ArrayGrow(&chunk->vertices, 3);
+			if(vertex == NULL
+			|| (p = CGE_ParseFloat(CGE_ParseSpace(p, end), end, &vertex[0])) == NULL
+			|| (p = CGE_ParseFloat(CGE_ParseSpace(p, end), end, &vertex[1])) == NULL
+			|| (p = CGE_ParseFloat(CGE_ParseSpace(p, end), end, &vertex[2])) == NULL)
+			{
+				chunk->error = line;
+				return CGE_ERR;
+			}
+		}
+		else if(type == 'f' || type == 'l')
+		{
+			count = 0;
+			for(;;)
+			{
+				p = CGE_ParseSpace(p, end);
+				if(p >= end || *p == '\n' || *p == '#')
+				{
+					break;
+				}
+				p = CGE_ParseInt(p, end, &value);
+				if(p == NULL || value == 0)
+				{
+					chunk->error = line;
+					return CGE_ERR;
+				}
+				/* Texture and normal indices are not needed */
+				while(p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+				{
+					p++;
+				}
+
+				relative = value < 0;
+				index = relative ? (Uint32)(chunk->vertices.count / 3) - (Uint32)-value : (Uint32)(value - 1);
+				if(count == 0)
+				{
+					first = index;
+					firstRelative = relative;
+				}
+				else if(CGE_ImportEdge(chunk, previous, previousRelative, index, relative) != CGE_OK)
+				{
+					chunk->error = line;
+					return CGE_ERR;
+				}
+				previous = index;
+				previousRelative = relative;
+				count++;
+			}
+			if(type == 'f' && count > 2
+			&& CGE_ImportEdge(chunk, previous, previousRelative, first, firstRelative) != CGE_OK)
+			{
+				chunk->error = line;
+				return CGE_ERR;
+			}
+		}
+
+		p = CGE_ParseLine(p, end);
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ImportPly(CGE_ImportChunk *chunk)
+{
+	const CGE_PlyHeader *header = chunk->ply;
+	const CGE_PlyElement *element;
+	const char *p = chunk->begin;
+	const char *end = chunk->end;
+	const char *line;
+	float *vertex;
+	float value;
+	long index;
+	long first = 0;
+	long previous = 0;
+	long count;
+	Uint32 row;
+	Uint32 left;
+	long i;
+	int e;
+
+	/* Find which element the chunk's first line belongs to */
+	row = chunk->line;
+	for(e = 0; e < header->elements && row >= header->element[e].count; e++)
+	{
+		row -= header->element[e].count;
+	}
+	left = e < header->elements ? header->element[e].count - row : 0;
+
+	while(p < end && e < header->elements)
+	{
+		line = p;
+		element = &header->element[e];
+
+		if(element->type == CGE_PLYELEMENTTYPE_VERTEX)
+		{
+			vertex = (float *)CGE_ArrayGrow(&chunk->vertices, 3);
+			if(vertex == NULL)
+			{
+				chunk->error = line;
+				return CGE_ERR;
+			}
+			for(i = 0; i < element->properties; i++)
+			{
+				p = CGE_ParseFloat(CGE_ParseSpace(p, end), end, &value);
+				if(p == NULL)
+				{
+					chunk->error = line;
+					return CGE_ERR;
+				}
+				if(i == element->x)
+				{
+					vertex[0] = value;
+				}
+				else if(i == element->y)
+				{
+					vertex[1] = value;
+				}
+				else if(i == element->z)
+				{
+					vertex[2] = value;
+				}
+			}
+		}
+		else if(element->type == CGE_PLYELEMENTTYPE_FACE || element->type == CGE_PLYELEMENTTYPE_EDGE)
+		{
+			count = 2;
+			if(element->type == CGE_PLYELEMENTTYPE_FACE)
+			{
+				p = CGE_ParseInt(CGE_ParseSpace(p, end), end, &count);
+			}
+			for(i = 0; p != NULL && i < count; i++)
+			{
+				p = CGE_ParseInt(CGE_ParseSpace(p, end), end, &index);
+				if(p == NULL || index < 0)
+				{
+					p = NULL;
+				}
+				else if(i == 0)
+				{
+					first = index;
+				}
+				else if(CGE_ImportEdge(chunk, (Uint32)previous, 0, (Uint32)index, 0) != CGE_OK)
+				{
+					p = NULL;
+				}
+				previous = index;
+			}
+			if(p == NULL || (count > 2 && CGE_ImportEdge(chunk, (Uint32)previous, 0, (Uint32)first, 0) != CGE_OK))
+			{
+				chunk->error = line;
+				return CGE_ERR;
+			}
+		}
+
+		p = CGE_ParseLine(p, end);
+		left--;
+		while(left == 0 && e < header->elements)
+		{
+			e++;
+			left = e < header->elements ? header->element[e].count : 0;
+		}
+	}
+
+	return CGE_OK;
+}
+
+int CGE_ImportThread(void *data)
+{
+	CGE_ImportChunk *chunk = (CGE_ImportChunk *)data;
+	const char *p;
+
+	/* PLY rows are only told apart by their line number, */
+	/* so a first pass counts the lines of every chunk */
+	if(chunk->pass == 0)
+	{
+		chunk->lines = 0;
+		for(p = chunk->begin; p < chunk->end; p = CGE_ParseLine(p, chunk->end))
+		{
+			chunk->lines++;
+		}
+		return 0;
+	}
+
+	if(chunk->format == CGE_IMPORTFORMAT_OBJ)
+	{
+		return CGE_ImportObj(chunk) == CGE_OK ? 0 : 1;
+	}
+
+	return CGE_ImportPly(chunk) == CGE_OK ? 0 : 1;
+}
+
+CGE_EXITCODE CGE_ImportRun(CGE_ImportChunk *chunk, int chunks)
+{
+	SDL_Thread *thread[CGE_IMPORT_THREADS_MAX];
+	int status;
+	int i;
+	CGE_EXITCODE exitcode = CGE_OK;
+
+	/* The calling thread takes the first chunk itself */
+	for(i = 1; i < chunks; i++)
+	{
+		thread[i] = SDL_CreateThread(CGE_ImportThread, &chunk[i]);
+	}
+	if(CGE_ImportThread(&chunk[0]) != 0)
+	{
+		exitcode = CGE_ERR;
+	}
+	for(i = 1; i < chunks; i++)
+	{
+		if(thread[i] == NULL)
+		{
+			status = CGE_ImportThread(&chunk[i]);
+		}
+		else
+		{
+			SDL_WaitThread(thread[i], &status);
+		}
+		if(status != 0)
+		{
+			exitcode = CGE_ERR;
+		}
+	}
+
+	return exitcode;
+}
+
+int CGE_MergeChunk(const CGE_ImportMerger *merger, Uint32 i)
+{
+	int low = 0;
+	int high = merger->chunks - 1;
+	int middle;
+
+	while(low < high)
+	{
+		middle = (low + high + 1) / 2;
+		if(merger->base[middle] <= i)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle - 1;
+		}
+	}
+
+	return low;
+}
+
+int CGE_MergeEqual(const CGE_ImportMerger *merger, int c, Uint32 i, Uint32 a)
+{
+	const float *u;
+	const float *v;
+	const Uint32 *e;
+	const Uint32 *f;
+	int d;
+
+	d = CGE_MergeChunk(merger, a);
+	if(merger->edges)
+	{
+		e = (const Uint32 *)merger->chunk[c].edges.data + (i - merger->base[c]) * 2;
+		f = (const Uint32 *)merger->chunk[d].edges.data + (a - merger->base[d]) * 2;
+		return e[0] == f[0] && e[1] == f[1];
+	}
+
+	u = (const float *)merger->chunk[c].vertices.data + (i - merger->base[c]) * 3;
+	v = (const float *)merger->chunk[d].vertices.data + (a - merger->base[d]) * 3;
+
+	return u[0] == v[0] && u[1] == v[1] && u[2] == v[2];
+}
+
+/* Vertices are keyed on their exact bit patterns. Edges are rewritten */
+/* to merged vertices, low index first so a-b and b-a merge too */
+CGE_EXITCODE CGE_MergeHash(CGE_ImportMerger *merger, int c)
+{
+	CGE_ImportChunk *chunk = &merger->chunk[c];
+	const float *vertex;
+	Uint32 *edge;
+	Uint32 *relative;
+	Uint32 key;
+	Uint32 h;
+	Uint32 a;
+	Uint32 b;
+	Uint32 n;
+	size_t i;
+	int k;
+
+	n = merger->base[c];
+	if(merger->edges == 0)
+	{
+		vertex = (const float *)chunk->vertices.data;
+		for(i = 0; i < chunk->vertices.count; i += 3, n++)
+		{
+			h = 0;
+			for(k = 0; k < 3; k++)
+			{
+				memcpy(&key, &vertex[i + k], sizeof(Uint32));
+				h = CGE_HashMix(h, key == 0x80000000UL ? 0 : key);
+			}
+			merger->hash[n] = h;
+			merger->first[n] = n;
+		}
+		return CGE_OK;
+	}
+
+	edge = (Uint32 *)chunk->edges.data;
+	relative = (Uint32 *)chunk->relative.data;
+	for(i = 0; i < chunk->relative.count; i++)
+	{
+		edge[relative[i]] += chunk->base;
+	}
+	for(i = 0; i < chunk->edges.count; i += 2, n++)
+	{
+		if(edge[i] >= merger->vertices || edge[i + 1] >= merger->vertices)
+		{
+			merger->bad[c] = 1;
+			merger->missing[c] = edge[i] >= merger->vertices ? edge[i] : edge[i + 1];
+			return CGE_ERR;
+		}
+		a = merger->remap[edge[i]];
+		b = merger->remap[edge[i + 1]];
+		edge[i] = a < b ? a : b;
+		edge[i + 1] = a < b ? b : a;
+		merger->hash[n] = CGE_HashMix(CGE_HashMix(0, edge[i]), edge[i + 1]);
+		merger->first[n] = a == b ? CGE_MERGE_NONE : n;
+	}
+
+	return CGE_OK;
+}
+
+/* Partitions split on the high bits of the hash, the slots on the low */
+CGE_EXITCODE CGE_MergeFirst(CGE_ImportMerger *merger, int p)
+{
+	CGE_ImportHash hash;
+	Uint32 parts = (Uint32)merger->chunks;
+	Uint32 count = 0;
+	Uint32 h;
+	Uint32 i;
+	int c;
+
+	for(i = 0; i < merger->total; i++)
+	{
+		count += ((merger->hash[i] >> 16) * parts) >> 16 == (Uint32)p && merger->first[i] != CGE_MERGE_NONE;
+	}
+	if(CGE_HashNew(&hash, count) != CGE_OK)
+	{
+		return CGE_ERR;
+	}
+
+	for(c = 0, i = 0; i < merger->total; i++)
+	{
+		while(i >= merger->base[c + 1])
+		{
+			c++;
+		}
+		if(((merger->hash[i] >> 16) * parts) >> 16 != (Uint32)p || merger->first[i] == CGE_MERGE_NONE)
+		{
+			continue;
+		}
+		for(h = merger->hash[i] & hash.mask; hash.slot[h] != 0; h = (h + 1) & hash.mask)
+		{
+			if(CGE_MergeEqual(merger, c, i, hash.slot[h] - 1))
+			{
+				break;
+			}
+		}
+		if(hash.slot[h] == 0)
+		{
+			hash.slot[h] = i + 1;
+		}
+		merger->first[i] = hash.slot[h] - 1;
+	}
+	CGE_HashFree(&hash);
+
+	return CGE_OK;
+}
+
+/* Counting, then placing once the chunk offsets are summed up */
+CGE_EXITCODE CGE_MergePlace(CGE_ImportMerger *merger, int c)
+{
+	CGE_ImportMesh *mesh = merger->mesh;
+	const float *vertex;
+	const Uint32 *edge;
+	Uint32 n = merger->placed[c];
+	Uint32 i;
+	Uint32 j;
+
+	for(i = merger->base[c], j = 0; i < merger->base[c + 1]; i++, j++)
+	{
+		if(merger->pass == CGE_MERGEPASS_COUNT)
+		{
+			n += merger->first[i] == i;
+		}
+		else if(merger->pass == CGE_MERGEPASS_REMAP)
+		{
+			if(merger->first[i] != i)
+			{
+				merger->remap[i] = merger->remap[merger->first[i]];
+			}
+		}
+		else if(merger->first[i] != i)
+		{
+			continue;
+		}
+		else if(merger->edges)
+		{
+			edge = (const Uint32 *)merger->chunk[c].edges.data;
+			mesh->index[n * 2] = edge[j * 2];
+			mesh->index[n * 2 + 1] = edge[j * 2 + 1];
+			n++;
+		}
+		else
+		{
+			vertex = (const float *)merger->chunk[c].vertices.data;
+			mesh->x[n] = vertex[j * 3];
+			mesh->y[n] = vertex[j * 3 + 1];
+			mesh->z[n] = vertex[j * 3 + 2];
+			merger->remap[i] = n++;
+		}
+	}
+	merger->placed[c] = n;
+
+	return CGE_OK;
+}
+
+int CGE_MergeThread(void *data)
+{
+	CGE_MergeJob *job = (CGE_MergeJob *)data;
+	CGE_EXITCODE exitcode;
+
+	switch(job->merger->pass)
+	{
+		case CGE_MERGEPASS_HASH:
+			exitcode = CGE_MergeHash(job->merger, job->index);
+			break;
+		case CGE_MERGEPASS_FIRST:
+			exitcode = CGE_MergeFirst(job->merger, job->index);
+			break;
+		default:
+			exitcode = CGE_MergePlace(job->merger, job->index);
+			break;
+	}
+
+	return exitcode == CGE_OK ? 0 : 1;
+}
+
+/* One job per chunk or partition, the calling thread taking the first */
+CGE_EXITCODE CGE_MergeRun(CGE_ImportMerger *merger, CGE_MergePass pass)
+{
+	SDL_Thread *thread[CGE_IMPORT_THREADS_MAX];
+	CGE_MergeJob job[CGE_IMPORT_THREADS_MAX];
+	Uint32 n = 0;
+	Uint32 count;
+	int status;
+	int i;
+	CGE_EXITCODE exitcode = CGE_OK;
+
+	merger->pass = pass;
+	for(i = 0; i < merger->chunks; i++)
+	{
+		job[i].merger = merger;
+		job[i].index = i;
+	}
+	for(i = 1; i < merger->chunks; i++)
+	{
+		thread[i] = SDL_CreateThread(CGE_MergeThread, &job[i]);
+	}
+	if(CGE_MergeThread(&job[0]) != 0)
+	{
+		exitcode = CGE_ERR;
+	}
+	for(i = 1; i < merger->chunks; i++)
+	{
+		if(thread[i] == NULL)
+		{
+			status = CGE_MergeThread(&job[i]);
+		}
+		else
+		{
+			SDL_WaitThread(thread[i], &status);
+		}
+		if(status != 0)
+		{
+			exitcode = CGE_ERR;
+		}
+	}
+
+	/* Counts become offsets for the placing pass */
+	if(pass == CGE_MERGEPASS_COUNT)
+	{
+		for(i = 0; i < merger->chunks; i++)
+		{
+			count = merger->placed[i];
+			merger->placed[i] = n;
+			n += count;
+		}
+		merger->placed[merger->chunks] = n;
+	}
+
+	return exitcode;
+}
+
+CGE_EXITCODE CGE_ImportMerge(CGE_ImportMesh *mesh, CGE_ImportChunk *chunk, int chunks)
+{
+	CGE_ImportMerger merger;
+	Uint32 total = 0;
+	Uint32 edges = 0;
+	Uint32 size;
+	Uint32 v;
+	int c;
+	int k;
+	CGE_EXITCODE exitcode;
+
+	for(c = 0; c < chunks; c++)
+	{
+		chunk[c].base = total;
+		total += (Uint32)(chunk[c].vertices.count / 3);
+		edges += (Uint32)(chunk[c].edges.count / 2);
+	}
+	size = total > edges ? total : edges;
+
+	merger.mesh = mesh;
+	merger.chunk = chunk;
+	merger.chunks = chunks;
+	merger.edges = 0;
+	merger.vertices = total;
+	merger.total = total;
+	for(c = 0; c < chunks; c++)
+	{
+		merger.base[c] = chunk[c].base;
+		merger.placed[c] = 0;
+		merger.bad[c] = 0;
+	}
+	merger.base[chunks] = total;
+
+	mesh->vertices = 0;
+	mesh->indices = 0;
+	mesh->x = (float *)malloc(total * sizeof(float) + 1);
+	mesh->y = (float *)malloc(total * sizeof(float) + 1);
+	mesh->z = (float *)malloc(total * sizeof(float) + 1);
+	mesh->index = (Uint32 *)malloc(edges * 2 * sizeof(Uint32) + 1);
+	merger.remap = (Uint32 *)malloc(total * sizeof(Uint32) + 1);
+	merger.hash = (Uint32 *)malloc(size * sizeof(Uint32) + 1);
+	merger.first = (Uint32 *)malloc(size * sizeof(Uint32) + 1);
+	exitcode = CGE_ERR;
+	if(mesh->x != NULL && mesh->y != NULL && mesh->z != NULL && mesh->index != NULL
+	&& merger.remap != NULL && merger.hash != NULL && merger.first != NULL)
+	{
+		exitcode = CGE_MergeRun(&merger, CGE_MERGEPASS_HASH);
+	}
+	if(exitcode == CGE_OK)
+	{
+		exitcode = CGE_MergeRun(&merger, CGE_MERGEPASS_FIRST);
+	}
+	if(exitcode == CGE_OK)
+	{
+		CGE_MergeRun(&merger, CGE_MERGEPASS_COUNT);
+		CGE_MergeRun(&merger, CGE_MERGEPASS_PLACE);
+		CGE_MergeRun(&merger, CGE_MERGEPASS_REMAP);
+		mesh->vertices = merger.placed[chunks];
+
+		merger.edges = 1;
+		merger.total = edges;
+		for(c = 0, v = 0; c < chunks; c++)
+		{
+			merger.base[c] = v;
+			merger.placed[c] = 0;
+			v += (Uint32)(chunk[c].edges.count / 2);
+		}
+		merger.base[chunks] = edges;
+		exitcode = CGE_MergeRun(&merger, CGE_MERGEPASS_HASH);
+		for(c = 0; c < chunks; c++)
+		{
+			if(merger.bad[c])
+			{
+				fprintf(stderr, "edge to missing vertex %lu\n", (unsigned long)merger.missing[c]);
+				break;
+			}
+		}
+	}
+	if(exitcode == CGE_OK)
+	{
+		exitcode = CGE_MergeRun(&merger, CGE_MERGEPASS_FIRST);
+	}
+	if(exitcode == CGE_OK)
+	{
+		CGE_MergeRun(&merger, CGE_MERGEPASS_COUNT);
+		CGE_MergeRun(&merger, CGE_MERGEPASS_PLACE);
+		mesh->indices = merger.placed[chunks] * 2;
+	}
+	free(merger.remap);
+	free(merger.hash);
+	free(merger.first);
+	if(exitcode != CGE_OK)
+	{
+		return CGE_ERR;
+	}
+
+	for(k = 0; k < 3; k++)
+	{
+		mesh->min[k] = mesh->vertices > 0 ? HUGE_VAL : 0.0f;
+		mesh->max[k] = mesh->vertices > 0 ? -HUGE_VAL : 0.0f;
+	}
+	for(v = 0; v < mesh->vertices; v++)
+	{
+		mesh->min[0] = mesh->x[v] < mesh->min[0] ? mesh->x[v] : mesh->min[0];
+		mesh->min[1] = mesh->y[v] < mesh->min[1] ? mesh->y[v] : mesh->min[1];
+		mesh->min[2] = mesh->z[v] < mesh->min[2] ? mesh->z[v] : mesh->min[2];
+		mesh->max[0] = mesh->x[v] > mesh->max[0] ? mesh->x[v] : mesh->max[0];
+		mesh->max[1] = mesh->y[v] > mesh->max[1] ? mesh->y[v] : mesh->max[1];
+		mesh->max[2] = mesh->z[v] > mesh->max[2] ? mesh->z[v] : mesh->max[2];
+	}
+
+	return CGE_OK;
+}
+
+/* Coarser levels snap every vertex to the first vertex of its cell on a */
+/* grid, keeping the edges that still join two different cells. A cell of */
+/* size s covers about two pixels from 300 s away, where the level starts */
+CGE_EXITCODE CGE_ImportLods(CGE_ImportMesh *mesh)
+{
+	static const float cells[CGE_IMPORT_LODS - 1] = {64.0f, 16.0f};
+	CGE_ImportHash hash;
+	Uint32 *cluster;
+	Uint32 *index;
+	Uint32 key[3];
+	Uint32 first;
+	Uint32 count;
+	Uint32 h;
+	Uint32 a;
+	Uint32 b;
+	Uint32 v;
+	Uint32 i;
+	float diagonal;
+	float cell;
+	int level;
+
+	mesh->lods = 0;
+	diagonal = sqrt((mesh->max[0] - mesh->min[0]) * (mesh->max[0] - mesh->min[0])
+	+ (mesh->max[1] - mesh->min[1]) * (mesh->max[1] - mesh->min[1])
+	+ (mesh->max[2] - mesh->min[2]) * (mesh->max[2] - mesh->min[2]));
+	if(mesh->indices == 0 || diagonal <= 0.0f)
+	{
+		return CGE_OK;
+	}
+
+	index = (Uint32 *)realloc(mesh->index, mesh->indices * CGE_IMPORT_LODS * sizeof(Uint32));
+	if(index == NULL)
+	{
+		return CGE_ERR;
+	}
+	mesh->index = index;
+	cluster = (Uint32 *)malloc(mesh->vertices * sizeof(Uint32));
+	if(cluster == NULL)
+	{
+		return CGE_ERR;
+	}
+
+	mesh->lod[0].distance = 0.0f;
+	mesh->lod[0].first = 0;
+	mesh->lod[0].count = mesh->indices;
+	mesh->lods = 1;
+
+	for(level = 0; level < CGE_IMPORT_LODS - 1; level++)
+	{
+		cell = diagonal / cells[level];
+
+		if(CGE_HashNew(&hash, mesh->vertices) != CGE_OK)
+		{
+			break;
+		}
+		for(v = 0; v < mesh->vertices; v++)
+		{
+			key[0] = (Uint32)((mesh->x[v] - mesh->min[0]) / cell);
+			key[1] = (Uint32)((mesh->y[v] - mesh->min[1]) / cell);
+			key[2] = (Uint32)((mesh->z[v] - mesh->min[2]) / cell);
+			h = CGE_HashMix(CGE_HashMix(CGE_HashMix(0, key[0]), key[1]), key[2]) & hash.mask;
+			for(; hash.slot[h] != 0; h = (h + 1) & hash.mask)
+			{
+				a = hash.slot[h] - 1;
+				if((Uint32)((mesh->x[a] - mesh->min[0]) / cell) == key[0]
+				&& (Uint32)((mesh->y[a] - mesh->min[1]) / cell) == key[1]
+				&& (Uint32)((mesh->z[a] - mesh->min[2]) / cell) == key[2])
+				{
+					break;
+				}
+			}
+			if(hash.slot[h] == 0)
+			{
+				hash.slot[h] = v + 1;
+			}
+			cluster[v] = hash.slot[h] - 1;
+		}
+		CGE_HashFree(&hash);
+
+		first = mesh->lod[mesh->lods - 1].first + mesh->lod[mesh->lods - 1].count;
+		count = 0;
+		if(CGE_HashNew(&hash, mesh->indices / 2) != CGE_OK)
+		{
+			break;
+		}
+		for(i = 0; i < mesh->indices; i += 2)
+		{
+			a = cluster[index[i]];
+			b = cluster[index[i + 1]];
+			if(a == b)
+			{
+				continue;
+			}
+			if(a > b)
+			{
+				h = a;
+				a = b;
+				b = h;
+			}
+			h = CGE_HashMix(CGE_HashMix(0, a), b) & hash.mask;
+			for(; hash.slot[h] != 0; h = (h + 1) & hash.mask)
+			{
+				v = first + (hash.slot[h] - 1) * 2;
+				if(index[v] == a && index[v + 1] == b)
+				{
+					break;
+				}
+			}
+			if(hash.slot[h] == 0)
+			{
+				hash.slot[h] = count / 2 + 1;
+				index[first + count++] = a;
+				index[first + count++] = b;
+			}
+		}
+		CGE_HashFree(&hash);
+
+		/* A level that barely simplifies is not worth its memory */
+		if(count * 4 > mesh->lod[mesh->lods - 1].count * 3)
+		{
+			continue;
+		}
+		mesh->lod[mesh->lods].distance = 300.0f * cell;
+		mesh->lod[mesh->lods].first = first;
+		mesh->lod[mesh->lods].count = count;
+		mesh->lods++;
+	}
+	free(cluster);
+
+	if(mesh->lods == 1)
+	{
+		mesh->lods = 0;
+	}
+	else
+	{
+		mesh->indices = mesh->lod[mesh->lods - 1].first + mesh->lod[mesh->lods - 1].count;
+	}
+
+	return CGE_OK;
+}
+
+/* Indices narrow to 16 bits whenever the vertices allow it. With quantize */
+/* the positions are rounded to 16 bit steps across the box as well */
+CGE_EXITCODE CGE_ImportWrite(CGE_ImportMesh *mesh, const char *path, int quantize)
+{
+	static const unsigned char padding[CGE_MESHFILE_ALIGN] = {0};
+	CGE_MeshFileHeader header;
+	CGE_MeshFileMesh table;
+	const float *axis[3];
+	Uint16 *stream[4];
+	const void *array[5];
+	size_t bytes[5];
+	unsigned long offset;
+	unsigned long start[5];
+	FILE *file;
+	Uint32 checksum;
+	Uint32 j;
+	float scale;
+	int i;
+
+	if(SDL_BYTEORDER != SDL_LIL_ENDIAN)
+	{
+		fprintf(stderr, "%s: mesh files are little endian only\n", path);
+		return CGE_ERR;
+	}
+
+	axis[0] = mesh->x;
+	axis[1] = mesh->y;
+	axis[2] = mesh->z;
+	for(i = 0; i < 4; i++)
+	{
+		stream[i] = NULL;
+	}
+	for(i = 0; quantize == 1 && i < 3; i++)
+	{
+		stream[i] = (Uint16 *)malloc(mesh->vertices * sizeof(Uint16) + 1);
+		if(stream[i] == NULL)
+		{
+			break;
+		}
+		scale = mesh->max[i] > mesh->min[i] ? 65535.0f / (mesh->max[i] - mesh->min[i]) : 0.0f;
+		for(j = 0; j < mesh->vertices; j++)
+		{
+			stream[i][j] = (Uint16)((axis[i][j] - mesh->min[i]) * scale + 0.5f);
+		}
+	}
+	if(mesh->vertices <= 65536)
+	{
+		stream[3] = (Uint16 *)malloc(mesh->indices * sizeof(Uint16) + 1);
+		for(j = 0; stream[3] != NULL && j < mesh->indices; j++)
+		{
+			stream[3][j] = (Uint16)mesh->index[j];
+		}
+	}
+	if((quantize == 1 && (stream[0] == NULL || stream[1] == NULL || stream[2] == NULL)) || (mesh->vertices <= 65536 && stream[3] == NULL))
+	{
+		for(i = 0; i < 4; i++)
+		{
+			free(stream[i]);
+		}
+		return CGE_ERR;
+	}
+
+	for(i = 0; i < 3; i++)
+	{
+		array[i] = quantize == 1 ? (const void *)stream[i] : (const void *)axis[i];
+		bytes[i] = mesh->vertices * (quantize == 1 ? sizeof(Uint16) : sizeof(float));
+	}
+	array[3] = stream[3] != NULL ? (const void *)stream[3] : (const void *)mesh->index;
+	array[4] = mesh->lod;
+	bytes[3] = mesh->indices * (stream[3] != NULL ? sizeof(Uint16) : sizeof(Uint32));
+	bytes[4] = mesh->lods * sizeof(CGE_MeshFileLod);
+
+	offset = sizeof(CGE_MeshFileHeader) + sizeof(CGE_MeshFileMesh);
+	checksum = 1;
+	for(i = 0; i < 5; i++)
+	{
+		offset = (offset + CGE_MESHFILE_ALIGN - 1) / CGE_MESHFILE_ALIGN * CGE_MESHFILE_ALIGN;
+		start[i] = offset;
+		offset += bytes[i];
+		checksum = CGE_Adler32(checksum, (const unsigned char *)array[i], bytes[i]);
+	}
+	if(offset > 0xFFFFFFFFUL)
+	{
+		fprintf(stderr, "%s: mesh files are limited to 4GB\n", path);
+		for(i = 0; i < 4; i++)
+		{
+			free(stream[i]);
+		}
+		return CGE_ERR;
+	}
+
+	memset(&table, 0, sizeof(table));
+	table.vertices = mesh->vertices;
+	table.indices = mesh->indices;
+	table.x = (Uint32)start[0];
+	table.y = (Uint32)start[1];
+	table.z = (Uint32)start[2];
+	table.index = (Uint32)start[3];
+	table.lods = mesh->lods;
+	table.lod = (Uint32)start[4];
+	table.checksum = checksum;
+	memcpy(table.min, mesh->min, sizeof(table.min));
+	memcpy(table.max, mesh->max, sizeof(table.max));
+	memcpy(table.color, mesh->color, sizeof(table.color));
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "CGEM", 4);
+	header.version = CGE_MESHFILE_VERSION;
+	header.flags = CGE_MESHFILE_INDEX16 | (quantize == 1 ? CGE_MESHFILE_QUANTIZED : 0);
+	header.meshes = 1;
+	header.size = (Uint32)offset;
+	checksum = CGE_Adler32(1, (const unsigned char *)&header, 20);
+	header.checksum = CGE_Adler32(checksum, (const unsigned char *)&table, sizeof(table));
+
+	file = fopen(path, "wb");
+	if(file == NULL)
+	{
+		perror(path);
+		for(i = 0; i < 4; i++)
+		{
+			free(stream[i]);
+		}
+		return CGE_ERR;
+	}
+
+	offset = sizeof(header) + sizeof(table);
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(&table, sizeof(table), 1, file);
+	for(i = 0; i < 5; i++)
+	{
+		fwrite(padding, 1, start[i] - offset, file);
+		fwrite(array[i], 1, bytes[i], file);
+		offset = start[i] + bytes[i];
+	}
+	for(i = 0; i < 4; i++)
+	{
+		free(stream[i]);
+	}
+
+	if(fclose(file) != 0)
+	{
+		perror(path);
+		return CGE_ERR;
+	}
+
+	return CGE_OK;
+}
+
+CGE_EXITCODE CGE_ImportMeshFree(CGE_ImportMesh *mesh)
+{
+	free(mesh->x);
+	free(mesh->y);
+	free(mesh->z);
+	free(mesh->index);
+	mesh->x = NULL;
+	mesh->y = NULL;
+	mesh->z = NULL;
+	mesh->index = NULL;
+
+	return CGE_OK;
+}
+
+
+/* Main */
+
+int main(int argc, char *argv[])
+{
+	CGE_ImportChunk chunk[CGE_IMPORT_THREADS_MAX];
+	CGE_ImportMesh mesh;
+	CGE_PlyHeader ply;
+	CGE_ImportFormat format;
+	struct stat status;
+	const char *input = NULL;
+	const char *output = NULL;
+	const char *text;
+	const char *body;
+	const char *cut;
+	unsigned char *map;
+	unsigned long vertices = 0;
+	unsigned long edges = 0;
+	size_t size;
+	int color[3] = {200, 200, 200};
+	int threads = 0;
+	int quantize = 0;
+	int chunks;
+	int fd;
+	int i;
+	CGE_EXITCODE exitcode;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+		{
+			sscanf(argv[++i], "%d,%d,%d", &color[0], &color[1], &color[2]);
+		}
+		else if(strcmp(argv[i], "-q") == 0)
+		{
+			quantize = 1;
+		}
+		else if(input == NULL)
+		{
+			input = argv[i];
+		}
+		else
+		{
+			output = argv[i];
+		}
+	}
+	if(input == NULL || output == NULL)
+	{
+		fprintf(stderr, "usage: %s [-t threads] [-c r,g,b] [-q] input.obj|input.ply output.cgem\n", argv[0]);
+		return 1;
+	}
+
+	if(threads <= 0)
+	{
+#ifdef _SC_NPROCESSORS_ONLN
+		threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+		threads = threads <= 0 ? 1 : threads;
+	}
+	threads = threads > CGE_IMPORT_THREADS_MAX ? CGE_IMPORT_THREADS_MAX : threads;
+
+	fd = open(input, O_RDONLY);
+	if(fd < 0)
+	{
+		perror(input);
+		return 1;
+	}
+	if(fstat(fd, &status) < 0 || status.st_size == 0)
+	{
+		fprintf(stderr, "%s: empty file\n", input);
+		close(fd);
+		return 1;
+	}
+	size = (size_t)status.st_size;
+	map = (unsigned char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == (unsigned char *)MAP_FAILED)
+	{
+		perror(input);
+		return 1;
+	}
+	text = (const char *)map;
+
+	format = CGE_IMPORTFORMAT_OBJ;
+	body = text;
+	if(size >= 4 && memcmp(text, "ply", 3) == 0 && (text[3] == '\n' || text[3] == '\r'))
+	{
+		format = CGE_IMPORTFORMAT_PLY;
+		if(CGE_PlyHeaderRead(&ply, text, text + size) != CGE_OK)
+		{
+			fprintf(stderr, "%s: unsupported PLY header, only ASCII is read\n", input);
+			munmap(map, size);
+			return 1;
+		}
+		body = ply.body;
+	}
+
+	/* Small files are not worth a thread each */
+	size = text + size - body;
+	chunks = (int)(size / CGE_IMPORT_CHUNK_MIN) + 1;
+	chunks = chunks < threads ? chunks : threads;
+
+	cut = body;
+	for(i = 0; i < chunks; i++)
+	{
+		chunk[i].begin = cut;
+		cut = i + 1 < chunks ? body + size / chunks * (i + 1) : body + size;
+		cut = cut < chunk[i].begin ? chunk[i].begin : cut;
+		if(i + 1 < chunks && cut > body)
+		{
+			cut = CGE_ParseLine(cut - 1, body + size);
+		}
+		chunk[i].end = cut;
+		chunk[i].format = format;
+		chunk[i].ply = &ply;
+		chunk[i].pass = 0;
+		chunk[i].line = 0;
+		chunk[i].lines = 0;
+		chunk[i].base = 0;
+		chunk[i].error = NULL;
+		CGE_ArrayNew(&chunk[i].vertices, sizeof(float));
+		CGE_ArrayNew(&chunk[i].edges, sizeof(Uint32));
+		CGE_ArrayNew(&chunk[i].relative, sizeof(Uint32));
+	}
+
+	if(format == CGE_IMPORTFORMAT_PLY)
+	{
+		CGE_ImportRun(chunk, chunks);
+		for(i = 1; i < chunks; i++)
+		{
+			chunk[i].line = chunk[i - 1].line + chunk[i - 1].lines;
+		}
+	}
+	for(i = 0; i < chunks; i++)
+	{
+		chunk[i].pass = 1;
+	}
+
+	exitcode = CGE_ImportRun(chunk, chunks);
+	for(i = 0; i < chunks; i++)
+	{
+		if(chunk[i].error != NULL)
+		{
+			fprintf(stderr, "%s: parse error at byte %lu\n", input, (unsigned long)(chunk[i].error - text));
+			break;
+		}
+		vertices += (unsigned long)(chunk[i].vertices.count / 3);
+		edges += (unsigned long)(chunk[i].edges.count / 2);
+	}
+
+	mesh.x = NULL;
+	mesh.y = NULL;
+	mesh.z = NULL;
+	mesh.index = NULL;
+	mesh.color[0] = (Uint8)color[0];
+	mesh.color[1] = (Uint8)color[1];
+	mesh.color[2] = (Uint8)color[2];
+	mesh.color[3] = 0;
+	if(exitcode == CGE_OK)
+	{
+		exitcode = CGE_ImportMerge(&mesh, chunk, chunks);
+	}
+	for(i = 0; i < chunks; i++)
+	{
+		CGE_ArrayFree(&chunk[i].vertices);
+		CGE_ArrayFree(&chunk[i].edges);
+		CGE_ArrayFree(&chunk[i].relative);
+	}
+	munmap(map, (size_t)status.st_size);
+
+	if(exitcode == CGE_OK)
+	{
+		printf("%s: %lu vertices, %lu edges read with %d threads\n", input, vertices, edges, chunks);
+		printf("%s: %lu vertices, %lu edges after merging\n", input, (unsigned long)mesh.vertices, (unsigned long)mesh.indices / 2);
+		exitcode = CGE_ImportLods(&mesh);
+	}
+	if(exitcode == CGE_OK)
+	{
+		for(i = 1; i < (int)mesh.lods; i++)
+		{
+			printf("%s: level %d, %lu edges from %g\n", output, i, (unsigned long)mesh.lod[i].count / 2, mesh.lod[i].distance);
+		}
+		exitcode = CGE_ImportWrite(&mesh, output, quantize);
+	}
+	CGE_ImportMeshFree(&mesh);
+
+	return exitcode == CGE_OK ? 0 : 1;
+}